@@ -94,6 +94,7 @@ uint64_t *zopt_object = NULL;
 int zopt_objects = 0;
 libzfs_handle_t *g_zfs;
 uint64_t max_inflight = 1000;
+int zdb_threads = 0;		/* 0 means one per online CPU */
 
 static void snprintf_blkptr_compact(char *, size_t, const blkptr_t *);
 
@@ -118,7 +119,8 @@ usage(void)
 {
 	(void) fprintf(stderr,
 	    "Usage: %s [-CumMdibcsDvhLXFPA] [-t txg] [-e [-p path...]] "
-	    "[-U config] [-I inflight I/Os] [-x dumpdir] poolname [object...]\n"
+	    "[-U config] [-I inflight I/Os] [-T threads] [-x dumpdir] "
+	    "poolname [object...]\n"
 	    "       %s [-divPA] [-e -p path...] [-U config] dataset "
 	    "[object...]\n"
 	    "       %s -mM [-LXFPA] [-t txg] [-e [-p path...]] [-U config] "
@@ -178,6 +180,9 @@ usage(void)
 	(void) fprintf(stderr, "        -I <number of inflight I/Os> -- "
 	    "specify the maximum number of "
 	    "checksumming I/Os [default is 200]\n");
+	(void) fprintf(stderr, "        -T <threads> -- number of threads "
+	    "used to traverse the pool and load space maps "
+	    "[default is one per CPU]\n");
 	(void) fprintf(stderr, "Specify an option more than once (e.g. -bb) "
 	    "to make only that option verbose\n");
 	(void) fprintf(stderr, "Default is to dump everything non-verbosely\n");
@@ -725,13 +730,13 @@ dump_metaslab_stats(metaslab_t *msp)
 {
 	char maxbuf[32];
 	range_tree_t *rt = msp->ms_tree;
-	avl_tree_t *t = &msp->ms_size_tree;
+	zfs_btree_t *t = &msp->ms_size_tree;
 	int free_pct = range_tree_space(rt) * 100 / msp->ms_size;
 
 	zdb_nicenum(metaslab_block_maxsize(msp), maxbuf);
 
-	(void) printf("\t %25s %10lu   %7s  %6s   %4s %4d%%\n",
-	    "segments", avl_numnodes(t), "maxsize", maxbuf,
+	(void) printf("\t %25s %10llu   %7s  %6s   %4s %4d%%\n",
+	    "segments", (u_longlong_t)zfs_btree_numnodes(t), "maxsize", maxbuf,
 	    "freepct", free_pct);
 	(void) printf("\tIn-memory histogram:\n");
 	dump_histogram(rt->rt_histogram, RANGE_TREE_HISTOGRAM_SIZE, 0);
@@ -2350,9 +2355,13 @@ typedef struct zdb_cb {
 	uint64_t	zcb_lastprint;
 	uint64_t	zcb_totalasize;
 	uint64_t	zcb_errors[256];
+	uint64_t	zcb_progress;	/* asize traversed by all threads */
+	uint64_t	zcb_reported;	/* asize added to zcb_progress */
+	int		zcb_iters;
 	int		zcb_readfails;
 	int		zcb_haderrors;
 	spa_t		*zcb_spa;
+	struct zdb_cb	*zcb_shared;	/* totals shared by all threads */
 } zdb_cb_t;
 
 static void
@@ -2488,8 +2497,10 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
     const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
 {
 	zdb_cb_t *zcb = arg;
+	zdb_cb_t *szcb = zcb->zcb_shared;
 	dmu_object_type_t type;
 	boolean_t is_metadata;
+	uint64_t asize, bytes, now, last;
 
 	if (bp == NULL)
 		return (0);
@@ -2532,27 +2543,41 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 		spa->spa_scrub_inflight++;
 		mutex_exit(&spa->spa_scrub_lock);
 
+		/*
+		 * Errors are recorded in the shared totals, under the
+		 * spa_scrub_lock, since the read may complete after this
+		 * thread's totals have already been merged.
+		 */
 		zio_nowait(zio_read(NULL, spa, bp, data, size,
-		    zdb_blkptr_done, zcb, ZIO_PRIORITY_ASYNC_READ, flags, zb));
+		    zdb_blkptr_done, szcb, ZIO_PRIORITY_ASYNC_READ, flags, zb));
 	}
 
 	zcb->zcb_readfails = 0;
 
 	/* only call gethrtime() every 100 blocks */
-	static int iters;
-	if (++iters > 100)
-		iters = 0;
+	if (++zcb->zcb_iters > 100)
+		zcb->zcb_iters = 0;
 	else
 		return (0);
 
-	if (dump_opt['b'] < 5 && gethrtime() > zcb->zcb_lastprint + NANOSEC) {
-		uint64_t now = gethrtime();
+	/*
+	 * Fold this thread's progress into the shared total.  Whichever
+	 * thread first notices that a second has passed prints it.
+	 */
+	asize = zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
+	bytes = atomic_add_64_nv(&szcb->zcb_progress,
+	    asize - zcb->zcb_reported);
+	zcb->zcb_reported = asize;
+
+	now = gethrtime();
+	last = szcb->zcb_lastprint;
+	if (dump_opt['b'] < 5 && now > last + NANOSEC &&
+	    atomic_cas_64(&szcb->zcb_lastprint, last, now) == last) {
 		char buf[10];
-		uint64_t bytes = zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
 		int kb_per_sec =
-		    1 + bytes / (1 + ((now - zcb->zcb_start) / 1000 / 1000));
+		    1 + bytes / (1 + ((now - szcb->zcb_start) / 1000 / 1000));
 		int sec_remaining =
-		    (zcb->zcb_totalasize - bytes) / 1024 / kb_per_sec;
+		    (szcb->zcb_totalasize - bytes) / 1024 / kb_per_sec;
 
 		zfs_nicenum(bytes, buf, sizeof (buf));
 		(void) fprintf(stderr,
@@ -2562,8 +2587,6 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 		    sec_remaining / 60 / 60,
 		    sec_remaining / 60 % 60,
 		    sec_remaining % 60);
-
-		zcb->zcb_lastprint = now;
 	}
 
 	return (0);
@@ -2623,6 +2646,47 @@ zdb_ddt_leak_init(spa_t *spa, zdb_cb_t *zcb)
 	ASSERT(error == ENOENT);
 }
 
+/*
+ * Load one metaslab's space map for leak detection.  The metaslabs are
+ * independent, so zdb_leak_init() loads them from several threads at once.
+ */
+static void
+zdb_leak_init_ms(void *arg)
+{
+	metaslab_t *msp = arg;
+	vdev_t *vd = msp->ms_group->mg_vd;
+
+	mutex_enter(&msp->ms_lock);
+	metaslab_unload(msp);
+
+	/*
+	 * For leak detection, we overload the metaslab ms_tree to
+	 * contain allocated segments instead of free segments. As a
+	 * result, we can't use the normal metaslab_load/unload
+	 * interfaces.
+	 */
+	if (msp->ms_sm != NULL) {
+		(void) fprintf(stderr,
+		    "\rloading space map for vdev %llu of %llu, "
+		    "metaslab %llu of %llu ...",
+		    (longlong_t)vd->vdev_id,
+		    (longlong_t)vd->vdev_parent->vdev_children,
+		    (longlong_t)msp->ms_id,
+		    (longlong_t)vd->vdev_ms_count);
+
+		msp->ms_ops = &zdb_metaslab_ops;
+
+		/*
+		 * We don't want to spend the CPU manipulating the
+		 * size-ordered tree, so clear the range_tree ops.
+		 */
+		msp->ms_tree->rt_ops = NULL;
+		VERIFY0(space_map_load(msp->ms_sm, msp->ms_tree, SM_ALLOC));
+		msp->ms_loaded = B_TRUE;
+	}
+	mutex_exit(&msp->ms_lock);
+}
+
 static void
 zdb_leak_init(spa_t *spa, zdb_cb_t *zcb)
 {
@@ -2631,46 +2695,18 @@ zdb_leak_init(spa_t *spa, zdb_cb_t *zcb)
 
 	if (!dump_opt['L']) {
 		vdev_t *rvd = spa->spa_root_vdev;
+		taskq_t *tq = taskq_create("zdb_leak_init", zdb_threads,
+		    minclsyspri, zdb_threads, INT_MAX, 0);
+
 		for (c = 0; c < rvd->vdev_children; c++) {
 			vdev_t *vd = rvd->vdev_child[c];
 			for (m = 0; m < vd->vdev_ms_count; m++) {
-				metaslab_t *msp = vd->vdev_ms[m];
-				mutex_enter(&msp->ms_lock);
-				metaslab_unload(msp);
-
-				/*
-				 * For leak detection, we overload the metaslab
-				 * ms_tree to contain allocated segments
-				 * instead of free segments. As a result,
-				 * we can't use the normal metaslab_load/unload
-				 * interfaces.
-				 */
-				if (msp->ms_sm != NULL) {
-					(void) fprintf(stderr,
-					    "\rloading space map for "
-					    "vdev %llu of %llu, "
-					    "metaslab %llu of %llu ...",
-					    (longlong_t)c,
-					    (longlong_t)rvd->vdev_children,
-					    (longlong_t)m,
-					    (longlong_t)vd->vdev_ms_count);
-
-					msp->ms_ops = &zdb_metaslab_ops;
-
-					/*
-					 * We don't want to spend the CPU
-					 * manipulating the size-ordered
-					 * tree, so clear the range_tree
-					 * ops.
-					 */
-					msp->ms_tree->rt_ops = NULL;
-					VERIFY0(space_map_load(msp->ms_sm,
-					    msp->ms_tree, SM_ALLOC));
-					msp->ms_loaded = B_TRUE;
-				}
-				mutex_exit(&msp->ms_lock);
+				VERIFY(taskq_dispatch(tq, zdb_leak_init_ms,
+				    vd->vdev_ms[m], TQ_SLEEP) != 0);
 			}
 		}
+		taskq_wait(tq);
+		taskq_destroy(tq);
 		(void) fprintf(stderr, "\n");
 	}
 
@@ -2729,6 +2765,206 @@ count_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 	return (0);
 }
 
+/*
+ * The MOS and each dataset can be traversed independently of one another,
+ * so they are handed out to a pool of worker threads.  Each worker counts
+ * blocks into its own zdb_cb_t, and these are added into the shared one
+ * once all of the workers are done.  Claiming blocks from the space maps
+ * and the DDT is safe from any thread since zio_claim() and ddt_enter()
+ * do the necessary locking.
+ */
+typedef struct zdb_traverse {
+	zdb_cb_t	*zt_zcb;	/* shared totals */
+	zdb_cb_t	**zt_worker_zcb;	/* one per worker */
+	uint64_t	zt_nworkers;	/* workers started so far */
+	uint64_t	*zt_objs;	/* datasets to visit, 0 for the MOS */
+	uint64_t	zt_nobjs;
+	uint64_t	zt_next;	/* next unclaimed entry of zt_objs */
+	int		zt_flags;
+} zdb_traverse_t;
+
+/*
+ * Start reading the root block of a dataset's objset, so that it is
+ * likely to be cached by the time a worker gets to the dataset.
+ */
+static void
+zdb_prefetch_dataset(dsl_pool_t *dp, uint64_t obj)
+{
+	arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH;
+	dsl_dataset_t *ds;
+	zbookmark_phys_t zb;
+	blkptr_t *bp;
+
+	dsl_pool_config_enter(dp, FTAG);
+	if (dsl_dataset_hold_obj(dp, obj, FTAG, &ds) == 0) {
+		bp = &dsl_dataset_phys(ds)->ds_bp;
+		if (!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp)) {
+			SET_BOOKMARK(&zb, obj, ZB_ROOT_OBJECT,
+			    ZB_ROOT_LEVEL, ZB_ROOT_BLKID);
+			(void) arc_read(NULL, dp->dp_spa, bp, NULL, NULL,
+			    ZIO_PRIORITY_ASYNC_READ, ZIO_FLAG_CANFAIL,
+			    &aflags, &zb);
+		}
+		dsl_dataset_rele(ds, FTAG);
+	}
+	dsl_pool_config_exit(dp, FTAG);
+}
+
+static int
+zdb_traverse_obj(spa_t *spa, uint64_t obj, int flags, zdb_cb_t *zcb)
+{
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	dsl_dataset_t *ds;
+	uint64_t txg = 0;
+	int err;
+
+	if (obj == 0)
+		return (traverse_mos(spa, 0, flags, zdb_blkptr_cb, zcb));
+
+	/*
+	 * As in traverse_pool() with TRAVERSE_HARD, a dataset that can't
+	 * be held is skipped rather than treated as an error.
+	 */
+	dsl_pool_config_enter(dp, FTAG);
+	err = dsl_dataset_hold_obj(dp, obj, FTAG, &ds);
+	dsl_pool_config_exit(dp, FTAG);
+	if (err != 0)
+		return (0);
+
+	if (dsl_dataset_phys(ds)->ds_prev_snap_txg > txg)
+		txg = dsl_dataset_phys(ds)->ds_prev_snap_txg;
+	err = traverse_dataset(ds, txg, flags, zdb_blkptr_cb, zcb);
+	dsl_dataset_rele(ds, FTAG);
+
+	return (err);
+}
+
+static void
+zdb_traverse_thread(void *arg)
+{
+	zdb_traverse_t *zt = arg;
+	zdb_cb_t *zcb = umem_zalloc(sizeof (zdb_cb_t), UMEM_NOFAIL);
+	uint64_t i;
+
+	zcb->zcb_spa = zt->zt_zcb->zcb_spa;
+	zcb->zcb_shared = zt->zt_zcb;
+	zt->zt_worker_zcb[atomic_inc_64_nv(&zt->zt_nworkers) - 1] = zcb;
+
+	while ((i = atomic_inc_64_nv(&zt->zt_next) - 1) < zt->zt_nobjs) {
+		zcb->zcb_haderrors |= zdb_traverse_obj(zcb->zcb_spa,
+		    zt->zt_objs[i], zt->zt_flags, zcb);
+	}
+}
+
+static void
+zdb_cb_merge(zdb_cb_t *dst, const zdb_cb_t *src)
+{
+	int l, t, i, j;
+
+	for (l = 0; l <= ZB_TOTAL; l++) {
+		for (t = 0; t <= ZDB_OT_TOTAL; t++) {
+			zdb_blkstats_t *dzb = &dst->zcb_type[l][t];
+			const zdb_blkstats_t *szb = &src->zcb_type[l][t];
+
+			dzb->zb_asize += szb->zb_asize;
+			dzb->zb_lsize += szb->zb_lsize;
+			dzb->zb_psize += szb->zb_psize;
+			dzb->zb_count += szb->zb_count;
+			dzb->zb_gangs += szb->zb_gangs;
+			dzb->zb_ditto_samevdev += szb->zb_ditto_samevdev;
+			for (i = 0; i < PSIZE_HISTO_SIZE; i++) {
+				dzb->zb_psize_histogram[i] +=
+				    szb->zb_psize_histogram[i];
+			}
+		}
+	}
+
+	for (i = 0; i < NUM_BP_EMBEDDED_TYPES; i++) {
+		dst->zcb_embedded_blocks[i] += src->zcb_embedded_blocks[i];
+		for (j = 0; j < BPE_PAYLOAD_SIZE; j++) {
+			dst->zcb_embedded_histogram[i][j] +=
+			    src->zcb_embedded_histogram[i][j];
+		}
+	}
+
+	dst->zcb_dedup_asize += src->zcb_dedup_asize;
+	dst->zcb_dedup_blocks += src->zcb_dedup_blocks;
+	dst->zcb_haderrors |= src->zcb_haderrors;
+}
+
+/*
+ * The multi-threaded equivalent of traverse_pool(spa, 0, flags,
+ * zdb_blkptr_cb, zcb).
+ */
+static int
+zdb_traverse_pool(spa_t *spa, zdb_cb_t *zcb, int flags)
+{
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	objset_t *mos = dp->dp_meta_objset;
+	zdb_traverse_t zt = { 0 };
+	uint64_t nalloc = 16;
+	uint64_t obj;
+	int nthreads, t;
+	taskq_t *tq;
+	int err;
+
+	zt.zt_zcb = zcb;
+	zt.zt_flags = flags;
+	zt.zt_objs = umem_alloc(nalloc * sizeof (uint64_t), UMEM_NOFAIL);
+	zt.zt_objs[zt.zt_nobjs++] = 0;
+
+	for (obj = 1, err = 0; err == 0;
+	    err = dmu_object_next(mos, &obj, FALSE, 0)) {
+		dmu_object_info_t doi;
+
+		if (dmu_object_info(mos, obj, &doi) != 0 ||
+		    doi.doi_bonus_type != DMU_OT_DSL_DATASET)
+			continue;
+
+		if (zt.zt_nobjs == nalloc) {
+			uint64_t *objs = umem_alloc(2 * nalloc *
+			    sizeof (uint64_t), UMEM_NOFAIL);
+			bcopy(zt.zt_objs, objs, nalloc * sizeof (uint64_t));
+			umem_free(zt.zt_objs, nalloc * sizeof (uint64_t));
+			zt.zt_objs = objs;
+			nalloc *= 2;
+		}
+		zt.zt_objs[zt.zt_nobjs++] = obj;
+		zdb_prefetch_dataset(dp, obj);
+	}
+	if (err == ESRCH)
+		err = 0;
+
+	/*
+	 * -bbbbb prints every block from the traversal callback, so more
+	 * than one thread would interleave the output.
+	 */
+	if (dump_opt['b'] >= 5)
+		nthreads = 1;
+	else
+		nthreads = MIN(zdb_threads, (int)zt.zt_nobjs);
+	zt.zt_worker_zcb = umem_zalloc(nthreads * sizeof (zdb_cb_t *),
+	    UMEM_NOFAIL);
+
+	tq = taskq_create("zdb_traverse", nthreads, minclsyspri,
+	    nthreads, nthreads, TASKQ_PREPOPULATE);
+	for (t = 0; t < nthreads; t++) {
+		VERIFY(taskq_dispatch(tq, zdb_traverse_thread, &zt,
+		    TQ_SLEEP) != 0);
+	}
+	taskq_wait(tq);
+	taskq_destroy(tq);
+
+	for (t = 0; t < nthreads; t++) {
+		zdb_cb_merge(zcb, zt.zt_worker_zcb[t]);
+		umem_free(zt.zt_worker_zcb[t], sizeof (zdb_cb_t));
+	}
+	umem_free(zt.zt_worker_zcb, nthreads * sizeof (zdb_cb_t *));
+	umem_free(zt.zt_objs, nalloc * sizeof (uint64_t));
+
+	return (err);
+}
+
 static int
 dump_block_stats(spa_t *spa)
 {
@@ -2776,9 +3012,11 @@ dump_block_stats(spa_t *spa)
 	if (dump_opt['c'] > 1)
 		flags |= TRAVERSE_PREFETCH_DATA;
 
+	zcb.zcb_shared = &zcb;
+	zcb.zcb_progress = zcb.zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
 	zcb.zcb_totalasize = metaslab_class_get_alloc(spa_normal_class(spa));
 	zcb.zcb_start = zcb.zcb_lastprint = gethrtime();
-	zcb.zcb_haderrors |= traverse_pool(spa, 0, flags, zdb_blkptr_cb, &zcb);
+	zcb.zcb_haderrors |= zdb_traverse_pool(spa, &zcb, flags);
 
 	/*
 	 * If we've traversed the data blocks then we need to wait for those
@@ -3647,7 +3885,7 @@ main(int argc, char **argv)
 		spa_config_path = spa_config_path_env;
 
 	while ((c = getopt(argc, argv,
-	    "bcdhilmMI:suCDRSAFLXx:evp:t:U:PV")) != -1) {
+	    "bcdhilmMI:suCDRSAFLXx:evp:t:T:U:PV")) != -1) {
 		switch (c) {
 		case 'b':
 		case 'c':
@@ -3712,6 +3950,14 @@ main(int argc, char **argv)
 				usage();
 			}
 			break;
+		case 'T':
+			zdb_threads = strtol(optarg, NULL, 0);
+			if (zdb_threads <= 0) {
+				(void) fprintf(stderr, "number of threads "
+				    "must be greater than 0\n");
+				usage();
+			}
+			break;
 		case 'U':
 			spa_config_path = optarg;
 			break;
@@ -3744,6 +3990,9 @@ main(int argc, char **argv)
 	 */
 	zfs_vdev_async_read_max_active = 10;
 
+	if (zdb_threads == 0)
+		zdb_threads = MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+
 	kernel_init(FREAD);
 	if ((g_zfs = libzfs_init()) == NULL) {
 		(void) fprintf(stderr, "%s", libzfs_error_init(errno));
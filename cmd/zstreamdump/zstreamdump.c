@@ -37,6 +37,9 @@
 #include <strings.h>
 #include <unistd.h>
 #include <stddef.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <sys/dmu.h>
 #include <sys/zfs_ioctl.h>
@@ -52,8 +55,19 @@
  */
 #define	DUMP_GROUPING	4
 
+/*
+ * In statistics mode, the size of the batches of stream that are
+ * checksummed by the worker threads, the number of batches that may be
+ * outstanding per thread, and the stdio buffer size used for pipes.
+ */
+#define	STAT_BATCH_SIZE		(4 << 20)
+#define	STAT_BATCHES_PER_THREAD	4
+#define	STAT_READ_BUFSIZE	(16 << 20)
+
 uint64_t total_write_size = 0;
 uint64_t total_stream_len = 0;
+uint64_t drr_record_count[DRR_NUMTYPES] = { 0 };
+uint64_t total_records = 0;
 FILE *send_stream = 0;
 boolean_t do_byteswap = B_FALSE;
 boolean_t do_cksum = B_TRUE;
@@ -61,11 +75,14 @@ boolean_t do_cksum = B_TRUE;
 static void
 usage(void)
 {
-	(void) fprintf(stderr, "usage: zstreamdump [-v] [-C] [-d] < file\n");
+	(void) fprintf(stderr,
+	    "usage: zstreamdump [-v] [-C] [-d] [-s] < file\n");
 	(void) fprintf(stderr, "\t -v -- verbose\n");
 	(void) fprintf(stderr, "\t -C -- suppress checksum verification\n");
 	(void) fprintf(stderr, "\t -d -- dump contents of blocks modified, "
 	    "implies verbose\n");
+	(void) fprintf(stderr, "\t -s -- only print statistics, verifying "
+	    "checksums on multiple threads\n");
 	exit(1);
 }
 
@@ -196,12 +213,543 @@ print_block(char *buf, int length)
 	}
 }
 
+/*
+ * Statistics mode.
+ *
+ * The stream is covered by one running fletcher-4 checksum, which every
+ * record header and DRR_END record is checked against.  Since the checksum
+ * of a concatenation can be computed from the checksums of its parts (see
+ * fletcher_4_incremental_combine()), the stream is cut into batches which
+ * are checksummed from a zero state by a pool of threads.  The main thread
+ * parses the records and chains the batch checksums together in stream
+ * order as they complete, checking each record against the running value.
+ *
+ * Regular files are mapped rather than read.  Otherwise each batch holds
+ * its own copy of the stream, read through a large stdio buffer.
+ */
+typedef struct stat_piece {
+	const char	*sp_buf;
+	uint64_t	sp_len;
+} stat_piece_t;
+
+/*
+ * A point in a batch, before piece sc_piece, at which the running checksum
+ * must equal sc_expected.  The worker fills in the checksum of the batch up
+ * to that point.
+ */
+typedef struct stat_check {
+	int		sc_piece;
+	boolean_t	sc_end;		/* DRR_END, rather than a header */
+	uint64_t	sc_record;
+	zio_cksum_t	sc_expected;
+	zio_cksum_t	sc_sum;
+	uint64_t	sc_words;
+} stat_check_t;
+
+typedef struct stat_batch {
+	struct stat_batch *sb_next;	/* next batch, in stream order */
+	struct stat_batch *sb_work_next;	/* next batch to checksum */
+	char		*sb_data;	/* stream copy, when not mapped */
+	uint64_t	sb_datalen;
+	uint64_t	sb_datasize;
+	stat_piece_t	*sb_pieces;
+	int		sb_npieces;
+	int		sb_maxpieces;
+	stat_check_t	*sb_checks;
+	int		sb_nchecks;
+	int		sb_maxchecks;
+	boolean_t	sb_reset;	/* checksum restarts after batch */
+	boolean_t	sb_done;
+	zio_cksum_t	sb_sum;
+	uint64_t	sb_words;
+} stat_batch_t;
+
+typedef struct stat_state {
+	pthread_mutex_t	ss_lock;
+	pthread_cond_t	ss_cv;
+	stat_batch_t	*ss_work_head;	/* batches waiting for a worker */
+	stat_batch_t	*ss_work_tail;
+	stat_batch_t	*ss_head;	/* oldest batch not yet retired */
+	stat_batch_t	*ss_tail;
+	int		ss_inflight;
+	int		ss_max_inflight;
+	boolean_t	ss_exit;
+	stat_batch_t	*ss_cur;	/* batch being filled */
+	const char	*ss_map;	/* the mapped stream, or NULL */
+	uint64_t	ss_maplen;
+	uint64_t	ss_offset;
+	zio_cksum_t	ss_cksum;	/* checksum of retired batches */
+	uint64_t	ss_end_errors;
+	uint64_t	ss_record_bytes[DRR_NUMTYPES];
+	uint64_t	ss_ot_objects[DMU_OT_NUMTYPES + 1];
+	uint64_t	ss_ot_writes[DMU_OT_NUMTYPES + 1];
+	uint64_t	ss_ot_bytes[DMU_OT_NUMTYPES + 1];
+} stat_state_t;
+
+static const char *stat_record_names[DRR_NUMTYPES] = {
+	"BEGIN", "OBJECT", "FREEOBJECTS", "WRITE", "FREE", "END",
+	"WRITE_BYREF", "SPILL", "WRITE_EMBEDDED"
+};
+
+static void *
+stat_worker(void *arg)
+{
+	stat_state_t *ss = arg;
+	stat_batch_t *sb;
+	int p, c;
+
+	for (;;) {
+		pthread_mutex_lock(&ss->ss_lock);
+		while (ss->ss_work_head == NULL && !ss->ss_exit)
+			pthread_cond_wait(&ss->ss_cv, &ss->ss_lock);
+		if ((sb = ss->ss_work_head) == NULL) {
+			pthread_mutex_unlock(&ss->ss_lock);
+			return (NULL);
+		}
+		ss->ss_work_head = sb->sb_work_next;
+		pthread_mutex_unlock(&ss->ss_lock);
+
+		ZIO_SET_CHECKSUM(&sb->sb_sum, 0, 0, 0, 0);
+		sb->sb_words = 0;
+		for (p = 0, c = 0; p <= sb->sb_npieces; p++) {
+			stat_piece_t *sp = &sb->sb_pieces[p];
+
+			for (; c < sb->sb_nchecks &&
+			    sb->sb_checks[c].sc_piece == p; c++) {
+				sb->sb_checks[c].sc_sum = sb->sb_sum;
+				sb->sb_checks[c].sc_words = sb->sb_words;
+			}
+			if (p == sb->sb_npieces)
+				break;
+			if (do_byteswap) {
+				fletcher_4_incremental_byteswap(sp->sp_buf,
+				    sp->sp_len, &sb->sb_sum);
+			} else {
+				fletcher_4_incremental_native(sp->sp_buf,
+				    sp->sp_len, &sb->sb_sum);
+			}
+			sb->sb_words += sp->sp_len / sizeof (uint32_t);
+		}
+
+		pthread_mutex_lock(&ss->ss_lock);
+		sb->sb_done = B_TRUE;
+		pthread_cond_broadcast(&ss->ss_cv);
+		pthread_mutex_unlock(&ss->ss_lock);
+	}
+}
+
+static void
+stat_print_cksum(const char *what, const zio_cksum_t *zc)
+{
+	(void) printf("%s = %llx/%llx/%llx/%llx\n", what,
+	    (u_longlong_t)zc->zc_word[0], (u_longlong_t)zc->zc_word[1],
+	    (u_longlong_t)zc->zc_word[2], (u_longlong_t)zc->zc_word[3]);
+}
+
+/*
+ * Chain a completed batch onto the running checksum and check it.
+ */
+static void
+stat_retire(stat_state_t *ss, stat_batch_t *sb)
+{
+	int c;
+
+	for (c = 0; do_cksum && c < sb->sb_nchecks; c++) {
+		stat_check_t *sc = &sb->sb_checks[c];
+		zio_cksum_t zc = ss->ss_cksum;
+
+		fletcher_4_incremental_combine(&zc, &sc->sc_sum, sc->sc_words);
+		if (sc->sc_end) {
+			if (!ZIO_CHECKSUM_EQUAL(zc, sc->sc_expected)) {
+				(void) printf("Expected checksum differs from "
+				    "checksum in stream (record %llu).\n",
+				    (u_longlong_t)sc->sc_record);
+				stat_print_cksum("Expected checksum", &zc);
+				ss->ss_end_errors++;
+			}
+		} else if (!ZIO_CHECKSUM_IS_ZERO(&sc->sc_expected) &&
+		    !ZIO_CHECKSUM_EQUAL(zc, sc->sc_expected)) {
+			fprintf(stderr, "invalid checksum\n");
+			(void) printf("Incorrect checksum in header of "
+			    "record %llu.\n", (u_longlong_t)sc->sc_record);
+			stat_print_cksum("Expected checksum", &zc);
+			exit(1);
+		}
+	}
+
+	fletcher_4_incremental_combine(&ss->ss_cksum, &sb->sb_sum,
+	    sb->sb_words);
+	if (sb->sb_reset)
+		ZIO_SET_CHECKSUM(&ss->ss_cksum, 0, 0, 0, 0);
+
+	free(sb->sb_data);
+	free(sb->sb_pieces);
+	free(sb->sb_checks);
+	free(sb);
+}
+
+/*
+ * Hand the batch being filled to the workers, then retire completed
+ * batches in order, waiting for the oldest if too many are outstanding.
+ */
+static void
+stat_batch_close(stat_state_t *ss, boolean_t reset, boolean_t wait_all)
+{
+	stat_batch_t *sb = ss->ss_cur;
+
+	pthread_mutex_lock(&ss->ss_lock);
+	if (sb != NULL) {
+		sb->sb_reset = reset;
+		if (!do_cksum) {
+			sb->sb_done = B_TRUE;
+		} else if (ss->ss_work_head == NULL) {
+			ss->ss_work_head = ss->ss_work_tail = sb;
+		} else {
+			ss->ss_work_tail->sb_work_next = sb;
+			ss->ss_work_tail = sb;
+		}
+		if (ss->ss_head == NULL)
+			ss->ss_head = ss->ss_tail = sb;
+		else
+			ss->ss_tail = ss->ss_tail->sb_next = sb;
+		ss->ss_inflight++;
+		pthread_cond_broadcast(&ss->ss_cv);
+		ss->ss_cur = NULL;
+	}
+
+	while ((sb = ss->ss_head) != NULL) {
+		if (!sb->sb_done) {
+			if (!wait_all && ss->ss_inflight < ss->ss_max_inflight)
+				break;
+			pthread_cond_wait(&ss->ss_cv, &ss->ss_lock);
+			continue;
+		}
+		ss->ss_head = sb->sb_next;
+		ss->ss_inflight--;
+		pthread_mutex_unlock(&ss->ss_lock);
+		stat_retire(ss, sb);
+		pthread_mutex_lock(&ss->ss_lock);
+	}
+	pthread_mutex_unlock(&ss->ss_lock);
+}
+
+/*
+ * Return the next len bytes of the stream, or NULL at the end of it.  The
+ * bytes stay valid until the batch holding them is retired.
+ */
+static const char *
+stat_read(stat_state_t *ss, uint64_t len)
+{
+	stat_batch_t *sb = ss->ss_cur;
+	const char *buf;
+
+	if (sb != NULL && sb->sb_datalen + len > sb->sb_datasize) {
+		stat_batch_close(ss, B_FALSE, B_FALSE);
+		sb = NULL;
+	}
+	if (sb == NULL) {
+		sb = ss->ss_cur = safe_malloc(sizeof (stat_batch_t));
+		bzero(sb, sizeof (stat_batch_t));
+		sb->sb_datasize = MAX(STAT_BATCH_SIZE, len);
+		if (ss->ss_map == NULL)
+			sb->sb_data = safe_malloc(sb->sb_datasize);
+	}
+
+	if (ss->ss_map != NULL) {
+		if (ss->ss_maplen - ss->ss_offset < len)
+			return (NULL);
+		buf = ss->ss_map + ss->ss_offset;
+	} else {
+		buf = sb->sb_data + sb->sb_datalen;
+		if (len != 0 && fread((char *)buf, len, 1, send_stream) == 0)
+			return (NULL);
+	}
+	ss->ss_offset += len;
+	sb->sb_datalen += len;
+	total_stream_len += len;
+	return (buf);
+}
+
+static void
+stat_add_piece(stat_state_t *ss, const char *buf, uint64_t len)
+{
+	stat_batch_t *sb = ss->ss_cur;
+
+	if (sb->sb_npieces == sb->sb_maxpieces) {
+		sb->sb_maxpieces = MAX(2 * sb->sb_maxpieces, 64);
+		sb->sb_pieces = realloc(sb->sb_pieces,
+		    sb->sb_maxpieces * sizeof (stat_piece_t));
+		if (sb->sb_pieces == NULL)
+			abort();
+	}
+	sb->sb_pieces[sb->sb_npieces].sp_buf = buf;
+	sb->sb_pieces[sb->sb_npieces].sp_len = len;
+	sb->sb_npieces++;
+}
+
+static void
+stat_add_check(stat_state_t *ss, boolean_t end, const zio_cksum_t *zc)
+{
+	stat_batch_t *sb = ss->ss_cur;
+	stat_check_t *sc;
+	int i;
+
+	if (!do_cksum)
+		return;
+	if (sb->sb_nchecks == sb->sb_maxchecks) {
+		sb->sb_maxchecks = MAX(2 * sb->sb_maxchecks, 64);
+		sb->sb_checks = realloc(sb->sb_checks,
+		    sb->sb_maxchecks * sizeof (stat_check_t));
+		if (sb->sb_checks == NULL)
+			abort();
+	}
+	sc = &sb->sb_checks[sb->sb_nchecks++];
+	sc->sc_piece = sb->sb_npieces;
+	sc->sc_end = end;
+	sc->sc_record = total_records;
+	for (i = 0; i < 4; i++) {
+		sc->sc_expected.zc_word[i] = do_byteswap ?
+		    BSWAP_64(zc->zc_word[i]) : zc->zc_word[i];
+	}
+}
+
+/*
+ * Read a payload of len bytes, which is checksummed as a separate piece,
+ * just as ssread() would.
+ */
+static boolean_t
+stat_payload(stat_state_t *ss, uint64_t len)
+{
+	const char *buf = stat_read(ss, len);
+
+	if (buf == NULL)
+		return (B_FALSE);
+	stat_add_piece(ss, buf, len);
+	return (B_TRUE);
+}
+
+static int
+stat_ot(uint32_t type)
+{
+	return (type < DMU_OT_NUMTYPES ? type : DMU_OT_NUMTYPES);
+}
+
+static void
+stat_print(stat_state_t *ss)
+{
+	int t;
+
+	(void) printf("RECORD TYPES:\n");
+	(void) printf("\t%-16s %12s %16s %7s\n",
+	    "type", "records", "bytes", "%");
+	for (t = 0; t < DRR_NUMTYPES; t++) {
+		if (drr_record_count[t] == 0)
+			continue;
+		(void) printf("\t%-16s %12llu %16llu %6.2f%%\n",
+		    stat_record_names[t], (u_longlong_t)drr_record_count[t],
+		    (u_longlong_t)ss->ss_record_bytes[t],
+		    100.0 * ss->ss_record_bytes[t] /
+		    MAX(total_stream_len, 1));
+	}
+
+	(void) printf("OBJECT TYPES:\n");
+	(void) printf("\t%-28s %10s %12s %16s %7s\n",
+	    "type", "objects", "writes", "write bytes", "%");
+	for (t = 0; t <= DMU_OT_NUMTYPES; t++) {
+		if (ss->ss_ot_objects[t] == 0 && ss->ss_ot_writes[t] == 0)
+			continue;
+		(void) printf("\t%-28s %10llu %12llu %16llu %6.2f%%\n",
+		    t < DMU_OT_NUMTYPES ? dmu_ot[t].ot_name : "other",
+		    (u_longlong_t)ss->ss_ot_objects[t],
+		    (u_longlong_t)ss->ss_ot_writes[t],
+		    (u_longlong_t)ss->ss_ot_bytes[t],
+		    100.0 * ss->ss_ot_bytes[t] / MAX(total_write_size, 1));
+	}
+}
+
+static int
+stat_stream(void)
+{
+	stat_state_t *ss = safe_malloc(sizeof (stat_state_t));
+	dmu_replay_record_t thedrr;
+	dmu_replay_record_t *drr = &thedrr;
+	boolean_t first = B_TRUE;
+	const int hdrlen = sizeof (dmu_replay_record_t) - sizeof (zio_cksum_t);
+	pthread_t *tids;
+	struct stat st;
+	int nthreads, t;
+
+	bzero(ss, sizeof (stat_state_t));
+	VERIFY0(pthread_mutex_init(&ss->ss_lock, NULL));
+	VERIFY0(pthread_cond_init(&ss->ss_cv, NULL));
+
+	nthreads = do_cksum ? MAX(sysconf(_SC_NPROCESSORS_ONLN), 1) : 0;
+	ss->ss_max_inflight = MAX(nthreads, 1) * STAT_BATCHES_PER_THREAD;
+	tids = safe_malloc(MAX(nthreads, 1) * sizeof (pthread_t));
+	for (t = 0; t < nthreads; t++)
+		VERIFY0(pthread_create(&tids[t], NULL, stat_worker, ss));
+
+	if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) &&
+	    st.st_size > 0) {
+		ss->ss_map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED,
+		    STDIN_FILENO, 0);
+		if (ss->ss_map == MAP_FAILED) {
+			ss->ss_map = NULL;
+		} else {
+			ss->ss_maplen = st.st_size;
+			(void) madvise((void *)ss->ss_map, ss->ss_maplen,
+			    MADV_SEQUENTIAL);
+		}
+	}
+	if (ss->ss_map == NULL) {
+		(void) setvbuf(send_stream, NULL, _IOFBF,
+		    STAT_READ_BUFSIZE);
+	}
+
+	for (;;) {
+		const char *buf = stat_read(ss, sizeof (dmu_replay_record_t));
+		uint64_t start = total_stream_len - sizeof (*drr);
+		uint64_t len = 0;
+		uint32_t type;
+
+		if (buf == NULL)
+			break;
+		bcopy(buf, drr, sizeof (*drr));
+
+		if (first) {
+			if (drr->drr_u.drr_begin.drr_magic ==
+			    BSWAP_64(DMU_BACKUP_MAGIC)) {
+				do_byteswap = B_TRUE;
+			} else if (drr->drr_u.drr_begin.drr_magic !=
+			    DMU_BACKUP_MAGIC) {
+				(void) fprintf(stderr, "Invalid stream "
+				    "(bad magic number)\n");
+				exit(1);
+			}
+			first = B_FALSE;
+		}
+		if (do_byteswap) {
+			drr->drr_type = BSWAP_32(drr->drr_type);
+			drr->drr_payloadlen = BSWAP_32(drr->drr_payloadlen);
+		}
+		if (drr->drr_type >= DRR_NUMTYPES) {
+			(void) printf("INVALID record found: type 0x%x\n",
+			    drr->drr_type);
+			(void) printf("Aborting.\n");
+			exit(1);
+		}
+		drr_record_count[drr->drr_type]++;
+		total_records++;
+
+		/*
+		 * The END checksum covers everything before the record, and
+		 * the header checksum everything before the checksum field.
+		 */
+		if (drr->drr_type == DRR_END) {
+			stat_add_check(ss, B_TRUE,
+			    &drr->drr_u.drr_end.drr_checksum);
+		}
+		stat_add_piece(ss, buf, hdrlen);
+		stat_add_check(ss, B_FALSE,
+		    &drr->drr_u.drr_checksum.drr_checksum);
+		stat_add_piece(ss, buf + hdrlen, sizeof (zio_cksum_t));
+
+#define	SWAP32(x)	(do_byteswap ? BSWAP_32(x) : (x))
+#define	SWAP64(x)	(do_byteswap ? BSWAP_64(x) : (x))
+		switch (drr->drr_type) {
+		case DRR_BEGIN:
+			if (DMU_GET_STREAM_HDRTYPE(SWAP64(drr->drr_u.drr_begin.
+			    drr_versioninfo)) == DMU_COMPOUNDSTREAM)
+				len = drr->drr_payloadlen;
+			break;
+		case DRR_OBJECT:
+			type = SWAP32(drr->drr_u.drr_object.drr_type);
+			len = P2ROUNDUP((uint64_t)SWAP32(
+			    drr->drr_u.drr_object.drr_bonuslen), 8);
+			ss->ss_ot_objects[stat_ot(type)]++;
+			break;
+		case DRR_WRITE:
+			type = SWAP32(drr->drr_u.drr_write.drr_type);
+			len = SWAP64(drr->drr_u.drr_write.drr_length);
+			ss->ss_ot_writes[stat_ot(type)]++;
+			ss->ss_ot_bytes[stat_ot(type)] += len;
+			total_write_size += len;
+			break;
+		case DRR_SPILL:
+			len = SWAP64(drr->drr_u.drr_spill.drr_length);
+			break;
+		case DRR_WRITE_EMBEDDED:
+			len = P2ROUNDUP((uint64_t)SWAP32(
+			    drr->drr_u.drr_write_embedded.drr_psize), 8);
+			break;
+		default:
+			break;
+		}
+#undef	SWAP32
+#undef	SWAP64
+
+		if (len != 0 && !stat_payload(ss, len))
+			break;
+		ss->ss_record_bytes[drr->drr_type] += total_stream_len - start;
+
+		/* each stream in a compound stream is checksummed alone */
+		if (drr->drr_type == DRR_END)
+			stat_batch_close(ss, B_TRUE, B_FALSE);
+	}
+
+	stat_batch_close(ss, B_FALSE, B_TRUE);
+
+	pthread_mutex_lock(&ss->ss_lock);
+	ss->ss_exit = B_TRUE;
+	pthread_cond_broadcast(&ss->ss_cv);
+	pthread_mutex_unlock(&ss->ss_lock);
+	for (t = 0; t < nthreads; t++)
+		VERIFY0(pthread_join(tids[t], NULL));
+	free(tids);
+
+	if (ss->ss_map != NULL)
+		(void) munmap((void *)ss->ss_map, ss->ss_maplen);
+
+	stat_print(ss);
+	t = (ss->ss_end_errors != 0);
+	free(ss);
+	return (t);
+}
+
+static void
+print_summary(void)
+{
+	(void) printf("SUMMARY:\n");
+	(void) printf("\tTotal DRR_BEGIN records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_BEGIN]);
+	(void) printf("\tTotal DRR_END records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_END]);
+	(void) printf("\tTotal DRR_OBJECT records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_OBJECT]);
+	(void) printf("\tTotal DRR_FREEOBJECTS records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_FREEOBJECTS]);
+	(void) printf("\tTotal DRR_WRITE records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_WRITE]);
+	(void) printf("\tTotal DRR_WRITE_BYREF records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_WRITE_BYREF]);
+	(void) printf("\tTotal DRR_WRITE_EMBEDDED records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_WRITE_EMBEDDED]);
+	(void) printf("\tTotal DRR_FREE records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_FREE]);
+	(void) printf("\tTotal DRR_SPILL records = %lld\n",
+	    (u_longlong_t)drr_record_count[DRR_SPILL]);
+	(void) printf("\tTotal records = %lld\n",
+	    (u_longlong_t)total_records);
+	(void) printf("\tTotal write size = %lld (0x%llx)\n",
+	    (u_longlong_t)total_write_size, (u_longlong_t)total_write_size);
+	(void) printf("\tTotal stream length = %lld (0x%llx)\n",
+	    (u_longlong_t)total_stream_len, (u_longlong_t)total_stream_len);
+}
+
 int
 main(int argc, char *argv[])
 {
 	char *buf = safe_malloc(SPA_MAXBLOCKSIZE);
-	uint64_t drr_record_count[DRR_NUMTYPES] = { 0 };
-	uint64_t total_records = 0;
 	dmu_replay_record_t thedrr;
 	dmu_replay_record_t *drr = &thedrr;
 	struct drr_begin *drrb = &thedrr.drr_u.drr_begin;
@@ -224,11 +772,12 @@ main(int argc, char *argv[])
 	 * for large streams, this can obviously lead to massive prints.
 	 */
 	boolean_t dump = B_FALSE;
+	boolean_t stats = B_FALSE;
 	int err;
 	zio_cksum_t zc = { { 0 } };
 	zio_cksum_t pcksum = { { 0 } };
 
-	while ((c = getopt(argc, argv, ":vCd")) != -1) {
+	while ((c = getopt(argc, argv, ":vCds")) != -1) {
 		switch (c) {
 		case 'C':
 			do_cksum = B_FALSE;
@@ -243,6 +792,9 @@ main(int argc, char *argv[])
 			verbose = B_TRUE;
 			very_verbose = B_TRUE;
 			break;
+		case 's':
+			stats = B_TRUE;
+			break;
 		case ':':
 			(void) fprintf(stderr,
 			    "missing argument for '%c' option\n", optopt);
@@ -264,6 +816,19 @@ main(int argc, char *argv[])
 	}
 
 	send_stream = stdin;
+
+	if (stats) {
+		if (verbose) {
+			(void) fprintf(stderr, "-s cannot be combined "
+			    "with -v or -d\n");
+			usage();
+		}
+		free(buf);
+		err = stat_stream();
+		print_summary();
+		return (err);
+	}
+
 	while (read_hdr(drr, &zc)) {
 
 		/*
@@ -607,31 +1172,6 @@ main(int argc, char *argv[])
 	free(buf);
 
 	/* Print final summary */
-
-	(void) printf("SUMMARY:\n");
-	(void) printf("\tTotal DRR_BEGIN records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_BEGIN]);
-	(void) printf("\tTotal DRR_END records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_END]);
-	(void) printf("\tTotal DRR_OBJECT records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_OBJECT]);
-	(void) printf("\tTotal DRR_FREEOBJECTS records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_FREEOBJECTS]);
-	(void) printf("\tTotal DRR_WRITE records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_WRITE]);
-	(void) printf("\tTotal DRR_WRITE_BYREF records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_WRITE_BYREF]);
-	(void) printf("\tTotal DRR_WRITE_EMBEDDED records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_WRITE_EMBEDDED]);
-	(void) printf("\tTotal DRR_FREE records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_FREE]);
-	(void) printf("\tTotal DRR_SPILL records = %lld\n",
-	    (u_longlong_t)drr_record_count[DRR_SPILL]);
-	(void) printf("\tTotal records = %lld\n",
-	    (u_longlong_t)total_records);
-	(void) printf("\tTotal write size = %lld (0x%llx)\n",
-	    (u_longlong_t)total_write_size, (u_longlong_t)total_write_size);
-	(void) printf("\tTotal stream length = %lld (0x%llx)\n",
-	    (u_longlong_t)total_stream_len, (u_longlong_t)total_stream_len);
+	print_summary();
 	return (0);
 }
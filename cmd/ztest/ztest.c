@@ -142,6 +142,34 @@ typedef struct ztest_shared_hdr {
 
 static ztest_shared_hdr_t *ztest_shared_hdr;
 
+/*
+ * Operations timed by the benchmark mode (-b), in report order.
+ */
+enum ztest_bench_op {
+	ZTEST_BENCH_DMU_WRITE,
+	ZTEST_BENCH_ZAP_ADD,
+	ZTEST_BENCH_OBJECT_ALLOC,
+	ZTEST_BENCH_SPA_SYNC,
+	ZTEST_BENCH_OPS
+};
+
+static const char *ztest_bench_names[ZTEST_BENCH_OPS] = {
+	"dmu_write",
+	"zap_add",
+	"dmu_object_alloc",
+	"spa_sync"
+};
+
+static const uint64_t ztest_bench_default_mix[ZTEST_BENCH_OPS] = {
+	50, 35, 14, 1
+};
+
+/*
+ * Upper bound on the sum of the benchmark weights, which is also the
+ * length of the operation schedule.
+ */
+#define	ZTEST_BENCH_MIX_MAX	10000
+
 typedef struct ztest_shared_opts {
 	char zo_pool[MAXNAMELEN];
 	char zo_dir[MAXNAMELEN];
@@ -163,6 +191,8 @@ typedef struct ztest_shared_opts {
 	uint64_t zo_time;
 	uint64_t zo_maxloops;
 	uint64_t zo_metaslab_gang_bang;
+	int zo_bench;
+	uint64_t zo_bench_mix[ZTEST_BENCH_OPS];
 } ztest_shared_opts_t;
 
 static const ztest_shared_opts_t ztest_opts_defaults = {
@@ -190,6 +220,7 @@ static const ztest_shared_opts_t ztest_opts_defaults = {
 extern uint64_t metaslab_gang_bang;
 extern uint64_t metaslab_df_alloc_threshold;
 extern int metaslab_preload_limit;
+extern int zap_hash_crc32c;
 
 static ztest_shared_opts_t *ztest_shared_opts;
 static ztest_shared_opts_t ztest_opts;
@@ -627,6 +658,10 @@ usage(boolean_t requested)
 	    "\t[-F freezeloops (default: %llu)] max loops in spa_freeze()\n"
 	    "\t[-P passtime (default: %llu sec)] time per pass\n"
 	    "\t[-B alt_ztest (default: <none>)] alternate ztest path\n"
+	    "\t[-b op=weight,... | default] benchmark mode; ops are\n"
+	    "\t    dmu_write, zap_add, dmu_object_alloc and spa_sync\n"
+	    "\t    (default: dmu_write=%llu,zap_add=%llu,"
+	    "dmu_object_alloc=%llu,spa_sync=%llu)\n"
 	    "\t[-h] (print help)\n"
 	    "",
 	    zo->zo_pool,
@@ -645,10 +680,62 @@ usage(boolean_t requested)
 	    zo->zo_dir,					/* -f */
 	    (u_longlong_t)zo->zo_time,			/* -T */
 	    (u_longlong_t)zo->zo_maxloops,		/* -F */
-	    (u_longlong_t)zo->zo_passtime);
+	    (u_longlong_t)zo->zo_passtime,
+	    (u_longlong_t)ztest_bench_default_mix[ZTEST_BENCH_DMU_WRITE],
+	    (u_longlong_t)ztest_bench_default_mix[ZTEST_BENCH_ZAP_ADD],
+	    (u_longlong_t)ztest_bench_default_mix[ZTEST_BENCH_OBJECT_ALLOC],
+	    (u_longlong_t)ztest_bench_default_mix[ZTEST_BENCH_SPA_SYNC]);
 	exit(requested ? 0 : 1);
 }
 
+/*
+ * Parse a benchmark mix of the form "op=weight,op=weight,...".  Operations
+ * which are not listed are not run.
+ */
+static void
+ztest_bench_parse_mix(const char *arg, uint64_t *mix)
+{
+	char *buf, *tok, *val, *last = NULL;
+	uint64_t total = 0;
+	int op;
+
+	if (strcmp(arg, "default") == 0) {
+		bcopy(ztest_bench_default_mix, mix,
+		    sizeof (ztest_bench_default_mix));
+		return;
+	}
+
+	bzero(mix, sizeof (uint64_t) * ZTEST_BENCH_OPS);
+	buf = strdup(arg);
+	for (tok = strtok_r(buf, ",", &last); tok != NULL;
+	    tok = strtok_r(NULL, ",", &last)) {
+		if ((val = strchr(tok, '=')) == NULL) {
+			(void) fprintf(stderr, "error: benchmark operation "
+			    "'%s' has no weight\n", tok);
+			usage(B_FALSE);
+		}
+		*val++ = '\0';
+		for (op = 0; op < ZTEST_BENCH_OPS; op++) {
+			if (strcmp(tok, ztest_bench_names[op]) == 0)
+				break;
+		}
+		if (op == ZTEST_BENCH_OPS) {
+			(void) fprintf(stderr, "error: unknown benchmark "
+			    "operation '%s'\n", tok);
+			usage(B_FALSE);
+		}
+		mix[op] = nicenumtoull(val);
+		total += mix[op];
+	}
+	free(buf);
+
+	if (total == 0 || total > ZTEST_BENCH_MIX_MAX) {
+		(void) fprintf(stderr, "error: benchmark weights must add up "
+		    "to between 1 and %d\n", ZTEST_BENCH_MIX_MAX);
+		usage(B_FALSE);
+	}
+}
+
 static void
 process_options(int argc, char **argv)
 {
@@ -662,7 +749,7 @@ process_options(int argc, char **argv)
 	bcopy(&ztest_opts_defaults, zo, sizeof (*zo));
 
 	while ((opt = getopt(argc, argv,
-	    "v:s:a:m:r:R:d:t:g:i:k:p:f:VET:P:hF:B:")) != EOF) {
+	    "v:s:a:m:r:R:d:t:g:i:k:p:f:VET:P:hF:B:b:")) != EOF) {
 		value = 0;
 		switch (opt) {
 		case 'v':
@@ -749,6 +836,10 @@ process_options(int argc, char **argv)
 		case 'B':
 			(void) strlcpy(altdir, optarg, sizeof (altdir));
 			break;
+		case 'b':
+			zo->zo_bench = 1;
+			ztest_bench_parse_mix(optarg, zo->zo_bench_mix);
+			break;
 		case 'h':
 			usage(B_TRUE);
 			break;
@@ -3654,6 +3745,85 @@ ztest_dmu_object_alloc_free(ztest_ds_t *zd, uint64_t id)
 	umem_free(od, size);
 }
 
+typedef struct ztest_read_async {
+	kmutex_t	zra_lock;
+	kcondvar_t	zra_cv;
+	boolean_t	zra_done;
+	int		zra_error;
+	uint64_t	zra_offset;
+	uint64_t	zra_size;
+	char		*zra_buf;
+} ztest_read_async_t;
+
+static void
+ztest_dmu_read_async_done(void *arg, dmu_buf_t **dbp, int numbufs, int error)
+{
+	ztest_read_async_t *zra = arg;
+	uint64_t offset = zra->zra_offset;
+	uint64_t size = zra->zra_size;
+	char *buf = zra->zra_buf;
+	int i;
+
+	for (i = 0; error == 0 && i < numbufs; i++) {
+		dmu_buf_t *db = dbp[i];
+		uint64_t bufoff = offset - db->db_offset;
+		uint64_t tocpy = MIN(db->db_size - bufoff, size);
+
+		bcopy((char *)db->db_data + bufoff, buf, tocpy);
+		offset += tocpy;
+		size -= tocpy;
+		buf += tocpy;
+	}
+	ASSERT(error != 0 || size == 0);
+	dmu_buf_rele_array(dbp, numbufs, zra);
+
+	mutex_enter(&zra->zra_lock);
+	zra->zra_error = error;
+	zra->zra_done = B_TRUE;
+	cv_signal(&zra->zra_cv);
+	mutex_exit(&zra->zra_lock);
+}
+
+/*
+ * Read a range of an object through dmu_read_async(), and wait for it.
+ */
+static int
+ztest_dmu_read_async(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t size, void *buf)
+{
+	ztest_read_async_t zra;
+	dmu_buf_t *db;
+	int error;
+
+	error = dmu_bonus_hold(os, object, FTAG, &db);
+	if (error)
+		return (error);
+
+	mutex_init(&zra.zra_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zra.zra_cv, NULL, CV_DEFAULT, NULL);
+	zra.zra_done = B_FALSE;
+	zra.zra_error = 0;
+	zra.zra_offset = offset;
+	zra.zra_size = size;
+	zra.zra_buf = buf;
+
+	error = dmu_read_async_dbuf(db, offset, size, DMU_READ_PREFETCH,
+	    ztest_dmu_read_async_done, &zra);
+	if (error == 0) {
+		mutex_enter(&zra.zra_lock);
+		while (!zra.zra_done)
+			cv_wait(&zra.zra_cv, &zra.zra_lock);
+		mutex_exit(&zra.zra_lock);
+		error = zra.zra_error;
+	}
+
+	cv_destroy(&zra.zra_cv);
+	mutex_destroy(&zra.zra_lock);
+	dmu_buf_rele(db, FTAG);
+
+	return (error);
+}
+
 #undef OD_ARRAY_SIZE
 #define	OD_ARRAY_SIZE	2
 
@@ -3670,9 +3840,10 @@ ztest_dmu_read_write(ztest_ds_t *zd, uint64_t id)
 	size = sizeof (ztest_od_t) * OD_ARRAY_SIZE;
 	od = umem_alloc(size, UMEM_NOFAIL);
 	dmu_tx_t *tx;
-	int i, freeit, error;
+	int i, freeit, batchit, error;
 	uint64_t n, s, txg;
 	bufwad_t *packbuf, *bigbuf, *pack, *bigH, *bigT;
+	dmu_write_range_t *dwr = NULL;
 	uint64_t packobj, packoff, packsize, bigobj, bigoff, bigsize;
 	uint64_t chunksize = (1000 + ztest_random(1000)) * sizeof (uint64_t);
 	uint64_t regions = 997;
@@ -3752,6 +3923,26 @@ ztest_dmu_read_write(ztest_ds_t *zd, uint64_t id)
 	 */
 	freeit = (ztest_random(100) < free_percent);
 
+	/*
+	 * Half of the time write the objects as a batch, with one range
+	 * for packobj and one for each chunk of bigobj.
+	 */
+	batchit = (!freeit && ztest_random(2) == 0);
+	if (batchit) {
+		dwr = umem_zalloc((s + 1) * sizeof (dmu_write_range_t),
+		    UMEM_NOFAIL);
+		dwr[0].dwr_object = packobj;
+		dwr[0].dwr_offset = packoff;
+		dwr[0].dwr_length = packsize;
+		dwr[0].dwr_data = packbuf;
+		for (i = 0; i < s; i++) {
+			dwr[i + 1].dwr_object = bigobj;
+			dwr[i + 1].dwr_offset = bigoff + i * chunksize;
+			dwr[i + 1].dwr_length = chunksize;
+			dwr[i + 1].dwr_data = (char *)bigbuf + i * chunksize;
+		}
+	}
+
 	/*
 	 * Read the current contents of our objects.
 	 */
@@ -3762,23 +3953,42 @@ ztest_dmu_read_write(ztest_ds_t *zd, uint64_t id)
 	    DMU_READ_PREFETCH);
 	ASSERT0(error);
 
+	/*
+	 * Occasionally read bigobj again through the asynchronous
+	 * interface, which must return the same contents.
+	 */
+	if (ztest_random(4) == 0) {
+		void *abuf = umem_alloc(bigsize, UMEM_NOFAIL);
+
+		VERIFY0(ztest_dmu_read_async(os, bigobj, bigoff, bigsize,
+		    abuf));
+		VERIFY0(bcmp(abuf, bigbuf, bigsize));
+		umem_free(abuf, bigsize);
+	}
+
 	/*
 	 * Get a tx for the mods to both packobj and bigobj.
 	 */
 	tx = dmu_tx_create(os);
 
-	dmu_tx_hold_write(tx, packobj, packoff, packsize);
+	if (batchit) {
+		dmu_tx_hold_write_batch(tx, dwr, s + 1);
+	} else {
+		dmu_tx_hold_write(tx, packobj, packoff, packsize);
 
-	if (freeit)
-		dmu_tx_hold_free(tx, bigobj, bigoff, bigsize);
-	else
-		dmu_tx_hold_write(tx, bigobj, bigoff, bigsize);
+		if (freeit)
+			dmu_tx_hold_free(tx, bigobj, bigoff, bigsize);
+		else
+			dmu_tx_hold_write(tx, bigobj, bigoff, bigsize);
+	}
 
 	/* This accounts for setting the checksum/compression. */
 	dmu_tx_hold_bonus(tx, bigobj);
 
 	txg = ztest_tx_assign(tx, TXG_MIGHTWAIT, FTAG);
 	if (txg == 0) {
+		if (dwr != NULL)
+			umem_free(dwr, (s + 1) * sizeof (dmu_write_range_t));
 		umem_free(packbuf, packsize);
 		umem_free(bigbuf, bigsize);
 		umem_free(od, size);
@@ -3845,9 +4055,20 @@ ztest_dmu_read_write(ztest_ds_t *zd, uint64_t id)
 	 * We've verified all the old bufwads, and made new ones.
 	 * Now write them out.
 	 */
-	dmu_write(os, packobj, packoff, packsize, packbuf, tx);
+	if (!batchit)
+		dmu_write(os, packobj, packoff, packsize, packbuf, tx);
 
-	if (freeit) {
+	if (batchit) {
+		if (ztest_opts.zo_verbose >= 7) {
+			(void) printf("batch writing offset %llx size %llx"
+			    " txg %llx\n",
+			    (u_longlong_t)bigoff,
+			    (u_longlong_t)bigsize,
+			    (u_longlong_t)txg);
+		}
+		VERIFY0(dmu_write_batch(os, dwr, s + 1, tx));
+		umem_free(dwr, (s + 1) * sizeof (dmu_write_range_t));
+	} else if (freeit) {
 		if (ztest_opts.zo_verbose >= 7) {
 			(void) printf("freeing offset %llx size %llx"
 			    " txg %llx\n",
@@ -4455,7 +4676,7 @@ ztest_zap_parallel(ztest_ds_t *zd, uint64_t id)
 	dmu_tx_t *tx;
 	int i, namelen, error;
 	int micro = ztest_random(2);
-	char name[20], string_value[20];
+	char name[100], string_value[100];
 	void *data;
 
 	od = umem_alloc(sizeof (ztest_od_t), UMEM_NOFAIL);
@@ -4472,7 +4693,8 @@ ztest_zap_parallel(ztest_ds_t *zd, uint64_t id)
 	 * Generate a random name of the form 'xxx.....' where each
 	 * x is a random printable character and the dots are dots.
 	 * There are 94 such characters, and the name length goes from
-	 * 6 to 20, so there are 94^3 * 15 = 12,458,760 possible names.
+	 * 6 to 100, so there are 94^3 * 95 = 78,905,480 possible names.
+	 * Names longer than MZAP_NAME_LEN exercise large_microzap chains.
 	 */
 	namelen = ztest_random(sizeof (name) - 5) + 5 + 1;
 
@@ -4790,6 +5012,14 @@ ztest_dsl_prop_get_set(ztest_ds_t *zd, uint64_t id)
 	VERIFY0(ztest_dsl_prop_set_uint64(zd->zd_name, ZFS_PROP_RECORDSIZE,
 	    ztest_random_blocksize(), (int)ztest_random(2)));
 
+	/*
+	 * Usually leave the dirty data limit unset, otherwise pick one small
+	 * enough that writers regularly wait on it.
+	 */
+	(void) ztest_dsl_prop_set_uint64(zd->zd_name, ZFS_PROP_DIRTY_LIMIT,
+	    ztest_random(4) ? 0 : (1ULL << 20) << ztest_random(5),
+	    (int)ztest_random(2));
+
 	(void) rw_unlock(&ztest_name_lock);
 }
 
@@ -5805,6 +6035,408 @@ ztest_dataset_close(int d)
 	ztest_zd_fini(zd);
 }
 
+/*
+ * Benchmark mode.
+ *
+ * Rather than picking random tests and verifying the results, every
+ * thread repeatedly runs one of a small set of operations, chosen from a
+ * fixed schedule built from the -b weights, and records how long each one
+ * took.  There is no fault injection and no forced kill, so the numbers
+ * reflect the DMU, ZAP and txg code alone and can be compared between
+ * builds.
+ */
+
+#define	ZTEST_BENCH_BLOCKSIZE	(4ULL << 10)
+#define	ZTEST_BENCH_BLOCKS	256	/* blocks rewritten by dmu_write */
+#define	ZTEST_BENCH_ZAP_ENTRIES	4096	/* live entries in each zap */
+
+/*
+ * Latencies are kept in a log-linear histogram: values below 16ns get a
+ * bucket each, and every power of two above that is split into 8 buckets,
+ * so any reported percentile is within 12.5% of the true value.
+ */
+#define	ZTEST_BENCH_SUBBITS	3
+#define	ZTEST_BENCH_LINEAR	(2 << ZTEST_BENCH_SUBBITS)
+#define	ZTEST_BENCH_BUCKETS	(ZTEST_BENCH_LINEAR + \
+	(64 - ZTEST_BENCH_SUBBITS - 1) * (1 << ZTEST_BENCH_SUBBITS))
+
+typedef struct ztest_bench_stats {
+	uint64_t	zbs_count;
+	uint64_t	zbs_time;
+	uint64_t	zbs_max;
+	uint64_t	zbs_hist[ZTEST_BENCH_BUCKETS];
+} ztest_bench_stats_t;
+
+typedef struct ztest_bench_thread {
+	ztest_ds_t	*zbt_zd;
+	uint64_t	zbt_id;
+	ztest_od_t	zbt_od[2];	/* dmu_write file, zap_add zap */
+	uint64_t	zbt_writes;
+	uint64_t	zbt_zap_adds;
+	void		*zbt_buf;
+	ztest_bench_stats_t zbt_stats[ZTEST_BENCH_OPS];
+} ztest_bench_thread_t;
+
+typedef void ztest_bench_func_t(ztest_bench_thread_t *zbt);
+
+static uint8_t *ztest_bench_sched;
+static uint64_t ztest_bench_sched_len;
+static hrtime_t ztest_bench_stop;
+
+static int
+ztest_bench_bucket(uint64_t ns)
+{
+	int shift;
+
+	if (ns < ZTEST_BENCH_LINEAR)
+		return (ns);
+	shift = highbit64(ns) - 1 - ZTEST_BENCH_SUBBITS;
+	return (ZTEST_BENCH_LINEAR + (shift - 1) * (1 << ZTEST_BENCH_SUBBITS) +
+	    ((ns >> shift) & ((1 << ZTEST_BENCH_SUBBITS) - 1)));
+}
+
+/*
+ * Largest value which falls into the given bucket.
+ */
+static uint64_t
+ztest_bench_bucket_max(int b)
+{
+	uint64_t top;
+	int shift;
+
+	if (b < ZTEST_BENCH_LINEAR)
+		return (b);
+	shift = (b - ZTEST_BENCH_LINEAR) / (1 << ZTEST_BENCH_SUBBITS) + 1;
+	top = (1 << ZTEST_BENCH_SUBBITS) +
+	    (b - ZTEST_BENCH_LINEAR) % (1 << ZTEST_BENCH_SUBBITS) + 1;
+	return ((top << shift) - 1);
+}
+
+static uint64_t
+ztest_bench_percentile(ztest_bench_stats_t *zbs, double pct)
+{
+	uint64_t target = (uint64_t)ceil(zbs->zbs_count * pct / 100.0);
+	uint64_t seen = 0;
+	int b;
+
+	for (b = 0; b < ZTEST_BENCH_BUCKETS; b++) {
+		seen += zbs->zbs_hist[b];
+		if (seen >= MAX(target, 1))
+			return (MIN(ztest_bench_bucket_max(b), zbs->zbs_max));
+	}
+	return (zbs->zbs_max);
+}
+
+static void
+ztest_bench_assign(dmu_tx_t *tx)
+{
+	int error = dmu_tx_assign(tx, TXG_WAIT);
+
+	if (error != 0)
+		fatal(0, "benchmark tx assign failed, error %d; "
+		    "try larger vdevs (-s)", error);
+}
+
+/*
+ * Rewrite one block of a per-thread file, cycling over a fixed range so
+ * the pool does not fill up.
+ */
+static void
+ztest_bench_dmu_write(ztest_bench_thread_t *zbt)
+{
+	objset_t *os = zbt->zbt_zd->zd_os;
+	uint64_t object = zbt->zbt_od[0].od_object;
+	uint64_t offset = (zbt->zbt_writes++ % ZTEST_BENCH_BLOCKS) *
+	    ZTEST_BENCH_BLOCKSIZE;
+	dmu_tx_t *tx;
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_write(tx, object, offset, ZTEST_BENCH_BLOCKSIZE);
+	ztest_bench_assign(tx);
+	dmu_write(os, object, offset, ZTEST_BENCH_BLOCKSIZE, zbt->zbt_buf, tx);
+	dmu_tx_commit(tx);
+}
+
+/*
+ * Add a new name to a per-thread zap.  Once the zap holds
+ * ZTEST_BENCH_ZAP_ENTRIES names the oldest one is removed in the same tx,
+ * so the measurement covers a large fat zap of constant size.
+ */
+static void
+ztest_bench_zap_add(ztest_bench_thread_t *zbt)
+{
+	objset_t *os = zbt->zbt_zd->zd_os;
+	uint64_t object = zbt->zbt_od[1].od_object;
+	uint64_t seq = zbt->zbt_zap_adds;
+	boolean_t full = (seq >= ZTEST_BENCH_ZAP_ENTRIES);
+	char name[32], oldname[32];
+	dmu_tx_t *tx;
+
+	(void) snprintf(name, sizeof (name), "bench-%llu", (u_longlong_t)seq);
+	(void) snprintf(oldname, sizeof (oldname), "bench-%llu",
+	    (u_longlong_t)(seq - ZTEST_BENCH_ZAP_ENTRIES));
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_zap(tx, object, B_TRUE, name);
+	if (full)
+		dmu_tx_hold_zap(tx, object, B_FALSE, oldname);
+	ztest_bench_assign(tx);
+	VERIFY0(zap_add(os, object, name, sizeof (uint64_t), 1, &seq, tx));
+	if (full)
+		VERIFY0(zap_remove(os, object, oldname, tx));
+	dmu_tx_commit(tx);
+
+	zbt->zbt_zap_adds++;
+}
+
+/*
+ * Allocate an object and free it again in the following tx.
+ */
+static void
+ztest_bench_object_alloc(ztest_bench_thread_t *zbt)
+{
+	objset_t *os = zbt->zbt_zd->zd_os;
+	uint64_t object;
+	dmu_tx_t *tx;
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+	ztest_bench_assign(tx);
+	object = dmu_object_alloc(os, DMU_OT_UINT64_OTHER, 0,
+	    DMU_OT_NONE, 0, tx);
+	dmu_tx_commit(tx);
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_free(tx, object, 0, DMU_OBJECT_END);
+	ztest_bench_assign(tx);
+	VERIFY0(dmu_object_free(os, object, tx));
+	dmu_tx_commit(tx);
+}
+
+/*
+ * Wait for the open txg to be synced.
+ */
+static void
+ztest_bench_spa_sync(ztest_bench_thread_t *zbt)
+{
+	txg_wait_synced(dmu_objset_pool(zbt->zbt_zd->zd_os), 0);
+}
+
+static ztest_bench_func_t *ztest_bench_funcs[ZTEST_BENCH_OPS] = {
+	ztest_bench_dmu_write,
+	ztest_bench_zap_add,
+	ztest_bench_object_alloc,
+	ztest_bench_spa_sync
+};
+
+/*
+ * Spread the operations evenly over a schedule of sum(weights) slots,
+ * so that every window of the schedule has close to the requested mix.
+ */
+static void
+ztest_bench_build_sched(const uint64_t *mix)
+{
+	int64_t credit[ZTEST_BENCH_OPS] = { 0 };
+	uint64_t total = 0;
+	uint64_t i;
+	int op, best;
+
+	for (op = 0; op < ZTEST_BENCH_OPS; op++)
+		total += mix[op];
+
+	ztest_bench_sched_len = total;
+	ztest_bench_sched = umem_alloc(total, UMEM_NOFAIL);
+
+	for (i = 0; i < total; i++) {
+		best = 0;
+		for (op = 0; op < ZTEST_BENCH_OPS; op++) {
+			credit[op] += mix[op];
+			if (credit[op] > credit[best])
+				best = op;
+		}
+		credit[best] -= total;
+		ztest_bench_sched[i] = best;
+	}
+}
+
+static void *
+ztest_bench_thread(void *arg)
+{
+	ztest_bench_thread_t *zbt = arg;
+	uint64_t pos;
+
+	/*
+	 * Stagger the starting points so that the threads don't all
+	 * wait for a txg sync at the same moment.
+	 */
+	pos = zbt->zbt_id * ztest_bench_sched_len / ztest_opts.zo_threads;
+
+	while (gethrtime() < ztest_bench_stop) {
+		int op = ztest_bench_sched[pos++ % ztest_bench_sched_len];
+		ztest_bench_stats_t *zbs = &zbt->zbt_stats[op];
+		hrtime_t start = gethrtime();
+		uint64_t delta;
+
+		ztest_bench_funcs[op](zbt);
+
+		delta = gethrtime() - start;
+		zbs->zbs_count++;
+		zbs->zbs_time += delta;
+		zbs->zbs_max = MAX(zbs->zbs_max, delta);
+		zbs->zbs_hist[ztest_bench_bucket(delta)]++;
+	}
+
+	thread_exit();
+
+	return (NULL);
+}
+
+static void
+ztest_bench_merge(ztest_bench_stats_t *dst, ztest_bench_stats_t *src)
+{
+	int b;
+
+	dst->zbs_count += src->zbs_count;
+	dst->zbs_time += src->zbs_time;
+	dst->zbs_max = MAX(dst->zbs_max, src->zbs_max);
+	for (b = 0; b < ZTEST_BENCH_BUCKETS; b++)
+		dst->zbs_hist[b] += src->zbs_hist[b];
+}
+
+static void
+ztest_bench_print(ztest_bench_stats_t *zbs, const char *name, double secs)
+{
+	(void) printf("%-18s %10llu %11.1f %9.1f %9.1f %9.1f %9.1f %9.1f "
+	    "%9.1f\n", name, (u_longlong_t)zbs->zbs_count,
+	    zbs->zbs_count / secs,
+	    zbs->zbs_count ? zbs->zbs_time / 1000.0 / zbs->zbs_count : 0.0,
+	    ztest_bench_percentile(zbs, 50) / 1000.0,
+	    ztest_bench_percentile(zbs, 90) / 1000.0,
+	    ztest_bench_percentile(zbs, 99) / 1000.0,
+	    ztest_bench_percentile(zbs, 99.9) / 1000.0,
+	    zbs->zbs_max / 1000.0);
+}
+
+/*
+ * Run the benchmark in this process against the pool created by
+ * ztest_init() and print ops/sec and latency percentiles per operation.
+ */
+static void
+ztest_bench_run(ztest_shared_t *zs)
+{
+	ztest_bench_thread_t *zbt;
+	ztest_bench_stats_t *total;
+	kt_did_t *tid;
+	spa_t *spa;
+	hrtime_t start;
+	double secs;
+	int t, d, op;
+
+	mutex_init(&ztest_vdev_lock, NULL, MUTEX_DEFAULT, NULL);
+	VERIFY(rwlock_init(&ztest_name_lock, USYNC_THREAD, NULL) == 0);
+
+	kernel_init(FREAD | FWRITE);
+	VERIFY0(spa_open(ztest_opts.zo_pool, &spa, FTAG));
+	ztest_spa = spa;
+
+	ztest_bench_build_sched(ztest_opts.zo_bench_mix);
+
+	zbt = umem_zalloc(ztest_opts.zo_threads * sizeof (*zbt), UMEM_NOFAIL);
+	tid = umem_zalloc(ztest_opts.zo_threads * sizeof (kt_did_t),
+	    UMEM_NOFAIL);
+
+	for (d = 0; d < ztest_opts.zo_datasets; d++) {
+		if (ztest_dataset_open(d) != 0)
+			fatal(0, "cannot open dataset %d for benchmark", d);
+	}
+
+	/*
+	 * Create each thread's objects before starting the clock.
+	 */
+	for (t = 0; t < ztest_opts.zo_threads; t++) {
+		ztest_bench_thread_t *z = &zbt[t];
+		uint64_t *buf;
+		int i;
+
+		z->zbt_id = t;
+		z->zbt_zd = &ztest_ds[t % ztest_opts.zo_datasets];
+		ztest_od_init(&z->zbt_od[0], t, FTAG, 0, DMU_OT_UINT64_OTHER,
+		    ZTEST_BENCH_BLOCKSIZE, 0);
+		ztest_od_init(&z->zbt_od[1], t, FTAG, 1, DMU_OT_ZAP_OTHER,
+		    0, 0);
+		if (ztest_object_init(z->zbt_zd, z->zbt_od,
+		    sizeof (z->zbt_od), B_TRUE) != 0)
+			fatal(0, "cannot create benchmark objects");
+
+		buf = z->zbt_buf = umem_alloc(ZTEST_BENCH_BLOCKSIZE,
+		    UMEM_NOFAIL);
+		for (i = 0; i < ZTEST_BENCH_BLOCKSIZE / sizeof (*buf); i++)
+			buf[i] = ztest_random(-1ULL);
+	}
+	txg_wait_synced(spa_get_dsl(spa), 0);
+
+	start = gethrtime();
+	ztest_bench_stop = start + ztest_opts.zo_time * NANOSEC;
+
+	for (t = 0; t < ztest_opts.zo_threads; t++) {
+		kthread_t *thread;
+
+		VERIFY3P(thread = zk_thread_create(NULL, 0,
+		    (thread_func_t)ztest_bench_thread, &zbt[t], TS_RUN,
+		    NULL, 0, 0, PTHREAD_CREATE_JOINABLE), !=, NULL);
+		tid[t] = thread->t_tid;
+	}
+	for (t = 0; t < ztest_opts.zo_threads; t++)
+		thread_join(tid[t]);
+
+	secs = (double)(gethrtime() - start) / NANOSEC;
+
+	for (d = ztest_opts.zo_datasets - 1; d >= 0; d--)
+		ztest_dataset_close(d);
+	txg_wait_synced(spa_get_dsl(spa), 0);
+
+	zs->zs_alloc = metaslab_class_get_alloc(spa_normal_class(spa));
+	zs->zs_space = metaslab_class_get_space(spa_normal_class(spa));
+
+	spa_close(spa, FTAG);
+	kernel_fini();
+
+	/*
+	 * Merge the per-thread statistics; slot ZTEST_BENCH_OPS is the
+	 * total over all operations.
+	 */
+	total = umem_zalloc((ZTEST_BENCH_OPS + 1) * sizeof (*total),
+	    UMEM_NOFAIL);
+	for (t = 0; t < ztest_opts.zo_threads; t++) {
+		for (op = 0; op < ZTEST_BENCH_OPS; op++) {
+			ztest_bench_merge(&total[op], &zbt[t].zbt_stats[op]);
+			ztest_bench_merge(&total[ZTEST_BENCH_OPS],
+			    &zbt[t].zbt_stats[op]);
+		}
+		umem_free(zbt[t].zbt_buf, ZTEST_BENCH_BLOCKSIZE);
+	}
+
+	(void) printf("\nBenchmark: %d threads, %d datasets, %.1f seconds\n\n",
+	    ztest_opts.zo_threads, ztest_opts.zo_datasets, secs);
+	(void) printf("%-18s %10s %11s %9s %9s %9s %9s %9s %9s\n",
+	    "Operation", "Count", "Ops/sec", "Avg(us)", "p50(us)", "p90(us)",
+	    "p99(us)", "p99.9(us)", "Max(us)");
+	for (op = 0; op < ZTEST_BENCH_OPS; op++) {
+		if (ztest_opts.zo_bench_mix[op] != 0)
+			ztest_bench_print(&total[op], ztest_bench_names[op],
+			    secs);
+	}
+	ztest_bench_print(&total[ZTEST_BENCH_OPS], "total", secs);
+
+	umem_free(total, (ZTEST_BENCH_OPS + 1) * sizeof (*total));
+	umem_free(tid, ztest_opts.zo_threads * sizeof (kt_did_t));
+	umem_free(zbt, ztest_opts.zo_threads * sizeof (*zbt));
+	umem_free(ztest_bench_sched, ztest_bench_sched_len);
+
+	(void) rwlock_destroy(&ztest_name_lock);
+	mutex_destroy(&ztest_vdev_lock);
+}
+
 /*
  * Kick off threads to run tests on all datasets in parallel.
  */
@@ -5849,6 +6481,7 @@ ztest_run(ztest_shared_t *zs)
 	VERIFY0(spa_open(ztest_opts.zo_pool, &spa, FTAG));
 	spa->spa_debug = B_TRUE;
 	metaslab_preload_limit = ztest_random(20) + 1;
+	zap_hash_crc32c = ztest_random(2);
 	ztest_spa = spa;
 
 	VERIFY0(dmu_objset_own(ztest_opts.zo_pool,
@@ -6459,6 +7092,12 @@ main(int argc, char **argv)
 	}
 	zs->zs_do_init = B_FALSE;
 
+	if (ztest_opts.zo_bench) {
+		ztest_bench_run(zs);
+		umem_free(cmd, MAXNAMELEN);
+		return (0);
+	}
+
 	zs->zs_proc_start = gethrtime();
 	zs->zs_proc_stop = zs->zs_proc_start + ztest_opts.zo_time * NANOSEC;
 
@@ -0,0 +1,20 @@
+dnl #
+dnl # 4.1 API change
+dnl # aio_complete() was replaced by the kiocb->ki_complete() callback.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_KIOCB_KI_COMPLETE], [
+	AC_MSG_CHECKING([whether kiocb->ki_complete() exists])
+	ZFS_LINUX_TRY_COMPILE([
+		#include <linux/fs.h>
+	],[
+		struct kiocb kiocb __attribute__ ((unused));
+
+		kiocb.ki_complete = NULL;
+	],[
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_KIOCB_KI_COMPLETE, 1,
+		    [kiocb->ki_complete() exists])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
@@ -166,6 +166,19 @@ typedef struct l1arc_buf_hdr {
 	void			*b_tmp_cdata;
 } l1arc_buf_hdr_t;
 
+/*
+ * Per-device L2ARC statistics, exported as zfs/<pool>/l2arc_<guid>.
+ */
+typedef struct l2arc_dev_stats {
+	kstat_named_t	l2ds_feeds;
+	kstat_named_t	l2ds_hits;
+	kstat_named_t	l2ds_read_bytes;
+	kstat_named_t	l2ds_writes_sent;
+	kstat_named_t	l2ds_write_bytes;
+	kstat_named_t	l2ds_evicts;
+	kstat_named_t	l2ds_evict_bytes;
+} l2arc_dev_stats_t;
+
 typedef struct l2arc_dev {
 	vdev_t			*l2ad_vdev;	/* vdev */
 	spa_t			*l2ad_spa;	/* spa */
@@ -178,6 +191,12 @@ typedef struct l2arc_dev {
 	list_t			l2ad_buflist;	/* buffer list */
 	list_node_t		l2ad_node;	/* device list node */
 	refcount_t		l2ad_alloc;	/* allocated bytes */
+	kmutex_t		l2ad_feed_lock;	/* feed thread lock */
+	kcondvar_t		l2ad_feed_cv;	/* feed thread wakeup */
+	kthread_t		*l2ad_feed_thread; /* feed thread */
+	uint8_t			l2ad_thread_exit; /* feed thread exit flag */
+	kstat_t			*l2ad_ksp;	/* per-device kstat */
+	l2arc_dev_stats_t	l2ad_stats;	/* per-device counters */
 } l2arc_dev_t;
 
 typedef struct l2arc_buf_hdr {
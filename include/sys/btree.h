@@ -0,0 +1,167 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_SYS_BTREE_H
+#define	_SYS_BTREE_H
+
+#include <sys/zfs_context.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * This is a generic in-memory B-tree for ordered sets of small, fixed-size
+ * elements.  Unlike the AVL tree, elements are stored by value inside the
+ * tree nodes, so a lookup touches a handful of contiguous nodes instead of
+ * chasing one pointer per level, and the tree needs no per-element node
+ * embedded in the caller's structure.
+ *
+ * The interfaces intentionally mirror avl.h:
+ *
+ *	zfs_btree_create()	avl_create()
+ *	zfs_btree_find()	avl_find()
+ *	zfs_btree_add_idx()	avl_insert()
+ *	zfs_btree_add()		avl_add()
+ *	zfs_btree_remove()	avl_remove()
+ *	zfs_btree_first()	avl_first()
+ *	zfs_btree_last()	avl_last()
+ *	zfs_btree_next()	AVL_NEXT() / avl_nearest(..., AVL_AFTER)
+ *	zfs_btree_prev()	AVL_PREV() / avl_nearest(..., AVL_BEFORE)
+ *	zfs_btree_numnodes()	avl_numnodes()
+ *	zfs_btree_clear()	avl_destroy_nodes() loop
+ *	zfs_btree_destroy()	avl_destroy()
+ *
+ * There is one important difference: because elements live inside the
+ * nodes, any modification of the tree (add or remove) may move other
+ * elements.  Pointers returned by the lookup functions, and index cookies,
+ * are only valid until the next add or remove.  Callers may modify an
+ * element in place as long as its position in the ordering is unchanged.
+ *
+ * As with AVL trees, all locking is the responsibility of the caller.
+ */
+
+/*
+ * All leaves are the same size; interior ("core") nodes hold a fixed number
+ * of elements regardless of element size.
+ */
+#define	BTREE_LEAF_SIZE		4096
+#define	BTREE_CORE_ELEMS	126
+
+typedef struct zfs_btree_hdr {
+	struct zfs_btree_core	*bth_parent;
+	boolean_t		bth_core;	/* interior node? */
+	uint32_t		bth_count;	/* elements in this node */
+} zfs_btree_hdr_t;
+
+typedef struct zfs_btree_core {
+	zfs_btree_hdr_t	btc_hdr;
+	zfs_btree_hdr_t	*btc_children[BTREE_CORE_ELEMS + 1];
+	uint8_t		btc_elems[];
+} zfs_btree_core_t;
+
+typedef struct zfs_btree_leaf {
+	zfs_btree_hdr_t	btl_hdr;
+	uint8_t		btl_elems[];
+} zfs_btree_leaf_t;
+
+/*
+ * Identifies a position in the tree.  If bti_before is set the index does
+ * not refer to an element but to the gap in front of bti_offset, which is
+ * where zfs_btree_find() would have placed the element it was looking for.
+ */
+typedef struct zfs_btree_index {
+	zfs_btree_hdr_t	*bti_node;
+	uint32_t	bti_offset;
+	boolean_t	bti_before;
+} zfs_btree_index_t;
+
+typedef struct zfs_btree {
+	zfs_btree_hdr_t	*bt_root;
+	int64_t		bt_height;	/* -1 when empty, 0 for a lone leaf */
+	size_t		bt_elem_size;
+	uint32_t	bt_leaf_cap;	/* elements per leaf */
+	uint64_t	bt_num_elems;
+	uint64_t	bt_num_nodes;
+	int		(*bt_compar) (const void *, const void *);
+} zfs_btree_t;
+
+void zfs_btree_init(void);
+void zfs_btree_fini(void);
+void zfs_btree_reap(void);
+
+/*
+ * Initialize a tree of elements of the given size, ordered by compar(),
+ * which must return -1, 0 or 1 like an AVL comparator.
+ */
+void zfs_btree_create(zfs_btree_t *, int (*) (const void *, const void *),
+    size_t);
+void zfs_btree_destroy(zfs_btree_t *);
+
+/*
+ * Find the element matching value.  If no match exists and where is not
+ * NULL, it is set to the insertion point for zfs_btree_add_idx() and can
+ * be passed to zfs_btree_next()/zfs_btree_prev() to find the neighbours.
+ */
+void *zfs_btree_find(zfs_btree_t *, const void *, zfs_btree_index_t *);
+
+/*
+ * Copy value into the tree.  zfs_btree_add_idx() uses the insertion point
+ * from a failed zfs_btree_find().
+ */
+void zfs_btree_add_idx(zfs_btree_t *, const void *, const zfs_btree_index_t *);
+void zfs_btree_add(zfs_btree_t *, const void *);
+
+/*
+ * Remove the element matching value, or the element at the given index.
+ */
+void zfs_btree_remove(zfs_btree_t *, const void *);
+void zfs_btree_remove_idx(zfs_btree_t *, zfs_btree_index_t *);
+
+/*
+ * Ordered traversal.  The index arguments may be NULL when the caller
+ * only wants the element; out_idx may be the same as idx.
+ */
+void *zfs_btree_first(zfs_btree_t *, zfs_btree_index_t *);
+void *zfs_btree_last(zfs_btree_t *, zfs_btree_index_t *);
+void *zfs_btree_next(zfs_btree_t *, const zfs_btree_index_t *,
+    zfs_btree_index_t *);
+void *zfs_btree_prev(zfs_btree_t *, const zfs_btree_index_t *,
+    zfs_btree_index_t *);
+void *zfs_btree_get(zfs_btree_t *, const zfs_btree_index_t *);
+
+uint64_t zfs_btree_numnodes(zfs_btree_t *);
+
+/*
+ * Remove every element without rebalancing; the tree may be reused.
+ */
+void zfs_btree_clear(zfs_btree_t *);
+
+/*
+ * Check the structural invariants of the tree, panicking on corruption.
+ */
+void zfs_btree_verify(zfs_btree_t *);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_BTREE_H */
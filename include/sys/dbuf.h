@@ -68,6 +68,13 @@ extern "C" {
  *		|			 |
  *		+--------> NOFILL -------+
  *
+ * A partial write to an UNCACHED block may also go through FILL to
+ * PARTIAL, in which only the written ranges of db_data are valid.  The
+ * rest of the block is read in (and the dbuf goes to CACHED) when it is
+ * next read, dirtied in a later txg or synced; if the block is entirely
+ * overwritten first it goes to CACHED without being read at all.  See
+ * dmu_buf_will_dirty_range().
+ *
  * DB_SEARCH is an invalid state for a dbuf. It is used by dbuf_free_range
  * to find all dbufs in a range of a dnode and must be less than any other
  * dbuf_states_t (see comment on dn_dbufs in dnode.h).
@@ -79,7 +86,8 @@ typedef enum dbuf_states {
 	DB_NOFILL,
 	DB_READ,
 	DB_CACHED,
-	DB_EVICTING
+	DB_EVICTING,
+	DB_PARTIAL
 } dbuf_states_t;
 
 struct dnode;
@@ -145,6 +153,7 @@ typedef struct dbuf_dirty_record {
 			override_states_t dr_override_state;
 			uint8_t dr_copies;
 			boolean_t dr_nopwrite;
+			boolean_t dr_early_write; /* see dmu_sync_early() */
 		} dl;
 	} dt;
 } dbuf_dirty_record_t;
@@ -222,6 +231,9 @@ typedef struct dmu_buf_impl {
 	/* pointer to most recent dirty record for this buffer */
 	dbuf_dirty_record_t *db_last_dirty;
 
+	/* ranges written, and where to read the rest from, if DB_PARTIAL */
+	struct dbuf_partial *db_partial;
+
 	/*
 	 * Our link on the owner dnodes's dn_dbufs list.
 	 * Protected by its dn_dbufs_mtx.
@@ -296,6 +308,10 @@ int dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags);
 void dmu_buf_will_not_fill(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_will_fill(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_fill_done(dmu_buf_t *db, dmu_tx_t *tx);
+void dmu_buf_will_dirty_range(dmu_buf_t *db, uint64_t off, uint64_t size,
+    dmu_tx_t *tx);
+void dmu_buf_fill_range_done(dmu_buf_t *db, uint64_t off, uint64_t size,
+    dmu_tx_t *tx);
 void dbuf_assign_arcbuf(dmu_buf_impl_t *db, arc_buf_t *buf, dmu_tx_t *tx);
 dbuf_dirty_record_t *dbuf_dirty(dmu_buf_impl_t *db, dmu_tx_t *tx);
 arc_buf_t *dbuf_loan_arcbuf(dmu_buf_impl_t *db);
@@ -307,6 +323,7 @@ void dbuf_clear(dmu_buf_impl_t *db);
 void dbuf_evict(dmu_buf_impl_t *db);
 
 void dbuf_unoverride(dbuf_dirty_record_t *dr);
+void dbuf_partial_discard(dmu_buf_impl_t *db);
 void dbuf_sync_list(list_t *list, int level, dmu_tx_t *tx);
 void dbuf_release_bp(dmu_buf_impl_t *db);
 
@@ -69,6 +69,7 @@ struct nvlist;
 struct arc_buf;
 struct zio_prop;
 struct sa_handle;
+struct dbuf_dirty_record;
 
 typedef struct objset objset_t;
 typedef struct dmu_tx dmu_tx_t;
@@ -653,8 +654,23 @@ boolean_t dmu_buf_freeable(dmu_buf_t *);
 #define	DMU_NEW_OBJECT	(-1ULL)
 #define	DMU_OBJECT_END	(-1ULL)
 
+/*
+ * One range of a batched write (see dmu_write_batch()).  The data is either
+ * copied from dwr_data, or is a loaned arc buffer covering exactly one
+ * block, which is consumed (and the pointer cleared) when it is assigned.
+ */
+typedef struct dmu_write_range {
+	uint64_t	dwr_object;
+	uint64_t	dwr_offset;
+	uint64_t	dwr_length;
+	const void	*dwr_data;
+	struct arc_buf	*dwr_abuf;
+} dmu_write_range_t;
+
 dmu_tx_t *dmu_tx_create(objset_t *os);
 void dmu_tx_hold_write(dmu_tx_t *tx, uint64_t object, uint64_t off, int len);
+void dmu_tx_hold_write_batch(dmu_tx_t *tx, const dmu_write_range_t *dwr,
+    int count);
 void dmu_tx_hold_free(dmu_tx_t *tx, uint64_t object, uint64_t off,
     uint64_t len);
 void dmu_tx_hold_zap(dmu_tx_t *tx, uint64_t object, int add, const char *name);
@@ -712,10 +728,26 @@ void dmu_write(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
 	const void *buf, dmu_tx_t *tx);
 void dmu_prealloc(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
 	dmu_tx_t *tx);
+int dmu_write_batch(objset_t *os, dmu_write_range_t *dwr, int count,
+    dmu_tx_t *tx);
+
+/*
+ * Asynchronous reads: the callback is handed the held buffers covering the
+ * range once they have been read (or err is set), and must release them
+ * with arg as the tag.  See dmu_read_async() for the calling context.
+ */
+typedef void dmu_read_done_func_t(void *arg, dmu_buf_t **dbp, int numbufs,
+    int err);
+int dmu_read_async(struct dnode *dn, uint64_t offset, uint64_t size,
+    uint32_t flags, dmu_read_done_func_t *done, void *arg);
+int dmu_read_async_dbuf(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    uint32_t flags, dmu_read_done_func_t *done, void *arg);
 #ifdef _KERNEL
 #include <linux/blkdev_compat.h>
 int dmu_read_uio(objset_t *os, uint64_t object, struct uio *uio, uint64_t size);
 int dmu_read_uio_dbuf(dmu_buf_t *zdb, struct uio *uio, uint64_t size);
+int dmu_read_uio_bufs(dmu_buf_t **dbp, int numbufs, struct uio *uio,
+    uint64_t size);
 int dmu_write_uio(objset_t *os, uint64_t object, struct uio *uio, uint64_t size,
 	dmu_tx_t *tx);
 int dmu_write_uio_dbuf(dmu_buf_t *zdb, struct uio *uio, uint64_t size,
@@ -900,6 +932,7 @@ typedef struct zgd {
 
 typedef void dmu_sync_cb_t(zgd_t *arg, int error);
 int dmu_sync(struct zio *zio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd);
+uint64_t dmu_sync_early(struct dbuf_dirty_record *dr);
 
 /*
  * Find the next hole or data block in file starting at *off
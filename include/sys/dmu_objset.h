@@ -68,6 +68,17 @@ typedef struct objset_phys {
 	dnode_phys_t os_groupused_dnode;
 } objset_phys_t;
 
+/*
+ * I/O rate limits, indexed by (write ? 1 : 0) + (iops ? 2 : 0).
+ */
+typedef enum objset_rate {
+	OS_RATE_BW_READ,
+	OS_RATE_BW_WRITE,
+	OS_RATE_IOPS_READ,
+	OS_RATE_IOPS_WRITE,
+	OS_RATE_TYPES
+} objset_rate_t;
+
 struct objset {
 	/* Immutable: */
 	struct dsl_dataset *os_dsl_dataset;
@@ -122,6 +133,26 @@ struct objset {
 	kmutex_t os_user_ptr_lock;
 	void *os_user_ptr;
 	sa_os_t *os_sa;
+
+	/* Dirty data accounting, protected by the pool's dp_lock */
+	uint64_t os_dirty_limit;
+	uint64_t os_dirty_pertxg[TXG_SIZE];
+	uint64_t os_dirty_total;
+	kcondvar_t os_dirty_cv;
+	hrtime_t os_last_wakeup;
+	uint64_t os_delay_count;
+	uint64_t os_delay_time;
+	uint64_t os_dirty_limit_waits;
+	kstat_t *os_ksp;
+
+	/* I/O rate limiting, see dmu_objset_rate_limit() */
+	kmutex_t os_rate_lock;
+	kcondvar_t os_rate_cv;		/* signalled when a limit changes */
+	uint64_t os_rate_limit[OS_RATE_TYPES];
+	uint64_t os_rate_gen[OS_RATE_TYPES];	/* bumped on limit change */
+	hrtime_t os_rate_next[OS_RATE_TYPES];
+	uint64_t os_throttle_count[2];	/* indexed by write */
+	hrtime_t os_throttle_time[2];
 };
 
 #define	DMU_META_OBJSET		0
@@ -158,10 +189,12 @@ int dmu_objset_find_dp(struct dsl_pool *dp, uint64_t ddobj,
     void *arg, int flags);
 void dmu_objset_evict_dbufs(objset_t *os);
 timestruc_t dmu_objset_snap_cmtime(objset_t *os);
+int dmu_objset_rate_limit(objset_t *os, boolean_t write, uint64_t bytes);
 
 /* called from dsl */
 void dmu_objset_sync(objset_t *os, zio_t *zio, dmu_tx_t *tx);
 boolean_t dmu_objset_is_dirty(objset_t *os, uint64_t txg);
+uint64_t dmu_objset_early_write(objset_t *os, uint64_t txg, uint64_t limit);
 objset_t *dmu_objset_create_impl(spa_t *spa, struct dsl_dataset *ds,
     blkptr_t *bp, dmu_objset_type_t type, dmu_tx_t *tx);
 int dmu_objset_open_impl(spa_t *spa, struct dsl_dataset *ds, blkptr_t *bp,
@@ -195,7 +195,7 @@ typedef struct dsl_dataset {
 
 	/*
 	 * Set if we need to activate the feature on this dataset this txg
-	 * (used only in syncing context).
+	 * (consumed in syncing context; see dsl_dataset_need_feature()).
 	 */
 	uint8_t ds_feature_activation_needed[SPA_FEATURES];
 
@@ -267,6 +267,7 @@ int dsl_dataset_snap_lookup(dsl_dataset_t *ds, const char *name,
     uint64_t *value);
 
 void dsl_dataset_dirty(dsl_dataset_t *ds, dmu_tx_t *tx);
+void dsl_dataset_need_feature(dsl_dataset_t *ds, spa_feature_t f);
 void dsl_dataset_stats(dsl_dataset_t *os, nvlist_t *nv);
 void dsl_dataset_fast_stat(dsl_dataset_t *ds, dmu_objset_stats_t *stat);
 void dsl_dataset_space(dsl_dataset_t *ds,
@@ -156,6 +156,11 @@ typedef enum {
 	ZFS_PROP_REDUNDANT_METADATA,
 	ZFS_PROP_OVERLAY,
 	ZFS_PROP_PREV_SNAP,
+	ZFS_PROP_DIRTY_LIMIT,
+	ZFS_PROP_LIMIT_BW_READ,
+	ZFS_PROP_LIMIT_BW_WRITE,
+	ZFS_PROP_LIMIT_IOPS_READ,
+	ZFS_PROP_LIMIT_IOPS_WRITE,
 	ZFS_NUM_PROPS
 } zfs_prop_t;
 
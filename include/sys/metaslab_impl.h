@@ -36,6 +36,7 @@
 #include <sys/vdev.h>
 #include <sys/txg.h>
 #include <sys/avl.h>
+#include <sys/btree.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -186,7 +187,7 @@ struct metaslab {
 	 * same number of segments as the ms_tree. The only difference
 	 * is that the ms_size_tree is ordered by segment sizes.
 	 */
-	avl_tree_t	ms_size_tree;
+	zfs_btree_t	ms_size_tree;
 	uint64_t	ms_lbas[MAX_LBAS];
 
 	metaslab_group_t *ms_group;	/* metaslab group		*/
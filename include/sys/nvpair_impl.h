@@ -51,12 +51,14 @@ struct i_nvp {
 		struct {
 			i_nvp_t	*_nvi_next;	/* pointer to next nvpair */
 			i_nvp_t	*_nvi_prev;	/* pointer to prev nvpair */
+			i_nvp_t	*_nvi_hashtable_next; /* next in bucket */
 		} _nvi;
 	} _nvi_un;
 	nvpair_t nvi_nvp;			/* nvpair */
 };
 #define	nvi_next	_nvi_un._nvi._nvi_next
 #define	nvi_prev	_nvi_un._nvi._nvi_prev
+#define	nvi_hashtable_next	_nvi_un._nvi._nvi_hashtable_next
 
 typedef struct {
 	i_nvp_t		*nvp_list;	/* linked list of nvpairs */
@@ -64,6 +66,9 @@ typedef struct {
 	i_nvp_t		*nvp_curr;	/* current walker nvpair */
 	nv_alloc_t	*nvp_nva;	/* pluggable allocator */
 	uint32_t	nvp_stat;	/* internal state */
+	uint32_t	nvp_nentries;	/* # of nvpairs on nvp_list */
+	i_nvp_t		**nvp_hashtable; /* name index, see nvt_add() */
+	uint32_t	nvp_nbuckets;	/* # of buckets in nvp_hashtable */
 } nvpriv_t;
 
 #ifdef	__cplusplus
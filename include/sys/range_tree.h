@@ -31,6 +31,7 @@
 #define	_SYS_RANGE_TREE_H
 
 #include <sys/avl.h>
+#include <sys/btree.h>
 #include <sys/dmu.h>
 
 #ifdef	__cplusplus
@@ -42,7 +43,7 @@ extern "C" {
 typedef struct range_tree_ops range_tree_ops_t;
 
 typedef struct range_tree {
-	avl_tree_t	rt_root;	/* offset-ordered segment AVL tree */
+	zfs_btree_t	rt_root;	/* offset-ordered segment B-tree */
 	uint64_t	rt_space;	/* sum of all segments in the map */
 	range_tree_ops_t *rt_ops;
 	void		*rt_arg;
@@ -56,9 +57,11 @@ typedef struct range_tree {
 	kmutex_t	*rt_lock;	/* pointer to lock that protects map */
 } range_tree_t;
 
+/*
+ * Segments are stored by value in the B-tree, so a range_seg_t pointer
+ * obtained from rt_root is only valid until the tree is next modified.
+ */
 typedef struct range_seg {
-	avl_node_t	rs_node;	/* AVL node */
-	avl_node_t	rs_pp_node;	/* AVL picker-private node */
 	uint64_t	rs_start;	/* starting offset of this segment */
 	uint64_t	rs_end;		/* ending offset (non-inclusive) */
 } range_seg_t;
@@ -73,8 +76,6 @@ struct range_tree_ops {
 
 typedef void range_tree_func_t(void *arg, uint64_t start, uint64_t size);
 
-void range_tree_init(void);
-void range_tree_fini(void);
 range_tree_t *range_tree_create(range_tree_ops_t *ops, void *arg, kmutex_t *lp);
 void range_tree_destroy(range_tree_t *rt);
 boolean_t range_tree_contains(range_tree_t *rt, uint64_t start, uint64_t size);
@@ -106,6 +106,19 @@ typedef struct sa_bulk_attr {
 	b[idx++].sa_length = len; \
 }
 
+/*
+ * Add an entry which is looked up in place rather than copied out.  After
+ * a successful sa_bulk_lookup_locked(), SA_BULK_ATTR_ADDR() points at the
+ * attribute within the handle's bonus or spill buffer and
+ * SA_BULK_ATTR_SIZE() is its length.  The address is only valid until the
+ * handle lock is dropped.
+ */
+#define	SA_ADD_BULK_ATTR_PTR(b, idx, attr) \
+	SA_ADD_BULK_ATTR(b, idx, attr, NULL, NULL, 0)
+
+#define	SA_BULK_ATTR_ADDR(b, idx)	((b)[idx].sa_addr)
+#define	SA_BULK_ATTR_SIZE(b, idx)	((b)[idx].sa_size)
+
 typedef struct sa_os sa_os_t;
 
 typedef enum sa_handle_type {
@@ -744,6 +744,30 @@ typedef enum txg_state {
 	TXG_STATE_COMMITTED	= 5,
 } txg_state_t;
 
+/*
+ * Statistics for the txg being synced, reported in the txg history.  The
+ * times are in nanoseconds.
+ */
+typedef enum spa_sync_stat {
+	SPA_SYNC_PASSES,	/* passes to converge */
+	SPA_SYNC_DNODES,	/* dnodes synced */
+	SPA_SYNC_DBUFS,		/* dirty buffers synced */
+	SPA_SYNC_FREES,		/* blocks freed */
+	SPA_SYNC_EARLY,		/* bytes written before the sync began */
+	SPA_SYNC_TIME_CONFIG,	/* config object, aux devices and errlog */
+	SPA_SYNC_TIME_DATASETS,	/* datasets and dsl_dirs */
+	SPA_SYNC_TIME_MOS,	/* meta objset */
+	SPA_SYNC_TIME_TASKS,	/* sync tasks */
+	SPA_SYNC_TIME_FREES,	/* freeing and deferring frees */
+	SPA_SYNC_TIME_DDT,	/* dedup tables */
+	SPA_SYNC_TIME_SCAN,	/* scrub, resilver and async destroy */
+	SPA_SYNC_TIME_VDEVS,	/* metaslabs and vdev ZAPs */
+	SPA_SYNC_TIME_CONDENSE,	/* space map condensing, part of VDEVS */
+	SPA_SYNC_TIME_COMMIT,	/* uberblock and labels */
+	SPA_SYNC_TIME_DONE,	/* cleanup after the commit */
+	SPA_SYNC_STATS
+} spa_sync_stat_t;
+
 extern void spa_stats_init(spa_t *spa);
 extern void spa_stats_destroy(spa_t *spa);
 extern void spa_read_history_add(spa_t *spa, const zbookmark_phys_t *zb,
@@ -753,6 +777,8 @@ extern int spa_txg_history_set(spa_t *spa,  uint64_t txg,
     txg_state_t completed_state, hrtime_t completed_time);
 extern int spa_txg_history_set_io(spa_t *spa,  uint64_t txg, uint64_t nread,
     uint64_t nwritten, uint64_t reads, uint64_t writes, uint64_t ndirty);
+extern int spa_txg_history_set_sync(spa_t *spa, uint64_t txg,
+    const uint64_t *stats);
 extern void spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs);
 
 /* Pool configuration locks */
@@ -802,6 +828,8 @@ extern uint64_t spa_load_guid(spa_t *spa);
 extern uint64_t spa_last_synced_txg(spa_t *spa);
 extern uint64_t spa_first_txg(spa_t *spa);
 extern uint64_t spa_syncing_txg(spa_t *spa);
+extern void spa_sync_stat_add(spa_t *spa, spa_sync_stat_t stat,
+    uint64_t delta);
 extern uint64_t spa_version(spa_t *spa);
 extern pool_state_t spa_state(spa_t *spa);
 extern spa_load_state_t spa_load_state(spa_t *spa);
@@ -94,6 +94,19 @@ extern void txg_wait_synced(struct dsl_pool *dp, uint64_t txg);
  */
 extern void txg_wait_open(struct dsl_pool *dp, uint64_t txg);
 
+/*
+ * Called by the sync thread once txg has finished its sync passes.  If the
+ * next txg will be synced straight after it, start quiescing it now and
+ * return TRUE.
+ */
+extern boolean_t txg_quiesce_early(struct dsl_pool *dp, uint64_t txg);
+
+/*
+ * Wait until the given transaction group has been quiesced.  Returns
+ * FALSE if the sync thread has already taken it.
+ */
+extern boolean_t txg_wait_quiesced(struct dsl_pool *dp, uint64_t txg);
+
 /*
  * Returns TRUE if we are "backed up" waiting for the syncing
  * transaction to complete; otherwise returns FALSE.
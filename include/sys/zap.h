@@ -115,6 +115,12 @@ typedef enum zap_flags {
 	 * already randomly distributed.
 	 */
 	ZAP_FLAG_PRE_HASHED_KEY = 1 << 2,
+	/*
+	 * Hash string keys with CRC32C rather than CRC64.  Only valid for
+	 * 28-bit hashes; set on new objects when the zap_hash_crc32c
+	 * tunable is on and zap_crc32c is enabled.
+	 */
+	ZAP_FLAG_HASH_CRC32C = 1 << 3,
 } zap_flags_t;
 
 /*
@@ -483,6 +489,8 @@ typedef struct zap_stats {
  */
 int zap_get_stats(objset_t *ds, uint64_t zapobj, zap_stats_t *zs);
 
+void zap_init(void);
+
 #ifdef	__cplusplus
 }
 #endif
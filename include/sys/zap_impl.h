@@ -44,12 +44,25 @@ extern int fzap_default_block_shift;
 #define	MZAP_NAME_LEN		(MZAP_ENT_LEN - 8 - 4 - 2)
 #define	MZAP_MAX_BLKSZ		SPA_OLD_MAXBLOCKSIZE
 
+/*
+ * With the large_microzap feature, a microzap block may grow up to
+ * MZAP_LARGE_MAX_BLKSZ, and an entry whose name does not fit in
+ * MZAP_NAME_LEN continues into the following mze_chain chunks.  The
+ * name is stored contiguously across those chunks, so mze_name may be
+ * treated as a single string of up to MZE_NAME_LEN(mze_chain) bytes.
+ */
+#define	MZAP_LARGE_MAX_BLKSZ	(1 << 20)
+#define	MZE_NAME_LEN(chain)	(MZAP_NAME_LEN + (chain) * MZAP_ENT_LEN)
+#define	MZE_CHAIN_FOR_LEN(len)	((len) <= MZAP_NAME_LEN ? 0 : \
+	((len) - MZAP_NAME_LEN + MZAP_ENT_LEN - 1) / MZAP_ENT_LEN)
+#define	MZAP_MAX_CHAIN		MZE_CHAIN_FOR_LEN(ZAP_MAXNAMELEN)
+
 #define	ZAP_NEED_CD		(-1U)
 
 typedef struct mzap_ent_phys {
 	uint64_t mze_value;
 	uint32_t mze_cd;
-	uint16_t mze_pad;	/* in case we want to chain them someday */
+	uint16_t mze_chain;	/* continuation chunks used by mze_name */
 	char mze_name[MZAP_NAME_LEN];
 } mzap_ent_phys_t;
 
@@ -57,7 +70,8 @@ typedef struct mzap_phys {
 	uint64_t mz_block_type;	/* ZBT_MICRO */
 	uint64_t mz_salt;
 	uint64_t mz_normflags;
-	uint64_t mz_pad[5];
+	uint64_t mz_flags;	/* only ZAP_FLAG_HASH_CRC32C */
+	uint64_t mz_pad[4];
 	mzap_ent_phys_t mz_chunk[1];
 	/* actually variable size depending on block size */
 } mzap_phys_t;
@@ -152,7 +166,9 @@ typedef struct zap {
 		struct {
 			/*
 			 * zap_num_entries_mtx protects
-			 * zap_num_entries
+			 * zap_num_entries, and the header and
+			 * pointer table updates made by leaf
+			 * splits under a reader zap_rwlock
 			 */
 			kmutex_t zap_num_entries_mtx;
 			int zap_block_shift;
@@ -160,6 +176,7 @@ typedef struct zap {
 		struct {
 			int16_t zap_num_entries;
 			int16_t zap_num_chunks;
+			int16_t zap_num_used;	/* incl. chains */
 			int16_t zap_alloc_next;
 			avl_tree_t zap_avl;
 		} zap_micro;
@@ -203,6 +220,7 @@ void zap_name_free(zap_name_t *zn);
 int zap_hashbits(zap_t *zap);
 uint32_t zap_maxcd(zap_t *zap);
 uint64_t zap_getflags(zap_t *zap);
+uint64_t mzap_max_blksz(objset_t *os);
 
 #define	ZAP_HASH_IDX(hash, n) (((n) == 0) ? 0 : ((hash) >> (64 - (n))))
 
@@ -108,9 +108,10 @@ typedef struct zfs_sb {
 	uint64_t	z_version;	/* ZPL version */
 	uint64_t	z_shares_dir;	/* hidden shares dir */
 	kmutex_t	z_lock;
+	uint64_t	z_async_reads;	/* zfs_read_async()s in flight */
+	kcondvar_t	z_async_reads_cv; /* signalled as they complete */
 	uint64_t	z_userquota_obj;
 	uint64_t	z_groupquota_obj;
-	uint64_t	z_replay_eof;	/* New end of file - replay only */
 	sa_attr_type_t	*z_attr_table;	/* SA attr mapping->id */
 	uint64_t	z_hold_size;	/* znode hold array size */
 	avl_tree_t	*z_hold_trees;	/* znode hold trees */
@@ -177,6 +178,7 @@ typedef struct zfid_long {
 #define	LONG_FID_LEN	(sizeof (zfid_long_t) - sizeof (uint16_t))
 
 extern uint_t zfs_fsyncer_key;
+extern uint_t zfs_replay_eof_key;
 
 extern int zfs_suspend_fs(zfs_sb_t *zsb);
 extern int zfs_resume_fs(zfs_sb_t *zsb, const char *osname);
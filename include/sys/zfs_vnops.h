@@ -40,7 +40,13 @@ extern "C" {
 extern int zfs_open(struct inode *ip, int mode, int flag, cred_t *cr);
 extern int zfs_close(struct inode *ip, int flag, cred_t *cr);
 extern int zfs_holey(struct inode *ip, int cmd, loff_t *off);
+extern int zfs_aio_async;
+
+typedef void zfs_read_done_t(void *arg, ssize_t nread, int error);
+
 extern int zfs_read(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr);
+extern int zfs_read_async(struct inode *ip, uio_t *uio, int ioflag,
+    cred_t *cr, zfs_read_done_t *done, void *arg);
 extern int zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr);
 extern int zfs_access(struct inode *ip, int mode, int flag, cred_t *cr);
 extern int zfs_lookup(struct inode *dip, char *nm, struct inode **ipp,
@@ -428,6 +428,25 @@ typedef struct zil_stats {
 	 */
 	kstat_named_t zil_itx_metaslab_slog_count;
 	kstat_named_t zil_itx_metaslab_slog_bytes;
+
+	/*
+	 * Intent logs replayed, the log records replayed from them, and
+	 * the bytes of those records including any write data read from
+	 * elsewhere in the pool.  Dividing bytes by the time spent gives
+	 * the replay throughput.
+	 */
+	kstat_named_t zil_replay_count;
+	kstat_named_t zil_replay_records;
+	kstat_named_t zil_replay_bytes;
+	kstat_named_t zil_replay_time_ms;
+
+	/*
+	 * Intent logs claimed when their pool was imported, and the total
+	 * time spent claiming them.  The time taken by each dataset is
+	 * recorded in the debug log.
+	 */
+	kstat_named_t zil_claim_count;
+	kstat_named_t zil_claim_time_ms;
 } zil_stats_t;
 
 extern zil_stats_t zil_stats;
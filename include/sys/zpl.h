@@ -59,6 +59,8 @@ extern ssize_t zpl_write_common(struct inode *ip, const char *buf,
 extern long zpl_fallocate_common(struct inode *ip, int mode,
     loff_t offset, loff_t len);
 #endif /* defined(HAVE_FILE_FALLOCATE) || defined(HAVE_INODE_FALLOCATE) */
+extern void zpl_file_init(void);
+extern void zpl_file_fini(void);
 
 extern const struct address_space_operations zpl_address_space_operations;
 extern const struct file_operations zpl_file_operations;
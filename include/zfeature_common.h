@@ -50,6 +50,8 @@ typedef enum spa_feature {
 	SPA_FEATURE_BOOKMARKS,
 	SPA_FEATURE_FS_SS_LIMIT,
 	SPA_FEATURE_LARGE_BLOCKS,
+	SPA_FEATURE_LARGE_MICROZAP,
+	SPA_FEATURE_ZAP_CRC32C,
 	SPA_FEATURES
 } spa_feature_t;
 
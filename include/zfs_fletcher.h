@@ -45,6 +45,8 @@ void fletcher_4_incremental_native(const void *, uint64_t,
     zio_cksum_t *);
 void fletcher_4_incremental_byteswap(const void *, uint64_t,
     zio_cksum_t *);
+void fletcher_4_incremental_combine(zio_cksum_t *, const zio_cksum_t *,
+    uint64_t);
 
 #ifdef	__cplusplus
 }
@@ -2426,6 +2426,9 @@ zfs_prop_get(zfs_handle_t *zhp, zfs_prop_t prop, char *propbuf, size_t proplen,
 	case ZFS_PROP_REFQUOTA:
 	case ZFS_PROP_RESERVATION:
 	case ZFS_PROP_REFRESERVATION:
+	case ZFS_PROP_DIRTY_LIMIT:
+	case ZFS_PROP_LIMIT_BW_READ:
+	case ZFS_PROP_LIMIT_BW_WRITE:
 
 		if (get_numeric_property(zhp, prop, src, &source, &val) != 0)
 			return (-1);
@@ -2450,6 +2453,22 @@ zfs_prop_get(zfs_handle_t *zhp, zfs_prop_t prop, char *propbuf, size_t proplen,
 		}
 		break;
 
+	case ZFS_PROP_LIMIT_IOPS_READ:
+	case ZFS_PROP_LIMIT_IOPS_WRITE:
+
+		if (get_numeric_property(zhp, prop, src, &source, &val) != 0)
+			return (-1);
+
+		/*
+		 * Operation rates are printed exactly, with 0 as 'none'.
+		 */
+		if (val == 0 && !literal)
+			(void) strlcpy(propbuf, "none", proplen);
+		else
+			(void) snprintf(propbuf, proplen, "%llu",
+			    (u_longlong_t)val);
+		break;
+
 	case ZFS_PROP_FILESYSTEM_LIMIT:
 	case ZFS_PROP_SNAPSHOT_LIMIT:
 	case ZFS_PROP_FILESYSTEM_COUNT:
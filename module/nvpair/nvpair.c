@@ -347,6 +347,158 @@ nvp_buf_free(nvlist_t *nvl, nvpair_t *nvp)
 	nv_mem_free(priv, NVPAIR2I_NVP(nvp), nvsize);
 }
 
+/*
+ * Name index for large nvlists.
+ *
+ * Lookups, and the implicit remove done by every add to a unique-name
+ * nvlist, walk nvp_list comparing names.  That is fine for the small lists
+ * which make up the vast majority of nvlists, but makes building or
+ * searching a pool config or property list with thousands of entries
+ * quadratic.  Once a unique-name nvlist holds NVT_MIN_ENTRIES pairs, a
+ * hash table of its pairs keyed by name is built and kept up to date by
+ * nvp_buf_link() and nvp_buf_unlink().  The table is only an index: if it
+ * cannot be allocated or grown, the list walk (or longer chains) is used.
+ * Lists using the fixed-buffer allocator are never indexed, since their
+ * consumers size that buffer for the pairs alone.
+ */
+#define	NVT_MIN_ENTRIES		16
+#define	NVT_MAX_LOAD		2	/* average entries per bucket */
+
+static uint32_t
+nvt_hash(const char *p)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*p != '\0')
+		hash = (hash ^ (uchar_t)*p++) * 16777619U;
+
+	return (hash);
+}
+
+static boolean_t
+nvt_indexable(nvlist_t *nvl, nvpriv_t *priv)
+{
+	return ((nvl->nvl_nvflag & (NV_UNIQUE_NAME | NV_UNIQUE_NAME_TYPE)) &&
+	    priv->nvp_nva->nva_ops != nv_fixed_ops);
+}
+
+static void
+nvt_tab_free(nvpriv_t *priv)
+{
+	if (priv->nvp_hashtable == NULL)
+		return;
+
+	nv_mem_free(priv, priv->nvp_hashtable,
+	    priv->nvp_nbuckets * sizeof (i_nvp_t *));
+	priv->nvp_hashtable = NULL;
+	priv->nvp_nbuckets = 0;
+}
+
+/*
+ * Allocate a table of nbuckets buckets and move every pair on nvp_list
+ * into it, replacing any existing table.  Returns B_FALSE, leaving any
+ * existing table in place, if the allocation fails.
+ */
+static boolean_t
+nvt_tab_build(nvpriv_t *priv, uint32_t nbuckets)
+{
+	i_nvp_t **tab;
+	i_nvp_t *curr;
+
+	ASSERT((nbuckets & (nbuckets - 1)) == 0);
+
+	if ((tab = nv_mem_zalloc(priv, nbuckets * sizeof (i_nvp_t *))) == NULL)
+		return (B_FALSE);
+
+	nvt_tab_free(priv);
+	priv->nvp_hashtable = tab;
+	priv->nvp_nbuckets = nbuckets;
+
+	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
+		uint32_t idx = nvt_hash(NVP_NAME(&curr->nvi_nvp)) &
+		    (nbuckets - 1);
+
+		curr->nvi_hashtable_next = tab[idx];
+		tab[idx] = curr;
+	}
+
+	return (B_TRUE);
+}
+
+static void
+nvt_add(nvlist_t *nvl, nvpriv_t *priv, i_nvp_t *curr)
+{
+	uint32_t idx;
+
+	if (priv->nvp_hashtable == NULL) {
+		if (priv->nvp_nentries >= NVT_MIN_ENTRIES &&
+		    nvt_indexable(nvl, priv))
+			(void) nvt_tab_build(priv, NVT_MIN_ENTRIES);
+		return;
+	}
+
+	/* curr is already on nvp_list, so a successful rebuild indexes it */
+	if (priv->nvp_nentries > NVT_MAX_LOAD * priv->nvp_nbuckets &&
+	    nvt_tab_build(priv, priv->nvp_nbuckets * 2))
+		return;
+
+	idx = nvt_hash(NVP_NAME(&curr->nvi_nvp)) & (priv->nvp_nbuckets - 1);
+	curr->nvi_hashtable_next = priv->nvp_hashtable[idx];
+	priv->nvp_hashtable[idx] = curr;
+}
+
+static void
+nvt_remove(nvpriv_t *priv, i_nvp_t *curr)
+{
+	i_nvp_t **pp;
+
+	if (priv->nvp_hashtable == NULL)
+		return;
+
+	pp = &priv->nvp_hashtable[nvt_hash(NVP_NAME(&curr->nvi_nvp)) &
+	    (priv->nvp_nbuckets - 1)];
+	while (*pp != curr) {
+		ASSERT(*pp != NULL);
+		pp = &(*pp)->nvi_hashtable_next;
+	}
+	*pp = curr->nvi_hashtable_next;
+	curr->nvi_hashtable_next = NULL;
+}
+
+/*
+ * Find the first pair named 'name' with type 'type', or of any type if
+ * 'type' is DATA_TYPE_UNKNOWN.  With NV_UNIQUE_NAME_TYPE several pairs may
+ * share a name; which of them a DATA_TYPE_UNKNOWN lookup returns is then
+ * unspecified.
+ */
+static nvpair_t *
+nvt_lookup(nvpriv_t *priv, const char *name, data_type_t type)
+{
+	i_nvp_t *curr;
+
+	if (priv->nvp_hashtable == NULL) {
+		curr = priv->nvp_list;
+		for (; curr != NULL; curr = curr->nvi_next) {
+			nvpair_t *nvp = &curr->nvi_nvp;
+
+			if (strcmp(name, NVP_NAME(nvp)) == 0 &&
+			    (type == DATA_TYPE_UNKNOWN || NVP_TYPE(nvp) == type))
+				return (nvp);
+		}
+		return (NULL);
+	}
+
+	curr = priv->nvp_hashtable[nvt_hash(name) & (priv->nvp_nbuckets - 1)];
+	for (; curr != NULL; curr = curr->nvi_hashtable_next) {
+		nvpair_t *nvp = &curr->nvi_nvp;
+
+		if (strcmp(name, NVP_NAME(nvp)) == 0 &&
+		    (type == DATA_TYPE_UNKNOWN || NVP_TYPE(nvp) == type))
+			return (nvp);
+	}
+	return (NULL);
+}
+
 /*
  * nvp_buf_link - link a new nv pair into the nvlist.
  */
@@ -364,6 +516,9 @@ nvp_buf_link(nvlist_t *nvl, nvpair_t *nvp)
 		priv->nvp_last->nvi_next = curr;
 		priv->nvp_last = curr;
 	}
+
+	priv->nvp_nentries++;
+	nvt_add(nvl, priv, curr);
 }
 
 /*
@@ -381,6 +536,9 @@ nvp_buf_unlink(nvlist_t *nvl, nvpair_t *nvp)
 	if (priv->nvp_curr == curr)
 		priv->nvp_curr = curr->nvi_next;
 
+	nvt_remove(priv, curr);
+	priv->nvp_nentries--;
+
 	if (curr == priv->nvp_list)
 		priv->nvp_list = curr->nvi_next;
 	else
@@ -584,6 +742,7 @@ nvlist_free(nvlist_t *nvl)
 		nvpair_free(nvp);
 		nvp_buf_free(nvl, nvp);
 	}
+	nvt_tab_free(priv);
 
 	if (!(priv->nvp_stat & NV_STAT_EMBEDDED))
 		nv_mem_free(priv, nvl, NV_ALIGN(sizeof (nvlist_t)));
@@ -602,6 +761,15 @@ nvlist_contains_nvp(nvlist_t *nvl, nvpair_t *nvp)
 	if (nvp == NULL)
 		return (0);
 
+	if (priv->nvp_hashtable != NULL) {
+		curr = priv->nvp_hashtable[nvt_hash(NVP_NAME(nvp)) &
+		    (priv->nvp_nbuckets - 1)];
+		for (; curr != NULL; curr = curr->nvi_hashtable_next)
+			if (&curr->nvi_nvp == nvp)
+				return (1);
+		return (0);
+	}
+
 	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next)
 		if (&curr->nvi_nvp == nvp)
 			return (1);
@@ -652,6 +820,19 @@ nvlist_remove_all(nvlist_t *nvl, const char *name)
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (EINVAL);
 
+	if (priv->nvp_hashtable != NULL) {
+		nvpair_t *nvp;
+
+		while ((nvp = nvt_lookup(priv, name,
+		    DATA_TYPE_UNKNOWN)) != NULL) {
+			nvp_buf_unlink(nvl, nvp);
+			nvpair_free(nvp);
+			nvp_buf_free(nvl, nvp);
+			error = 0;
+		}
+		return (error);
+	}
+
 	curr = priv->nvp_list;
 	while (curr != NULL) {
 		nvpair_t *nvp = &curr->nvi_nvp;
@@ -677,27 +858,21 @@ int
 nvlist_remove(nvlist_t *nvl, const char *name, data_type_t type)
 {
 	nvpriv_t *priv;
-	i_nvp_t *curr;
+	nvpair_t *nvp;
 
 	if (nvl == NULL || name == NULL ||
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (EINVAL);
 
-	curr = priv->nvp_list;
-	while (curr != NULL) {
-		nvpair_t *nvp = &curr->nvi_nvp;
+	if (type == DATA_TYPE_UNKNOWN ||
+	    (nvp = nvt_lookup(priv, name, type)) == NULL)
+		return (ENOENT);
 
-		if (strcmp(name, NVP_NAME(nvp)) == 0 && NVP_TYPE(nvp) == type) {
-			nvp_buf_unlink(nvl, nvp);
-			nvpair_free(nvp);
-			nvp_buf_free(nvl, nvp);
-
-			return (0);
-		}
-		curr = curr->nvi_next;
-	}
+	nvp_buf_unlink(nvl, nvp);
+	nvpair_free(nvp);
+	nvp_buf_free(nvl, nvp);
 
-	return (ENOENT);
+	return (0);
 }
 
 int
@@ -1331,7 +1506,6 @@ nvlist_lookup_common(nvlist_t *nvl, const char *name, data_type_t type,
 {
 	nvpriv_t *priv;
 	nvpair_t *nvp;
-	i_nvp_t *curr;
 
 	if (name == NULL || nvl == NULL ||
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
@@ -1340,14 +1514,11 @@ nvlist_lookup_common(nvlist_t *nvl, const char *name, data_type_t type,
 	if (!(nvl->nvl_nvflag & (NV_UNIQUE_NAME | NV_UNIQUE_NAME_TYPE)))
 		return (ENOTSUP);
 
-	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
-		nvp = &curr->nvi_nvp;
-
-		if (strcmp(name, NVP_NAME(nvp)) == 0 && NVP_TYPE(nvp) == type)
-			return (nvpair_value_common(nvp, type, nelem, data));
-	}
+	if (type == DATA_TYPE_UNKNOWN ||
+	    (nvp = nvt_lookup(priv, name, type)) == NULL)
+		return (ENOENT);
 
-	return (ENOENT);
+	return (nvpair_value_common(nvp, type, nelem, data));
 }
 
 int
@@ -1796,21 +1967,12 @@ boolean_t
 nvlist_exists(nvlist_t *nvl, const char *name)
 {
 	nvpriv_t *priv;
-	nvpair_t *nvp;
-	i_nvp_t *curr;
 
 	if (name == NULL || nvl == NULL ||
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (B_FALSE);
 
-	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
-		nvp = &curr->nvi_nvp;
-
-		if (strcmp(name, NVP_NAME(nvp)) == 0)
-			return (B_TRUE);
-	}
-
-	return (B_FALSE);
+	return (nvt_lookup(priv, name, DATA_TYPE_UNKNOWN) != NULL);
 }
 
 int
@@ -240,6 +240,53 @@ const int8_t u8_number_of_bytes[0x100] = {
 	4,  4,  4,  4,  4,  O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_,
 };
 
+/*
+ * Case conversion tables for 7-bit ASCII, indexed by U8_ASCII_CASE_UPPER or
+ * U8_ASCII_CASE_LOWER.  These let the ASCII fast paths convert a character
+ * with a single load rather than two range comparisons.
+ */
+#define	U8_ASCII_CASE_UPPER		0
+#define	U8_ASCII_CASE_LOWER		1
+
+static const uchar_t u8_ascii_case[2][0x80] = {
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+		0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+		0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+		0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+		0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+		0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+		0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+		0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+		0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+		0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+		0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57,
+		0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,
+		0x60, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+		0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+		0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57,
+		0x58, 0x59, 0x5A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+		0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+		0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+		0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+		0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+		0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+		0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+		0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+		0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+		0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+		0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+		0x78, 0x79, 0x7A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,
+		0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+		0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+		0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+		0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,
+	},
+};
+
 #undef	I_
 #undef	O_
 
@@ -556,6 +603,56 @@ do_case_conv(int uv, uchar_t *u8s, uchar_t *s, int sz, boolean_t is_it_toupper)
 	return (i);
 }
 
+/*
+ * The u8_ascii_prefix() function copies the leading run of 7-bit ASCII
+ * characters at ib into ob, converting case through u8_ascii_case[case_idx]
+ * unless case_idx is negative, and returns the number of bytes copied.
+ * At most obsz bytes are copied.  The run stops at a NUL unless ignore_null
+ * is set.  If hold_last is set, the last ASCII character of the run is not
+ * copied when a non-ASCII byte follows it, since it may then be the start
+ * of a sequence that normalization has to look at as a whole.
+ *
+ * The scan checks eight bytes at a time, so pure ASCII names, by far the
+ * most common case, bypass the per-character state machine entirely.
+ */
+#define	U8_WORD_LOW_BITS		0x0101010101010101ULL
+#define	U8_WORD_HIGH_BITS		0x8080808080808080ULL
+
+static size_t
+u8_ascii_prefix(const uchar_t *ib, const uchar_t *ibtail, uchar_t *ob,
+	size_t obsz, int case_idx, boolean_t ignore_null, boolean_t hold_last)
+{
+	const uchar_t *tbl;
+	uint64_t w;
+	size_t n;
+	size_t i;
+
+	n = MIN(ibtail - ib, obsz);
+	for (i = 0; i + sizeof (w) <= n; i += sizeof (w)) {
+		bcopy(ib + i, &w, sizeof (w));
+		if (w & U8_WORD_HIGH_BITS)
+			break;
+		if (!ignore_null &&
+		    ((w - U8_WORD_LOW_BITS) & ~w & U8_WORD_HIGH_BITS))
+			break;
+	}
+	while (i < n && U8_ISASCII(ib[i]) && (ib[i] != '\0' || ignore_null))
+		i++;
+
+	if (hold_last && i > 0 && ib + i < ibtail && !U8_ISASCII(ib[i]))
+		i--;
+
+	if (case_idx < 0) {
+		bcopy(ib, ob, i);
+	} else {
+		tbl = u8_ascii_case[case_idx];
+		for (n = 0; n < i; n++)
+			ob[n] = tbl[ib[n]];
+	}
+
+	return (i);
+}
+
 /*
  * The do_case_compare() function compares the two input strings, s1 and s2,
  * one character at a time doing case conversions if applicable and return
@@ -577,8 +674,24 @@ do_case_compare(size_t uv, uchar_t *s1, uchar_t *s2, size_t n1,
 	size_t i2;
 	uchar_t u8s1[U8_MB_CUR_MAX + 1];
 	uchar_t u8s2[U8_MB_CUR_MAX + 1];
+	const uchar_t *tbl;
 
+	/*
+	 * Compare the leading 7-bit ASCII characters of both strings
+	 * through the case table before falling into the general loop.
+	 */
+	tbl = u8_ascii_case[is_it_toupper ?
+	    U8_ASCII_CASE_UPPER : U8_ASCII_CASE_LOWER];
 	i1 = i2 = 0;
+	while (i1 < n1 && i2 < n2 && U8_ISASCII(*s1) && U8_ISASCII(*s2)) {
+		if (tbl[*s1] != tbl[*s2])
+			return (tbl[*s1] > tbl[*s2] ? 1 : -1);
+		s1++;
+		s2++;
+		i1++;
+		i2++;
+	}
+
 	while (i1 < n1 && i2 < n2) {
 		/*
 		 * Find out what would be the byte length for this UTF-8
@@ -1972,6 +2085,17 @@ u8_textprep_str(char *inarray, size_t *inlen, char *outarray, size_t *outlen,
 
 	ret_val = 0;
 
+	/*
+	 * Copy any leading run of 7-bit ASCII characters in bulk.  They are
+	 * unaffected by normalization, so only case conversion applies.
+	 */
+	i = u8_ascii_prefix(ib, ibtail, ob, obtail - ob,
+	    is_it_toupper ? U8_ASCII_CASE_UPPER :
+	    is_it_tolower ? U8_ASCII_CASE_LOWER : -1,
+	    !do_not_ignore_null, f != 0);
+	ib += i;
+	ob += i;
+
 	/*
 	 * If we don't have a normalization flag set, we do the simple case
 	 * conversion based text preparation separately below. Text
@@ -245,6 +245,53 @@ fletcher_4_incremental_byteswap(const void *buf, uint64_t size,
 	ZIO_SET_CHECKSUM(zcp, a, b, c, d);
 }
 
+/*
+ * Given the fletcher-4 checksum zcp of some data, and the checksum of the
+ * nwords 32-bit words that follow it computed from a zero starting state,
+ * produce in zcp the checksum of the concatenation.  Feeding nwords words
+ * into a non-zero state adds the series above for the new words, plus
+ * terms from the old state carried forward by the same recurrences:
+ *
+ *	a' = a
+ *	b' = b + n*a
+ *	c' = c + n*b + n*(n+1)/2 * a
+ *	d' = d + n*c + n*(n+1)/2 * b + n*(n+1)*(n+2)/6 * a
+ *
+ * This lets independent pieces of a stream be checksummed in parallel.
+ */
+void
+fletcher_4_incremental_combine(zio_cksum_t *zcp, const zio_cksum_t *nzcp,
+    uint64_t nwords)
+{
+	uint64_t a = zcp->zc_word[0];
+	uint64_t b = zcp->zc_word[1];
+	uint64_t c = zcp->zc_word[2];
+	uint64_t d = zcp->zc_word[3];
+	uint64_t v[3] = { nwords, nwords + 1, nwords + 2 };
+	uint64_t t2, t3;
+	int i;
+
+	/*
+	 * The divisions must be exact, so divide out the factors of 2 and
+	 * 3 before multiplying (mod 2^64).
+	 */
+	t2 = (nwords % 2 == 0) ? (nwords / 2) * (nwords + 1) :
+	    nwords * ((nwords + 1) / 2);
+	for (i = 0; v[i] % 3 != 0; i++)
+		continue;
+	v[i] /= 3;
+	for (i = 0; v[i] % 2 != 0; i++)
+		continue;
+	v[i] /= 2;
+	t3 = v[0] * v[1] * v[2];
+
+	ZIO_SET_CHECKSUM(zcp,
+	    a + nzcp->zc_word[0],
+	    b + nwords * a + nzcp->zc_word[1],
+	    c + nwords * b + t2 * a + nzcp->zc_word[2],
+	    d + nwords * c + t2 * b + t3 * a + nzcp->zc_word[3]);
+}
+
 #if defined(_KERNEL) && defined(HAVE_SPL)
 EXPORT_SYMBOL(fletcher_2_native);
 EXPORT_SYMBOL(fletcher_2_byteswap);
@@ -252,4 +299,5 @@ EXPORT_SYMBOL(fletcher_4_native);
 EXPORT_SYMBOL(fletcher_4_byteswap);
 EXPORT_SYMBOL(fletcher_4_incremental_native);
 EXPORT_SYMBOL(fletcher_4_incremental_byteswap);
+EXPORT_SYMBOL(fletcher_4_incremental_combine);
 #endif
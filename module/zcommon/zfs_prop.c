@@ -428,6 +428,21 @@ zfs_prop_init(void)
 	zprop_register_number(ZFS_PROP_RECORDSIZE, "recordsize",
 	    SPA_OLD_MAXBLOCKSIZE, PROP_INHERIT,
 	    ZFS_TYPE_FILESYSTEM, "512 to 1M, power of 2", "RECSIZE");
+	zprop_register_number(ZFS_PROP_DIRTY_LIMIT, "dirty_limit", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<size> | none", "DIRTYLIMIT");
+	zprop_register_number(ZFS_PROP_LIMIT_BW_READ, "limit_bw_read", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<bytes per second> | none", "RDBWLIMIT");
+	zprop_register_number(ZFS_PROP_LIMIT_BW_WRITE, "limit_bw_write", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<bytes per second> | none", "WRBWLIMIT");
+	zprop_register_number(ZFS_PROP_LIMIT_IOPS_READ, "limit_iops_read", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<operations per second> | none", "RDIOPSLIMIT");
+	zprop_register_number(ZFS_PROP_LIMIT_IOPS_WRITE, "limit_iops_write", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<operations per second> | none", "WRIOPSLIMIT");
 
 	/* hidden properties */
 	zprop_register_hidden(ZFS_PROP_CREATETXG, "createtxg", PROP_TYPE_NUMBER,
@@ -138,6 +138,7 @@
 #include <sys/vdev_impl.h>
 #include <sys/dsl_pool.h>
 #include <sys/multilist.h>
+#include <sys/btree.h>
 #ifdef _KERNEL
 #include <sys/vmsystm.h>
 #include <vm/anon.h>
@@ -771,12 +772,26 @@ int l2arc_norw = B_FALSE;			/* no reads during writes */
 static list_t L2ARC_dev_list;			/* device list */
 static list_t *l2arc_dev_list;			/* device list pointer */
 static kmutex_t l2arc_dev_mtx;			/* device list mutex */
-static l2arc_dev_t *l2arc_dev_last;		/* last device used */
+static boolean_t l2arc_feeding;			/* feed threads enabled */
 static list_t L2ARC_free_on_write;		/* free after write buf list */
 static list_t *l2arc_free_on_write;		/* free after write list ptr */
 static kmutex_t l2arc_free_on_write_mtx;	/* mutex for list */
 static uint64_t l2arc_ndev;			/* number of devices */
 
+static l2arc_dev_stats_t l2arc_dev_stats_template = {
+	{ "feeds",			KSTAT_DATA_UINT64 },
+	{ "hits",			KSTAT_DATA_UINT64 },
+	{ "read_bytes",			KSTAT_DATA_UINT64 },
+	{ "writes_sent",		KSTAT_DATA_UINT64 },
+	{ "write_bytes",		KSTAT_DATA_UINT64 },
+	{ "evicts",			KSTAT_DATA_UINT64 },
+	{ "evict_bytes",		KSTAT_DATA_UINT64 }
+};
+
+#define	L2ARC_DEVSTAT_INCR(dev, stat, val) \
+	atomic_add_64(&(dev)->l2ad_stats.stat.value.ui64, (val))
+#define	L2ARC_DEVSTAT_BUMP(dev, stat)	L2ARC_DEVSTAT_INCR(dev, stat, 1)
+
 typedef struct l2arc_read_callback {
 	arc_buf_t		*l2rcb_buf;		/* read buffer */
 	spa_t			*l2rcb_spa;		/* spa */
@@ -794,10 +809,6 @@ typedef struct l2arc_data_free {
 	list_node_t	l2df_list_node;
 } l2arc_data_free_t;
 
-static kmutex_t l2arc_feed_thr_lock;
-static kcondvar_t l2arc_feed_thr_cv;
-static uint8_t l2arc_thread_exit;
-
 static void arc_get_data_buf(arc_buf_t *);
 static void arc_access(arc_buf_hdr_t *, kmutex_t *);
 static boolean_t arc_is_overflowing(void);
@@ -3371,7 +3382,6 @@ arc_kmem_reap_now(void)
 	kmem_cache_t		*prev_data_cache = NULL;
 	extern kmem_cache_t	*zio_buf_cache[];
 	extern kmem_cache_t	*zio_data_buf_cache[];
-	extern kmem_cache_t	*range_seg_cache;
 
 	if ((arc_meta_used >= arc_meta_limit) && zfs_arc_meta_prune) {
 		/*
@@ -3399,7 +3409,7 @@ arc_kmem_reap_now(void)
 	kmem_cache_reap_now(buf_cache);
 	kmem_cache_reap_now(hdr_full_cache);
 	kmem_cache_reap_now(hdr_l2only_cache);
-	kmem_cache_reap_now(range_seg_cache);
+	zfs_btree_reap();
 
 	if (zio_arena != NULL) {
 		/*
@@ -4366,6 +4376,7 @@ top:
 		uint64_t size = BP_GET_LSIZE(bp);
 		arc_callback_t *acb;
 		vdev_t *vd = NULL;
+		l2arc_dev_t *l2dev = NULL;
 		uint64_t addr = 0;
 		boolean_t devw = B_FALSE;
 		enum zio_compress b_compress = ZIO_COMPRESS_OFF;
@@ -4470,7 +4481,8 @@ top:
 
 		if (HDR_HAS_L2HDR(hdr) &&
 		    (vd = hdr->b_l2hdr.b_dev->l2ad_vdev) != NULL) {
-			devw = hdr->b_l2hdr.b_dev->l2ad_writing;
+			l2dev = hdr->b_l2hdr.b_dev;
+			devw = l2dev->l2ad_writing;
 			addr = hdr->b_l2hdr.b_daddr;
 			b_compress = hdr->b_l2hdr.b_compress;
 			b_asize = hdr->b_l2hdr.b_asize;
@@ -4519,6 +4531,7 @@ top:
 
 				DTRACE_PROBE1(l2arc__hit, arc_buf_hdr_t *, hdr);
 				ARCSTAT_BUMP(arcstat_l2_hits);
+				L2ARC_DEVSTAT_BUMP(l2dev, l2ds_hits);
 				atomic_inc_32(&hdr->b_l2hdr.b_hits);
 
 				cb = kmem_zalloc(sizeof (l2arc_read_callback_t),
@@ -4560,6 +4573,8 @@ top:
 				DTRACE_PROBE2(l2arc__read, vdev_t *, vd,
 				    zio_t *, rzio);
 				ARCSTAT_INCR(arcstat_l2_read_bytes, b_asize);
+				L2ARC_DEVSTAT_INCR(l2dev, l2ds_read_bytes,
+				    b_asize);
 
 				if (*arc_flags & ARC_FLAG_NOWAIT) {
 					zio_nowait(rzio);
@@ -5757,7 +5772,12 @@ arc_fini(void)
  * 6. Writes to the L2ARC devices are grouped and sent in-sequence, so that
  * the vdev queue can aggregate them into larger and fewer writes.  Each
  * device is written to in a rotor fashion, sweeping writes through
- * available space then repeating.
+ * available space then repeating.  Every device has its own
+ * l2arc_feed_thread(), so multiple cache devices are fed in parallel and
+ * each is throttled by its own write size and interval.  Since each feed
+ * thread selects buffers from randomly chosen ARC sublists, new content is
+ * striped across all of the devices, and so are the reads that later hit
+ * it.  Per-device counters are exported as zfs/<pool>/l2arc_<guid>.
  *
  * 7. The L2ARC does not store dirty content.  It never needs to flush
  * write buffers back to disk based storage.
@@ -5856,67 +5876,6 @@ l2arc_write_interval(clock_t began, uint64_t wanted, uint64_t wrote)
 	return (next);
 }
 
-/*
- * Cycle through L2ARC devices.  This is how L2ARC load balances.
- * If a device is returned, this also returns holding the spa config lock.
- */
-static l2arc_dev_t *
-l2arc_dev_get_next(void)
-{
-	l2arc_dev_t *first, *next = NULL;
-
-	/*
-	 * Lock out the removal of spas (spa_namespace_lock), then removal
-	 * of cache devices (l2arc_dev_mtx).  Once a device has been selected,
-	 * both locks will be dropped and a spa config lock held instead.
-	 */
-	mutex_enter(&spa_namespace_lock);
-	mutex_enter(&l2arc_dev_mtx);
-
-	/* if there are no vdevs, there is nothing to do */
-	if (l2arc_ndev == 0)
-		goto out;
-
-	first = NULL;
-	next = l2arc_dev_last;
-	do {
-		/* loop around the list looking for a non-faulted vdev */
-		if (next == NULL) {
-			next = list_head(l2arc_dev_list);
-		} else {
-			next = list_next(l2arc_dev_list, next);
-			if (next == NULL)
-				next = list_head(l2arc_dev_list);
-		}
-
-		/* if we have come back to the start, bail out */
-		if (first == NULL)
-			first = next;
-		else if (next == first)
-			break;
-
-	} while (vdev_is_dead(next->l2ad_vdev));
-
-	/* if we were unable to find any usable vdevs, return NULL */
-	if (vdev_is_dead(next->l2ad_vdev))
-		next = NULL;
-
-	l2arc_dev_last = next;
-
-out:
-	mutex_exit(&l2arc_dev_mtx);
-
-	/*
-	 * Grab the config lock to prevent the 'next' device from being
-	 * removed while we are writing to it.
-	 */
-	if (next != NULL)
-		spa_config_enter(next->l2ad_spa, SCL_L2ARC, next, RW_READER);
-	mutex_exit(&spa_namespace_lock);
-
-	return (next);
-}
-
 /*
  * Free buffers that were tagged for destruction.
  */
@@ -6280,6 +6239,8 @@ top:
 		}
 
 		ASSERT(HDR_HAS_L2HDR(hdr));
+		L2ARC_DEVSTAT_BUMP(dev, l2ds_evicts);
+		L2ARC_DEVSTAT_INCR(dev, l2ds_evict_bytes, hdr->b_l2hdr.b_asize);
 		if (!HDR_HAS_L1HDR(hdr)) {
 			ASSERT(!HDR_L2_READING(hdr));
 			/*
@@ -6621,6 +6582,8 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz,
 	ASSERT3U(write_asize, <=, target_sz);
 	ARCSTAT_BUMP(arcstat_l2_writes_sent);
 	ARCSTAT_INCR(arcstat_l2_write_bytes, write_asize);
+	L2ARC_DEVSTAT_BUMP(dev, l2ds_writes_sent);
+	L2ARC_DEVSTAT_INCR(dev, l2ds_write_bytes, write_asize);
 	ARCSTAT_INCR(arcstat_l2_size, write_sz);
 	ARCSTAT_INCR(arcstat_l2_asize, stats_size);
 	vdev_space_update(dev->l2ad_vdev, stats_size, 0, 0);
@@ -6822,58 +6785,53 @@ l2arc_release_cdata_buf(arc_buf_hdr_t *hdr)
 }
 
 /*
- * This thread feeds the L2ARC at regular intervals.  This is the beating
- * heart of the L2ARC.
+ * This thread feeds a single L2ARC device at regular intervals.  This is
+ * the beating heart of the L2ARC.  Every cache device has its own feed
+ * thread, so devices are written in parallel and each one is throttled
+ * by its own write size and interval.
  */
 static void
-l2arc_feed_thread(void)
+l2arc_feed_thread(l2arc_dev_t *dev)
 {
 	callb_cpr_t cpr;
-	l2arc_dev_t *dev;
-	spa_t *spa;
+	spa_t *spa = dev->l2ad_spa;
 	uint64_t size, wrote;
 	clock_t begin, next = ddi_get_lbolt();
 	boolean_t headroom_boost = B_FALSE;
 	fstrans_cookie_t cookie;
 
-	CALLB_CPR_INIT(&cpr, &l2arc_feed_thr_lock, callb_generic_cpr, FTAG);
+	ASSERT(spa != NULL);
 
-	mutex_enter(&l2arc_feed_thr_lock);
+	CALLB_CPR_INIT(&cpr, &dev->l2ad_feed_lock, callb_generic_cpr, FTAG);
+
+	mutex_enter(&dev->l2ad_feed_lock);
 
 	cookie = spl_fstrans_mark();
-	while (l2arc_thread_exit == 0) {
+	while (dev->l2ad_thread_exit == 0) {
 		CALLB_CPR_SAFE_BEGIN(&cpr);
-		(void) cv_timedwait_sig(&l2arc_feed_thr_cv,
-		    &l2arc_feed_thr_lock, next);
-		CALLB_CPR_SAFE_END(&cpr, &l2arc_feed_thr_lock);
+		(void) cv_timedwait_sig(&dev->l2ad_feed_cv,
+		    &dev->l2ad_feed_lock, next);
+		CALLB_CPR_SAFE_END(&cpr, &dev->l2ad_feed_lock);
 		next = ddi_get_lbolt() + hz;
 
-		/*
-		 * Quick check for L2ARC devices.
-		 */
-		mutex_enter(&l2arc_dev_mtx);
-		if (l2arc_ndev == 0) {
-			mutex_exit(&l2arc_dev_mtx);
-			continue;
-		}
-		mutex_exit(&l2arc_dev_mtx);
+		if (dev->l2ad_thread_exit != 0)
+			break;
+
 		begin = ddi_get_lbolt();
 
 		/*
-		 * This selects the next l2arc device to write to, and in
-		 * doing so the next spa to feed from: dev->l2ad_spa.   This
-		 * will return NULL if there are now no l2arc devices or if
-		 * they are all faulted.
-		 *
-		 * If a device is returned, its spa's config lock is also
-		 * held to prevent device removal.  l2arc_dev_get_next()
-		 * will grab and release l2arc_dev_mtx.
+		 * Hold the spa config lock to prevent device removal while
+		 * we are writing to it.  The removal path holds it as writer
+		 * while it waits for this thread to exit, so only try for it
+		 * and sit out this interval if it is unavailable.
 		 */
-		if ((dev = l2arc_dev_get_next()) == NULL)
+		if (!spa_config_tryenter(spa, SCL_L2ARC, dev, RW_READER))
 			continue;
 
-		spa = dev->l2ad_spa;
-		ASSERT(spa != NULL);
+		if (vdev_is_dead(dev->l2ad_vdev)) {
+			spa_config_exit(spa, SCL_L2ARC, dev);
+			continue;
+		}
 
 		/*
 		 * If the pool is read-only then force the feed thread to
@@ -6895,6 +6853,7 @@ l2arc_feed_thread(void)
 		}
 
 		ARCSTAT_BUMP(arcstat_l2_feeds);
+		L2ARC_DEVSTAT_BUMP(dev, l2ds_feeds);
 
 		size = l2arc_write_size();
 
@@ -6916,12 +6875,46 @@ l2arc_feed_thread(void)
 	}
 	spl_fstrans_unmark(cookie);
 
-	l2arc_thread_exit = 0;
-	cv_broadcast(&l2arc_feed_thr_cv);
-	CALLB_CPR_EXIT(&cpr);		/* drops l2arc_feed_thr_lock */
+	dev->l2ad_thread_exit = 0;
+	cv_broadcast(&dev->l2ad_feed_cv);
+	CALLB_CPR_EXIT(&cpr);		/* drops l2ad_feed_lock */
 	thread_exit();
 }
 
+/*
+ * Start the feed thread for a cache device.  Called with l2arc_dev_mtx held.
+ */
+static void
+l2arc_feed_start(l2arc_dev_t *dev)
+{
+	ASSERT(MUTEX_HELD(&l2arc_dev_mtx));
+
+	mutex_enter(&dev->l2ad_feed_lock);
+	ASSERT3P(dev->l2ad_feed_thread, ==, NULL);
+	dev->l2ad_thread_exit = 0;
+	dev->l2ad_feed_thread = thread_create(NULL, 0, l2arc_feed_thread,
+	    dev, 0, &p0, TS_RUN, defclsyspri);
+	mutex_exit(&dev->l2ad_feed_lock);
+}
+
+/*
+ * Stop the feed thread for a cache device, if it has one, and wait for it
+ * to exit.  Any write it has in flight is allowed to complete.
+ */
+static void
+l2arc_feed_stop(l2arc_dev_t *dev)
+{
+	mutex_enter(&dev->l2ad_feed_lock);
+	if (dev->l2ad_feed_thread != NULL) {
+		cv_signal(&dev->l2ad_feed_cv);	/* kick thread out of sleep */
+		dev->l2ad_thread_exit = 1;
+		while (dev->l2ad_thread_exit != 0)
+			cv_wait(&dev->l2ad_feed_cv, &dev->l2ad_feed_lock);
+		dev->l2ad_feed_thread = NULL;
+	}
+	mutex_exit(&dev->l2ad_feed_lock);
+}
+
 boolean_t
 l2arc_vdev_present(vdev_t *vd)
 {
@@ -6946,6 +6939,8 @@ void
 l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 {
 	l2arc_dev_t *adddev;
+	char module[KSTAT_STRLEN];
+	char name[KSTAT_STRLEN];
 
 	ASSERT(!l2arc_vdev_present(vd));
 
@@ -6973,12 +6968,32 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	vdev_space_update(vd, 0, 0, adddev->l2ad_end - adddev->l2ad_hand);
 	refcount_create(&adddev->l2ad_alloc);
 
+	mutex_init(&adddev->l2ad_feed_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&adddev->l2ad_feed_cv, NULL, CV_DEFAULT, NULL);
+
+	/*
+	 * Export the per-device counters under the pool's kstat directory.
+	 */
+	adddev->l2ad_stats = l2arc_dev_stats_template;
+	(void) snprintf(module, KSTAT_STRLEN, "zfs/%s", spa_name(spa));
+	(void) snprintf(name, KSTAT_STRLEN, "l2arc_%llx",
+	    (u_longlong_t)vd->vdev_guid);
+	adddev->l2ad_ksp = kstat_create(module, 0, name, "misc",
+	    KSTAT_TYPE_NAMED, sizeof (l2arc_dev_stats_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (adddev->l2ad_ksp != NULL) {
+		adddev->l2ad_ksp->ks_data = &adddev->l2ad_stats;
+		kstat_install(adddev->l2ad_ksp);
+	}
+
 	/*
-	 * Add device to global list
+	 * Add device to global list and start feeding it
 	 */
 	mutex_enter(&l2arc_dev_mtx);
 	list_insert_head(l2arc_dev_list, adddev);
 	atomic_inc_64(&l2arc_ndev);
+	if (l2arc_feeding)
+		l2arc_feed_start(adddev);
 	mutex_exit(&l2arc_dev_mtx);
 }
 
@@ -7007,16 +7022,27 @@ l2arc_remove_vdev(vdev_t *vd)
 	 * Remove device from global list
 	 */
 	list_remove(l2arc_dev_list, remdev);
-	l2arc_dev_last = NULL;		/* may have been invalidated */
 	atomic_dec_64(&l2arc_ndev);
 	mutex_exit(&l2arc_dev_mtx);
 
+	/*
+	 * Wait for the device's feed thread to finish its current write.
+	 */
+	l2arc_feed_stop(remdev);
+
+	if (remdev->l2ad_ksp != NULL) {
+		kstat_delete(remdev->l2ad_ksp);
+		remdev->l2ad_ksp = NULL;
+	}
+
 	/*
 	 * Clear all buflists and ARC references.  L2ARC device flush.
 	 */
 	l2arc_evict(remdev, 0, B_TRUE);
 	list_destroy(&remdev->l2ad_buflist);
 	mutex_destroy(&remdev->l2ad_mtx);
+	mutex_destroy(&remdev->l2ad_feed_lock);
+	cv_destroy(&remdev->l2ad_feed_cv);
 	refcount_destroy(&remdev->l2ad_alloc);
 	kmem_free(remdev, sizeof (l2arc_dev_t));
 }
@@ -7024,13 +7050,11 @@ l2arc_remove_vdev(vdev_t *vd)
 void
 l2arc_init(void)
 {
-	l2arc_thread_exit = 0;
+	l2arc_feeding = B_FALSE;
 	l2arc_ndev = 0;
 	l2arc_writes_sent = 0;
 	l2arc_writes_done = 0;
 
-	mutex_init(&l2arc_feed_thr_lock, NULL, MUTEX_DEFAULT, NULL);
-	cv_init(&l2arc_feed_thr_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&l2arc_dev_mtx, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&l2arc_free_on_write_mtx, NULL, MUTEX_DEFAULT, NULL);
 
@@ -7053,8 +7077,6 @@ l2arc_fini(void)
 
 	l2arc_do_free_on_write();
 
-	mutex_destroy(&l2arc_feed_thr_lock);
-	cv_destroy(&l2arc_feed_thr_cv);
 	mutex_destroy(&l2arc_dev_mtx);
 	mutex_destroy(&l2arc_free_on_write_mtx);
 
@@ -7065,25 +7087,33 @@ l2arc_fini(void)
 void
 l2arc_start(void)
 {
+	l2arc_dev_t *dev;
+
 	if (!(spa_mode_global & FWRITE))
 		return;
 
-	(void) thread_create(NULL, 0, l2arc_feed_thread, NULL, 0, &p0,
-	    TS_RUN, defclsyspri);
+	mutex_enter(&l2arc_dev_mtx);
+	l2arc_feeding = B_TRUE;
+	for (dev = list_head(l2arc_dev_list); dev != NULL;
+	    dev = list_next(l2arc_dev_list, dev))
+		l2arc_feed_start(dev);
+	mutex_exit(&l2arc_dev_mtx);
 }
 
 void
 l2arc_stop(void)
 {
+	l2arc_dev_t *dev;
+
 	if (!(spa_mode_global & FWRITE))
 		return;
 
-	mutex_enter(&l2arc_feed_thr_lock);
-	cv_signal(&l2arc_feed_thr_cv);	/* kick thread out of startup */
-	l2arc_thread_exit = 1;
-	while (l2arc_thread_exit != 0)
-		cv_wait(&l2arc_feed_thr_cv, &l2arc_feed_thr_lock);
-	mutex_exit(&l2arc_feed_thr_lock);
+	mutex_enter(&l2arc_dev_mtx);
+	l2arc_feeding = B_FALSE;
+	for (dev = list_head(l2arc_dev_list); dev != NULL;
+	    dev = list_next(l2arc_dev_list, dev))
+		l2arc_feed_stop(dev);
+	mutex_exit(&l2arc_dev_mtx);
 }
 
 #if defined(_KERNEL) && defined(HAVE_SPL)
@@ -0,0 +1,791 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * B-tree of fixed-size elements stored by value.
+ *
+ * Every leaf is a BTREE_LEAF_SIZE buffer holding as many elements as fit;
+ * every core node holds BTREE_CORE_ELEMS elements and one more child
+ * pointer.  Apart from the root, nodes are kept at least half full: a full
+ * node is split in two around its median when an element is added, and an
+ * underfull node first borrows from a sibling and otherwise merges with it
+ * when an element is removed.  All leaves are at the same depth,
+ * bt_height.
+ */
+
+#include <sys/btree.h>
+
+/*
+ * Elements are copied through on-stack buffers while splitting, so keep
+ * them small.  Larger objects belong in an AVL tree.
+ */
+#define	BTREE_ELEM_MAX		128
+
+#define	BT_CORE_SIZE(tree)	(offsetof(zfs_btree_core_t, btc_elems) + \
+	BTREE_CORE_ELEMS * (tree)->bt_elem_size)
+
+static kmem_cache_t *zfs_btree_leaf_cache;
+
+void
+zfs_btree_init(void)
+{
+	zfs_btree_leaf_cache = kmem_cache_create("zfs_btree_leaf_cache",
+	    BTREE_LEAF_SIZE, 0, NULL, NULL, NULL, NULL, NULL, 0);
+}
+
+void
+zfs_btree_fini(void)
+{
+	kmem_cache_destroy(zfs_btree_leaf_cache);
+	zfs_btree_leaf_cache = NULL;
+}
+
+/*
+ * Release free leaf buffers back to the system under memory pressure.
+ */
+void
+zfs_btree_reap(void)
+{
+	kmem_cache_reap_now(zfs_btree_leaf_cache);
+}
+
+static inline uint8_t *
+bt_elems(zfs_btree_hdr_t *hdr)
+{
+	if (hdr->bth_core)
+		return (((zfs_btree_core_t *)hdr)->btc_elems);
+	return (((zfs_btree_leaf_t *)hdr)->btl_elems);
+}
+
+static inline void *
+bt_elem(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, uint32_t idx)
+{
+	return (bt_elems(hdr) + idx * tree->bt_elem_size);
+}
+
+static inline uint32_t
+bt_capacity(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	return (hdr->bth_core ? BTREE_CORE_ELEMS : tree->bt_leaf_cap);
+}
+
+static inline zfs_btree_hdr_t **
+bt_children(zfs_btree_hdr_t *hdr)
+{
+	ASSERT(hdr->bth_core);
+	return (((zfs_btree_core_t *)hdr)->btc_children);
+}
+
+static inline void *
+bt_set_index(zfs_btree_t *tree, zfs_btree_index_t *where,
+    zfs_btree_hdr_t *hdr, uint32_t idx)
+{
+	where->bti_node = hdr;
+	where->bti_offset = idx;
+	where->bti_before = B_FALSE;
+	return (bt_elem(tree, hdr, idx));
+}
+
+static zfs_btree_hdr_t *
+bt_node_alloc(zfs_btree_t *tree, boolean_t core)
+{
+	zfs_btree_hdr_t *hdr;
+
+	if (core)
+		hdr = kmem_alloc(BT_CORE_SIZE(tree), KM_SLEEP);
+	else
+		hdr = kmem_cache_alloc(zfs_btree_leaf_cache, KM_SLEEP);
+
+	hdr->bth_parent = NULL;
+	hdr->bth_core = core;
+	hdr->bth_count = 0;
+	tree->bt_num_nodes++;
+
+	return (hdr);
+}
+
+static void
+bt_node_free(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	ASSERT3U(tree->bt_num_nodes, >, 0);
+	tree->bt_num_nodes--;
+
+	if (hdr->bth_core)
+		kmem_free(hdr, BT_CORE_SIZE(tree));
+	else
+		kmem_cache_free(zfs_btree_leaf_cache, hdr);
+}
+
+/*
+ * Return the position of child within its parent.
+ */
+static uint32_t
+bt_child_idx(zfs_btree_core_t *parent, zfs_btree_hdr_t *child)
+{
+	uint32_t i;
+
+	for (i = 0; i <= parent->btc_hdr.bth_count; i++) {
+		if (parent->btc_children[i] == child)
+			return (i);
+	}
+
+	panic("btree child %p not found in parent %p", (void *)child,
+	    (void *)parent);
+	return (0);
+}
+
+/*
+ * Copy n entries, starting at position 'from', out of the sequence formed
+ * by inserting 'ins' at position 'idx' of the array 'src'.  Used to split
+ * a full node without first materializing the over-full node.
+ */
+static void
+bt_split_copy(uint8_t *dst, const uint8_t *src, const void *ins,
+    uint32_t idx, uint32_t from, uint32_t n, size_t size)
+{
+	uint32_t end = from + n;
+
+	if (from < idx) {
+		uint32_t cnt = MIN(idx, end) - from;
+
+		bcopy(src + from * size, dst, cnt * size);
+		dst += cnt * size;
+		from += cnt;
+	}
+	if (from == idx && from < end) {
+		bcopy(ins, dst, size);
+		dst += size;
+		from++;
+	}
+	if (from < end)
+		bcopy(src + (from - 1) * size, dst, (end - from) * size);
+}
+
+/*
+ * Make room at position idx of an array holding count entries and copy
+ * ins into it.
+ */
+static inline void
+bt_shift_insert(uint8_t *base, uint32_t count, uint32_t idx, const void *ins,
+    size_t size)
+{
+	ASSERT3U(idx, <=, count);
+	memmove(base + (idx + 1) * size, base + idx * size,
+	    (count - idx) * size);
+	bcopy(ins, base + idx * size, size);
+}
+
+void
+zfs_btree_create(zfs_btree_t *tree, int (*compar) (const void *, const void *),
+    size_t size)
+{
+	ASSERT3U(size, >, 0);
+	VERIFY3U(size, <=, BTREE_ELEM_MAX);
+
+	tree->bt_root = NULL;
+	tree->bt_height = -1;
+	tree->bt_elem_size = size;
+	tree->bt_leaf_cap = (BTREE_LEAF_SIZE -
+	    offsetof(zfs_btree_leaf_t, btl_elems)) / size;
+	tree->bt_num_elems = 0;
+	tree->bt_num_nodes = 0;
+	tree->bt_compar = compar;
+}
+
+void
+zfs_btree_destroy(zfs_btree_t *tree)
+{
+	ASSERT0(tree->bt_num_elems);
+	ASSERT3P(tree->bt_root, ==, NULL);
+	ASSERT0(tree->bt_num_nodes);
+}
+
+/*
+ * Binary search one node.  Returns the matching element and its offset, or
+ * NULL and the offset of the first element greater than value.
+ */
+static void *
+bt_find_in_node(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, const void *value,
+    uint32_t *idxp)
+{
+	uint8_t *elems = bt_elems(hdr);
+	size_t size = tree->bt_elem_size;
+	uint32_t lo = 0;
+	uint32_t hi = hdr->bth_count;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		uint8_t *cur = elems + mid * size;
+		int cmp = tree->bt_compar(value, cur);
+
+		if (cmp == 0) {
+			*idxp = mid;
+			return (cur);
+		}
+		if (cmp > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	*idxp = lo;
+	return (NULL);
+}
+
+void *
+zfs_btree_find(zfs_btree_t *tree, const void *value, zfs_btree_index_t *where)
+{
+	zfs_btree_hdr_t *hdr = tree->bt_root;
+	uint32_t idx = 0;
+	void *found;
+
+	while (hdr != NULL) {
+		found = bt_find_in_node(tree, hdr, value, &idx);
+		if (found != NULL) {
+			if (where != NULL)
+				(void) bt_set_index(tree, where, hdr, idx);
+			return (found);
+		}
+		if (!hdr->bth_core)
+			break;
+		hdr = bt_children(hdr)[idx];
+	}
+
+	/*
+	 * A miss always ends in a leaf (or an empty tree), which is where
+	 * the element would be inserted.
+	 */
+	if (where != NULL) {
+		where->bti_node = hdr;
+		where->bti_offset = idx;
+		where->bti_before = B_TRUE;
+	}
+	return (NULL);
+}
+
+/*
+ * Add the separator 'value' and the new node 'right' after 'left' in the
+ * parent of 'left', splitting the parent (and on up) if it is full.
+ */
+static void
+bt_insert_into_parent(zfs_btree_t *tree, zfs_btree_hdr_t *left,
+    const void *value, zfs_btree_hdr_t *right)
+{
+	size_t size = tree->bt_elem_size;
+	zfs_btree_core_t *parent = left->bth_parent;
+	zfs_btree_core_t *ncore;
+	zfs_btree_hdr_t *hdr;
+	uint64_t median[BTREE_ELEM_MAX / sizeof (uint64_t)];
+	uint32_t cap = BTREE_CORE_ELEMS;
+	uint32_t idx, mid, i;
+
+	if (parent == NULL) {
+		/* Splitting the root; the tree grows by one level. */
+		ASSERT3P(tree->bt_root, ==, left);
+		hdr = bt_node_alloc(tree, B_TRUE);
+		parent = (zfs_btree_core_t *)hdr;
+		parent->btc_children[0] = left;
+		parent->btc_children[1] = right;
+		bcopy(value, parent->btc_elems, size);
+		hdr->bth_count = 1;
+		left->bth_parent = parent;
+		right->bth_parent = parent;
+		tree->bt_root = hdr;
+		tree->bt_height++;
+		return;
+	}
+
+	hdr = &parent->btc_hdr;
+	idx = bt_child_idx(parent, left);
+	right->bth_parent = parent;
+
+	if (hdr->bth_count < cap) {
+		bt_shift_insert(parent->btc_elems, hdr->bth_count, idx,
+		    value, size);
+		bt_shift_insert((uint8_t *)parent->btc_children,
+		    hdr->bth_count + 1, idx + 1, &right, sizeof (right));
+		hdr->bth_count++;
+		return;
+	}
+
+	/*
+	 * The parent is full.  Of the cap + 1 elements (and cap + 2 children)
+	 * it would hold, the first mid stay, the next one moves up as the
+	 * separator and the remainder go to a new core node.
+	 */
+	mid = (cap + 1) / 2;
+	ncore = (zfs_btree_core_t *)bt_node_alloc(tree, B_TRUE);
+
+	bt_split_copy(ncore->btc_elems, parent->btc_elems, value, idx,
+	    mid + 1, cap - mid, size);
+	bt_split_copy((uint8_t *)median, parent->btc_elems, value, idx,
+	    mid, 1, size);
+	bt_split_copy((uint8_t *)ncore->btc_children,
+	    (uint8_t *)parent->btc_children, &right, idx + 1,
+	    mid + 1, cap + 1 - mid, sizeof (right));
+
+	if (idx < mid) {
+		bt_shift_insert(parent->btc_elems, mid - 1, idx, value, size);
+		bt_shift_insert((uint8_t *)parent->btc_children, mid,
+		    idx + 1, &right, sizeof (right));
+	}
+
+	hdr->bth_count = mid;
+	ncore->btc_hdr.bth_count = cap - mid;
+	for (i = 0; i <= ncore->btc_hdr.bth_count; i++)
+		ncore->btc_children[i]->bth_parent = ncore;
+
+	bt_insert_into_parent(tree, hdr, median, &ncore->btc_hdr);
+}
+
+static void
+bt_insert_into_leaf(zfs_btree_t *tree, zfs_btree_hdr_t *leaf,
+    const void *value, uint32_t idx)
+{
+	size_t size = tree->bt_elem_size;
+	uint8_t *elems = bt_elems(leaf);
+	uint64_t median[BTREE_ELEM_MAX / sizeof (uint64_t)];
+	uint32_t cap = tree->bt_leaf_cap;
+	zfs_btree_hdr_t *right;
+	uint32_t mid;
+
+	ASSERT(!leaf->bth_core);
+
+	if (leaf->bth_count < cap) {
+		bt_shift_insert(elems, leaf->bth_count, idx, value, size);
+		leaf->bth_count++;
+		return;
+	}
+
+	/* Split the full leaf as described in bt_insert_into_parent(). */
+	mid = (cap + 1) / 2;
+	right = bt_node_alloc(tree, B_FALSE);
+
+	bt_split_copy(bt_elems(right), elems, value, idx, mid + 1,
+	    cap - mid, size);
+	bt_split_copy((uint8_t *)median, elems, value, idx, mid, 1, size);
+	if (idx < mid)
+		bt_shift_insert(elems, mid - 1, idx, value, size);
+
+	leaf->bth_count = mid;
+	right->bth_count = cap - mid;
+
+	bt_insert_into_parent(tree, leaf, median, right);
+}
+
+void
+zfs_btree_add_idx(zfs_btree_t *tree, const void *value,
+    const zfs_btree_index_t *where)
+{
+	if (tree->bt_root == NULL) {
+		ASSERT3P(where->bti_node, ==, NULL);
+		tree->bt_root = bt_node_alloc(tree, B_FALSE);
+		tree->bt_height = 0;
+		bt_insert_into_leaf(tree, tree->bt_root, value, 0);
+	} else {
+		ASSERT(where->bti_before);
+		bt_insert_into_leaf(tree, where->bti_node, value,
+		    where->bti_offset);
+	}
+	tree->bt_num_elems++;
+}
+
+void
+zfs_btree_add(zfs_btree_t *tree, const void *value)
+{
+	zfs_btree_index_t where;
+
+	VERIFY3P(zfs_btree_find(tree, value, &where), ==, NULL);
+	zfs_btree_add_idx(tree, value, &where);
+}
+
+/*
+ * Restore the minimum fill of hdr after an element was taken from it,
+ * borrowing from or merging with a sibling and recursing up the tree.
+ */
+static void
+bt_rebalance(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	size_t size = tree->bt_elem_size;
+	size_t psize = sizeof (zfs_btree_hdr_t *);
+	zfs_btree_core_t *parent = hdr->bth_parent;
+	uint32_t min = bt_capacity(tree, hdr) / 2;
+	zfs_btree_hdr_t *left, *right, *sib;
+	uint32_t idx, sep, i;
+
+	if (parent == NULL) {
+		if (hdr->bth_count > 0)
+			return;
+		if (hdr->bth_core) {
+			/* The root has a single child left; promote it. */
+			tree->bt_root = bt_children(hdr)[0];
+			tree->bt_root->bth_parent = NULL;
+			tree->bt_height--;
+		} else {
+			tree->bt_root = NULL;
+			tree->bt_height = -1;
+		}
+		bt_node_free(tree, hdr);
+		return;
+	}
+
+	if (hdr->bth_count >= min)
+		return;
+
+	idx = bt_child_idx(parent, hdr);
+
+	/*
+	 * Borrow the last element of the left sibling through the parent.
+	 */
+	if (idx > 0 && (sib = parent->btc_children[idx - 1])->bth_count > min) {
+		bt_shift_insert(bt_elems(hdr), hdr->bth_count, 0,
+		    bt_elem(tree, &parent->btc_hdr, idx - 1), size);
+		bcopy(bt_elem(tree, sib, sib->bth_count - 1),
+		    bt_elem(tree, &parent->btc_hdr, idx - 1), size);
+		if (hdr->bth_core) {
+			zfs_btree_hdr_t *child =
+			    bt_children(sib)[sib->bth_count];
+
+			bt_shift_insert((uint8_t *)bt_children(hdr),
+			    hdr->bth_count + 1, 0, &child, psize);
+			child->bth_parent = (zfs_btree_core_t *)hdr;
+		}
+		sib->bth_count--;
+		hdr->bth_count++;
+		return;
+	}
+
+	/*
+	 * Borrow the first element of the right sibling through the parent.
+	 */
+	if (idx < parent->btc_hdr.bth_count &&
+	    (sib = parent->btc_children[idx + 1])->bth_count > min) {
+		bcopy(bt_elem(tree, &parent->btc_hdr, idx),
+		    bt_elem(tree, hdr, hdr->bth_count), size);
+		bcopy(bt_elem(tree, sib, 0),
+		    bt_elem(tree, &parent->btc_hdr, idx), size);
+		memmove(bt_elems(sib), bt_elem(tree, sib, 1),
+		    (sib->bth_count - 1) * size);
+		if (hdr->bth_core) {
+			zfs_btree_hdr_t **sc = bt_children(sib);
+
+			bt_children(hdr)[hdr->bth_count + 1] = sc[0];
+			sc[0]->bth_parent = (zfs_btree_core_t *)hdr;
+			memmove(sc, sc + 1, sib->bth_count * psize);
+		}
+		sib->bth_count--;
+		hdr->bth_count++;
+		return;
+	}
+
+	/*
+	 * Neither sibling can spare an element, so merge with one of them.
+	 * Both are at most half full, so the result fits in one node.
+	 */
+	if (idx > 0) {
+		sep = idx - 1;
+		left = parent->btc_children[sep];
+		right = hdr;
+	} else {
+		sep = idx;
+		left = hdr;
+		right = parent->btc_children[sep + 1];
+	}
+	ASSERT3U(left->bth_count + right->bth_count + 1, <=,
+	    bt_capacity(tree, left));
+
+	bcopy(bt_elem(tree, &parent->btc_hdr, sep),
+	    bt_elem(tree, left, left->bth_count), size);
+	bcopy(bt_elems(right), bt_elem(tree, left, left->bth_count + 1),
+	    right->bth_count * size);
+	if (left->bth_core) {
+		zfs_btree_hdr_t **lc = bt_children(left);
+		zfs_btree_hdr_t **rc = bt_children(right);
+
+		for (i = 0; i <= right->bth_count; i++) {
+			lc[left->bth_count + 1 + i] = rc[i];
+			rc[i]->bth_parent = (zfs_btree_core_t *)left;
+		}
+	}
+	left->bth_count += right->bth_count + 1;
+
+	memmove(bt_elem(tree, &parent->btc_hdr, sep),
+	    bt_elem(tree, &parent->btc_hdr, sep + 1),
+	    (parent->btc_hdr.bth_count - sep - 1) * size);
+	memmove(&parent->btc_children[sep + 1], &parent->btc_children[sep + 2],
+	    (parent->btc_hdr.bth_count - sep - 1) * psize);
+	parent->btc_hdr.bth_count--;
+
+	bt_node_free(tree, right);
+	bt_rebalance(tree, &parent->btc_hdr);
+}
+
+void
+zfs_btree_remove_idx(zfs_btree_t *tree, zfs_btree_index_t *where)
+{
+	size_t size = tree->bt_elem_size;
+	zfs_btree_hdr_t *hdr = where->bti_node;
+	uint32_t idx = where->bti_offset;
+
+	ASSERT(!where->bti_before);
+	ASSERT3U(idx, <, hdr->bth_count);
+
+	if (hdr->bth_core) {
+		/*
+		 * Overwrite the element with its predecessor, the last
+		 * element of the rightmost leaf of the left subtree, and
+		 * remove that one from its leaf instead.
+		 */
+		zfs_btree_hdr_t *leaf = bt_children(hdr)[idx];
+
+		while (leaf->bth_core)
+			leaf = bt_children(leaf)[leaf->bth_count];
+		bcopy(bt_elem(tree, leaf, leaf->bth_count - 1),
+		    bt_elem(tree, hdr, idx), size);
+		hdr = leaf;
+		idx = leaf->bth_count - 1;
+	}
+
+	memmove(bt_elem(tree, hdr, idx), bt_elem(tree, hdr, idx + 1),
+	    (hdr->bth_count - idx - 1) * size);
+	hdr->bth_count--;
+	tree->bt_num_elems--;
+
+	bt_rebalance(tree, hdr);
+}
+
+void
+zfs_btree_remove(zfs_btree_t *tree, const void *value)
+{
+	zfs_btree_index_t where;
+
+	VERIFY3P(zfs_btree_find(tree, value, &where), !=, NULL);
+	zfs_btree_remove_idx(tree, &where);
+}
+
+void *
+zfs_btree_first(zfs_btree_t *tree, zfs_btree_index_t *where)
+{
+	zfs_btree_index_t tmp;
+	zfs_btree_hdr_t *hdr = tree->bt_root;
+
+	if (hdr == NULL)
+		return (NULL);
+	while (hdr->bth_core)
+		hdr = bt_children(hdr)[0];
+
+	return (bt_set_index(tree, where != NULL ? where : &tmp, hdr, 0));
+}
+
+void *
+zfs_btree_last(zfs_btree_t *tree, zfs_btree_index_t *where)
+{
+	zfs_btree_index_t tmp;
+	zfs_btree_hdr_t *hdr = tree->bt_root;
+
+	if (hdr == NULL)
+		return (NULL);
+	while (hdr->bth_core)
+		hdr = bt_children(hdr)[hdr->bth_count];
+
+	return (bt_set_index(tree, where != NULL ? where : &tmp, hdr,
+	    hdr->bth_count - 1));
+}
+
+void *
+zfs_btree_next(zfs_btree_t *tree, const zfs_btree_index_t *idx,
+    zfs_btree_index_t *out_idx)
+{
+	zfs_btree_index_t tmp;
+	zfs_btree_hdr_t *hdr = idx->bti_node;
+	uint32_t off = idx->bti_offset;
+	zfs_btree_core_t *parent;
+	uint32_t i;
+
+	if (out_idx == NULL)
+		out_idx = &tmp;
+	if (hdr == NULL)
+		return (NULL);
+
+	if (idx->bti_before) {
+		/* The next element is the one the gap sits in front of. */
+		ASSERT(!hdr->bth_core);
+		if (off < hdr->bth_count)
+			return (bt_set_index(tree, out_idx, hdr, off));
+	} else if (hdr->bth_core) {
+		/* The leftmost element of the right subtree. */
+		hdr = bt_children(hdr)[off + 1];
+		while (hdr->bth_core)
+			hdr = bt_children(hdr)[0];
+		return (bt_set_index(tree, out_idx, hdr, 0));
+	} else if (off + 1 < hdr->bth_count) {
+		return (bt_set_index(tree, out_idx, hdr, off + 1));
+	}
+
+	/*
+	 * We were at the end of a leaf; the next element is the separator
+	 * after the first ancestor of which we are not the last child.
+	 */
+	for (; (parent = hdr->bth_parent) != NULL; hdr = &parent->btc_hdr) {
+		i = bt_child_idx(parent, hdr);
+		if (i < parent->btc_hdr.bth_count)
+			return (bt_set_index(tree, out_idx,
+			    &parent->btc_hdr, i));
+	}
+	return (NULL);
+}
+
+void *
+zfs_btree_prev(zfs_btree_t *tree, const zfs_btree_index_t *idx,
+    zfs_btree_index_t *out_idx)
+{
+	zfs_btree_index_t tmp;
+	zfs_btree_hdr_t *hdr = idx->bti_node;
+	uint32_t off = idx->bti_offset;
+	zfs_btree_core_t *parent;
+	uint32_t i;
+
+	if (out_idx == NULL)
+		out_idx = &tmp;
+	if (hdr == NULL)
+		return (NULL);
+
+	if (hdr->bth_core) {
+		/* The rightmost element of the left subtree. */
+		ASSERT(!idx->bti_before);
+		hdr = bt_children(hdr)[off];
+		while (hdr->bth_core)
+			hdr = bt_children(hdr)[hdr->bth_count];
+		return (bt_set_index(tree, out_idx, hdr, hdr->bth_count - 1));
+	} else if (off > 0) {
+		return (bt_set_index(tree, out_idx, hdr, off - 1));
+	}
+
+	for (; (parent = hdr->bth_parent) != NULL; hdr = &parent->btc_hdr) {
+		i = bt_child_idx(parent, hdr);
+		if (i > 0)
+			return (bt_set_index(tree, out_idx,
+			    &parent->btc_hdr, i - 1));
+	}
+	return (NULL);
+}
+
+void *
+zfs_btree_get(zfs_btree_t *tree, const zfs_btree_index_t *idx)
+{
+	ASSERT(!idx->bti_before);
+	ASSERT3U(idx->bti_offset, <, idx->bti_node->bth_count);
+	return (bt_elem(tree, idx->bti_node, idx->bti_offset));
+}
+
+uint64_t
+zfs_btree_numnodes(zfs_btree_t *tree)
+{
+	return (tree->bt_num_elems);
+}
+
+static void
+bt_free_subtree(zfs_btree_t *tree, zfs_btree_hdr_t *hdr)
+{
+	uint32_t i;
+
+	if (hdr->bth_core) {
+		for (i = 0; i <= hdr->bth_count; i++)
+			bt_free_subtree(tree, bt_children(hdr)[i]);
+	}
+	bt_node_free(tree, hdr);
+}
+
+void
+zfs_btree_clear(zfs_btree_t *tree)
+{
+	if (tree->bt_root != NULL)
+		bt_free_subtree(tree, tree->bt_root);
+
+	ASSERT0(tree->bt_num_nodes);
+	tree->bt_root = NULL;
+	tree->bt_height = -1;
+	tree->bt_num_elems = 0;
+}
+
+/*
+ * Verify the subtree rooted at hdr and return the number of elements in
+ * it.  lo and hi, when not NULL, are the separators bounding the subtree.
+ */
+static uint64_t
+bt_verify_subtree(zfs_btree_t *tree, zfs_btree_hdr_t *hdr, int64_t depth,
+    const void *lo, const void *hi, uint64_t *nodes)
+{
+	uint64_t count = hdr->bth_count;
+	uint32_t i;
+
+	(*nodes)++;
+	VERIFY3U(hdr->bth_count, <=, bt_capacity(tree, hdr));
+	if (hdr != tree->bt_root)
+		VERIFY3U(hdr->bth_count, >=, bt_capacity(tree, hdr) / 2);
+	else
+		VERIFY3U(hdr->bth_count, >, 0);
+	VERIFY3S(hdr->bth_core, ==, (depth < tree->bt_height));
+
+	for (i = 0; i < hdr->bth_count; i++) {
+		void *elem = bt_elem(tree, hdr, i);
+
+		if (i > 0)
+			VERIFY3S(tree->bt_compar(bt_elem(tree, hdr, i - 1),
+			    elem), <, 0);
+		if (lo != NULL)
+			VERIFY3S(tree->bt_compar(lo, elem), <, 0);
+		if (hi != NULL)
+			VERIFY3S(tree->bt_compar(elem, hi), <, 0);
+	}
+
+	if (hdr->bth_core) {
+		for (i = 0; i <= hdr->bth_count; i++) {
+			zfs_btree_hdr_t *child = bt_children(hdr)[i];
+
+			VERIFY3P(child->bth_parent, ==, hdr);
+			count += bt_verify_subtree(tree, child, depth + 1,
+			    i > 0 ? bt_elem(tree, hdr, i - 1) : lo,
+			    i < hdr->bth_count ? bt_elem(tree, hdr, i) : hi,
+			    nodes);
+		}
+	}
+
+	return (count);
+}
+
+void
+zfs_btree_verify(zfs_btree_t *tree)
+{
+	uint64_t nodes = 0;
+
+	if (tree->bt_root == NULL) {
+		VERIFY3S(tree->bt_height, ==, -1);
+		VERIFY0(tree->bt_num_elems);
+		VERIFY0(tree->bt_num_nodes);
+		return;
+	}
+
+	VERIFY3P(tree->bt_root->bth_parent, ==, NULL);
+	VERIFY3U(bt_verify_subtree(tree, tree->bt_root, 0, NULL, NULL,
+	    &nodes), ==, tree->bt_num_elems);
+	VERIFY3U(nodes, ==, tree->bt_num_nodes);
+}
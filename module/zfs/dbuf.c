@@ -77,6 +77,43 @@ static int __dbuf_hold_impl(struct dbuf_hold_impl_data *dh);
  */
 uint64_t zfs_free_range_recv_miss;
 
+/*
+ * Buffer partial writes to uncached blocks rather than reading the old
+ * block in first, and only read it if the block has not been entirely
+ * overwritten by the time it is needed; see dmu_buf_will_dirty_range().
+ */
+int zfs_dbuf_defer_partial_read = 1;
+
+/*
+ * The ranges of a DB_PARTIAL dbuf which have been written, protected by
+ * db_mtx, and the block they were written over.  The block pointer is
+ * copied when the dbuf goes PARTIAL, since the block cannot be freed
+ * until the dirty record, which the dbuf is resolved before, has synced.
+ */
+typedef struct dbuf_partial {
+	range_tree_t	*dp_written;
+	blkptr_t	dp_blkptr;
+} dbuf_partial_t;
+
+typedef struct dbuf_partial_stats {
+	kstat_named_t	dps_deferred;
+	kstat_named_t	dps_avoided;
+	kstat_named_t	dps_read_open;
+	kstat_named_t	dps_read_sync;
+} dbuf_partial_stats_t;
+
+static dbuf_partial_stats_t dbuf_partial_stats = {
+	{ "deferred",		KSTAT_DATA_UINT64 },
+	{ "avoided",		KSTAT_DATA_UINT64 },
+	{ "read_open",		KSTAT_DATA_UINT64 },
+	{ "read_sync",		KSTAT_DATA_UINT64 },
+};
+
+#define	DBUF_PARTIAL_STAT_BUMP(stat) \
+	atomic_inc_64(&dbuf_partial_stats.stat.value.ui64)
+
+static kstat_t *dbuf_partial_ksp;
+
 static void dbuf_destroy(dmu_buf_impl_t *db);
 static boolean_t dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx);
 static void dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx);
@@ -417,6 +454,14 @@ retry:
 	 * configuration is not required.
 	 */
 	dbu_evict_taskq = taskq_create("dbu_evict", 1, defclsyspri, 0, 0, 0);
+
+	dbuf_partial_ksp = kstat_create("zfs", 0, "dbuf_partial", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (dbuf_partial_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (dbuf_partial_ksp != NULL) {
+		dbuf_partial_ksp->ks_data = &dbuf_partial_stats;
+		kstat_install(dbuf_partial_ksp);
+	}
 }
 
 void
@@ -425,6 +470,11 @@ dbuf_fini(void)
 	dbuf_hash_table_t *h = &dbuf_hash_table;
 	int i;
 
+	if (dbuf_partial_ksp != NULL) {
+		kstat_delete(dbuf_partial_ksp);
+		dbuf_partial_ksp = NULL;
+	}
+
 	dbuf_stats_destroy();
 
 	for (i = 0; i < DBUF_MUTEXES; i++)
@@ -557,11 +607,210 @@ dbuf_verify(dmu_buf_impl_t *db)
 }
 #endif
 
+/*
+ * Stop tracking the written ranges of a DB_PARTIAL dbuf.  The caller sets
+ * the new state.
+ */
+static void
+dbuf_partial_destroy(dmu_buf_impl_t *db)
+{
+	dbuf_partial_t *dp = db->db_partial;
+
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+	ASSERT(dp != NULL);
+
+	range_tree_vacate(dp->dp_written, NULL, NULL);
+	range_tree_destroy(dp->dp_written);
+	kmem_free(dp, sizeof (dbuf_partial_t));
+	db->db_partial = NULL;
+}
+
+typedef struct dbuf_partial_fill_arg {
+	uint8_t		*dpf_dst;
+	const uint8_t	*dpf_src;
+	uint64_t	dpf_off;
+} dbuf_partial_fill_arg_t;
+
+/*
+ * Called for each written range in offset order: copy the old data for
+ * the gap before it.
+ */
+static void
+dbuf_partial_fill_gap(void *arg, uint64_t start, uint64_t size)
+{
+	dbuf_partial_fill_arg_t *dpf = arg;
+
+	if (start > dpf->dpf_off) {
+		bcopy(dpf->dpf_src + dpf->dpf_off, dpf->dpf_dst + dpf->dpf_off,
+		    start - dpf->dpf_off);
+	}
+	dpf->dpf_off = start + size;
+}
+
+/*
+ * The old block of a DB_PARTIAL dbuf has been read: copy it into the ranges
+ * which have not been written, leaving the dbuf CACHED.  If the read failed
+ * the dbuf goes back to DB_PARTIAL, to be tried again when next needed.
+ */
+static void
+dbuf_partial_read_done(zio_t *zio, arc_buf_t *buf, void *vdb)
+{
+	dmu_buf_impl_t *db = vdb;
+	dbuf_partial_t *dp;
+	dbuf_partial_fill_arg_t dpf;
+
+	mutex_enter(&db->db_mtx);
+	ASSERT3U(db->db_state, ==, DB_READ);
+	ASSERT(refcount_count(&db->db_holds) > 0);
+	dp = db->db_partial;
+	ASSERT(dp != NULL);
+
+	if (zio == NULL || zio->io_error == 0) {
+		ASSERT3U(arc_buf_size(buf), ==, db->db.db_size);
+
+		/* It may have been frozen when its holds were released. */
+		arc_buf_thaw(db->db_buf);
+		dpf.dpf_dst = db->db.db_data;
+		dpf.dpf_src = buf->b_data;
+		dpf.dpf_off = 0;
+		range_tree_walk(dp->dp_written, dbuf_partial_fill_gap, &dpf);
+		dbuf_partial_fill_gap(&dpf, db->db.db_size, 0);
+
+		dbuf_partial_destroy(db);
+		db->db_state = DB_CACHED;
+
+		if (db->db_freed_in_flight) {
+			dbuf_dirty_record_t *dr = db->db_last_dirty;
+
+			/*
+			 * Freed since the older txg wrote it, which still
+			 * gets the whole block; clear what is left.
+			 */
+			if (dr != NULL && dr->dt.dl.dr_data == db->db_buf) {
+				dr->dt.dl.dr_data = arc_buf_alloc(
+				    db->db_objset->os_spa, db->db.db_size, db,
+				    DBUF_GET_BUFC_TYPE(db));
+				bcopy(db->db.db_data, dr->dt.dl.dr_data->b_data,
+				    db->db.db_size);
+			}
+			bzero(db->db.db_data, db->db.db_size);
+			arc_buf_freeze(db->db_buf);
+			db->db_freed_in_flight = FALSE;
+		}
+	} else {
+		db->db_state = DB_PARTIAL;
+	}
+	VERIFY(arc_buf_remove_ref(buf, db));
+	cv_broadcast(&db->db_changed);
+	dbuf_rele_and_unlock(db, NULL);
+}
+
+/*
+ * Issue the read which a DB_PARTIAL dbuf put off, as dbuf_read_impl() does
+ * for an uncached one: the dbuf is DB_READ until dbuf_partial_read_done()
+ * has merged the old block in.  Called with db_mtx held, which is dropped.
+ */
+static int
+dbuf_partial_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
+{
+	zbookmark_phys_t zb;
+	uint32_t aflags = ARC_FLAG_NOWAIT;
+	blkptr_t bp;
+	int err;
+
+	ASSERT(!refcount_is_zero(&db->db_holds));
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+	ASSERT3U(db->db_state, ==, DB_PARTIAL);
+	ASSERT(db->db_partial != NULL);
+
+	/* dbuf_partial_read_done() frees db_partial, maybe before we return */
+	bp = db->db_partial->dp_blkptr;
+	db->db_state = DB_READ;
+	mutex_exit(&db->db_mtx);
+
+	if (dsl_pool_sync_context(dmu_objset_pool(db->db_objset)))
+		DBUF_PARTIAL_STAT_BUMP(dps_read_sync);
+	else
+		DBUF_PARTIAL_STAT_BUMP(dps_read_open);
+
+	if (DBUF_IS_L2CACHEABLE(db))
+		aflags |= ARC_FLAG_L2CACHE;
+	if (DBUF_IS_L2COMPRESSIBLE(db))
+		aflags |= ARC_FLAG_L2COMPRESS;
+
+	SET_BOOKMARK(&zb, db->db_objset->os_dsl_dataset ?
+	    db->db_objset->os_dsl_dataset->ds_object : DMU_META_OBJSET,
+	    db->db.db_object, db->db_level, db->db_blkid);
+
+	dbuf_add_ref(db, NULL);
+
+	err = arc_read(zio, db->db_objset->os_spa, &bp, dbuf_partial_read_done,
+	    db, ZIO_PRIORITY_SYNC_READ,
+	    (flags & DB_RF_CANFAIL) ? ZIO_FLAG_CANFAIL : ZIO_FLAG_MUSTSUCCEED,
+	    &aflags, &zb);
+
+	return (SET_ERROR(err));
+}
+
+/*
+ * A DB_PARTIAL dbuf is about to be overwritten in its entirety.  If it is
+ * dirty in this txg the old block is never needed, otherwise the older
+ * txg still needs the whole of it, which is read as dmu_buf_will_dirty()
+ * would.  Called with db_mtx held, which may be dropped.
+ */
+static void
+dbuf_partial_overwrite(dmu_buf_impl_t *db, dmu_tx_t *tx)
+{
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+	ASSERT3U(db->db_state, ==, DB_PARTIAL);
+
+	while (db->db_state == DB_PARTIAL &&
+	    db->db_last_dirty->dr_txg != tx->tx_txg) {
+		int rf = DB_RF_MUST_SUCCEED | DB_RF_NOPREFETCH;
+
+		mutex_exit(&db->db_mtx);
+		DB_DNODE_ENTER(db);
+		if (RW_WRITE_HELD(&DB_DNODE(db)->dn_struct_rwlock))
+			rf |= DB_RF_HAVESTRUCT;
+		DB_DNODE_EXIT(db);
+		(void) dbuf_read(db, NULL, rf);
+		mutex_enter(&db->db_mtx);
+		while (db->db_state == DB_READ || db->db_state == DB_FILL)
+			cv_wait(&db->db_changed, &db->db_mtx);
+	}
+
+	if (db->db_state == DB_PARTIAL) {
+		dbuf_partial_destroy(db);
+		db->db_state = DB_CACHED;
+		DBUF_PARTIAL_STAT_BUMP(dps_avoided);
+	}
+}
+
+/*
+ * The dirty record of a DB_PARTIAL dbuf was dropped because its object
+ * has been freed, so the old block must not be read.
+ */
+void
+dbuf_partial_discard(dmu_buf_impl_t *db)
+{
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+	ASSERT3U(db->db_state, ==, DB_PARTIAL);
+
+	dbuf_partial_destroy(db);
+	arc_buf_thaw(db->db_buf);
+	bzero(db->db.db_data, db->db.db_size);
+	db->db_freed_in_flight = FALSE;
+	db->db_state = DB_CACHED;
+	cv_broadcast(&db->db_changed);
+}
+
 static void
 dbuf_clear_data(dmu_buf_impl_t *db)
 {
 	ASSERT(MUTEX_HELD(&db->db_mtx));
 	dbuf_evict_user(db);
+	if (db->db_state == DB_PARTIAL)
+		dbuf_partial_destroy(db);
 	db->db_buf = NULL;
 	db->db.db_data = NULL;
 	if (db->db_state != DB_NOFILL)
@@ -785,15 +1034,19 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 		if ((flags & DB_RF_HAVESTRUCT) == 0)
 			rw_exit(&dn->dn_struct_rwlock);
 		DB_DNODE_EXIT(db);
-	} else if (db->db_state == DB_UNCACHED) {
+	} else if (db->db_state == DB_UNCACHED ||
+	    db->db_state == DB_PARTIAL) {
 		spa_t *spa = dn->dn_objset->os_spa;
 
 		if (zio == NULL)
 			zio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
 
-		err = dbuf_read_impl(db, zio, flags);
+		if (db->db_state == DB_PARTIAL)
+			err = dbuf_partial_read(db, zio, flags);
+		else
+			err = dbuf_read_impl(db, zio, flags);
 
-		/* dbuf_read_impl has dropped db_mtx for us */
+		/* either has dropped db_mtx for us */
 
 		if (!err && prefetch)
 			dmu_zfetch(&dn->dn_zfetch, db->db_blkid, 1);
@@ -831,6 +1084,14 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 				    db, zio_t *, zio);
 				cv_wait(&db->db_changed, &db->db_mtx);
 			}
+			if (db->db_state == DB_PARTIAL) {
+				/*
+				 * A partial write has finished, or the read
+				 * of the rest of the block failed; try it.
+				 */
+				mutex_exit(&db->db_mtx);
+				return (dbuf_read(db, zio, flags));
+			}
 			if (db->db_state == DB_UNCACHED)
 				err = SET_ERROR(EIO);
 		}
@@ -842,13 +1103,15 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 }
 
 static void
-dbuf_noread(dmu_buf_impl_t *db)
+dbuf_noread(dmu_buf_impl_t *db, dmu_tx_t *tx)
 {
 	ASSERT(!refcount_is_zero(&db->db_holds));
 	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
 	mutex_enter(&db->db_mtx);
 	while (db->db_state == DB_READ || db->db_state == DB_FILL)
 		cv_wait(&db->db_changed, &db->db_mtx);
+	if (db->db_state == DB_PARTIAL)
+		dbuf_partial_overwrite(db, tx);
 	if (db->db_state == DB_UNCACHED) {
 		arc_buf_contents_t type = DBUF_GET_BUFC_TYPE(db);
 		spa_t *spa = db->db_objset->os_spa;
@@ -893,6 +1156,12 @@ dbuf_fix_old_data(dmu_buf_impl_t *db, uint64_t txg)
 	    ((db->db_blkid  == DMU_BONUS_BLKID) ? db->db.db_data : db->db_buf)))
 		return;
 
+	/*
+	 * The older txg must be given the whole block, so callers read the
+	 * rest of a DB_PARTIAL dbuf first, or defer the free of it.
+	 */
+	ASSERT3U(db->db_state, !=, DB_PARTIAL);
+
 	/*
 	 * If the last dirty record for this dbuf has not yet synced
 	 * and its referencing the dbuf data, either:
@@ -1035,6 +1304,16 @@ dbuf_free_range(dnode_t *dn, uint64_t start_blkid, uint64_t end_blkid,
 			mutex_exit(&db->db_mtx);
 			continue;
 		}
+		if (db->db_state == DB_PARTIAL && db->db_last_dirty != NULL &&
+		    db->db_last_dirty->dr_txg != txg) {
+			/*
+			 * The older txg still needs the rest of the block,
+			 * so the free waits for dbuf_partial_read_done().
+			 */
+			db->db_freed_in_flight = TRUE;
+			mutex_exit(&db->db_mtx);
+			continue;
+		}
 		if (refcount_count(&db->db_holds) == 0) {
 			ASSERT(db->db_buf);
 			dbuf_clear(db);
@@ -1065,6 +1344,13 @@ dbuf_free_range(dnode_t *dn, uint64_t start_blkid, uint64_t end_blkid,
 				dbuf_fix_old_data(db, txg);
 			}
 		}
+		/* there is no need to read the old block of a freed one */
+		if (db->db_state == DB_PARTIAL) {
+			db->db_freed_in_flight = FALSE;
+			dbuf_partial_destroy(db);
+			db->db_state = DB_CACHED;
+			DBUF_PARTIAL_STAT_BUMP(dps_avoided);
+		}
 		/* clear the contents if its cached */
 		if (db->db_state == DB_CACHED) {
 			ASSERT(db->db.db_data != NULL);
@@ -1250,7 +1536,7 @@ dbuf_dirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 	 */
 	ASSERT(db->db_level != 0 ||
 	    db->db_state == DB_CACHED || db->db_state == DB_FILL ||
-	    db->db_state == DB_NOFILL);
+	    db->db_state == DB_NOFILL || db->db_state == DB_PARTIAL);
 
 	mutex_enter(&dn->dn_mtx);
 	/*
@@ -1525,7 +1811,7 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 
 	ASSERT(db->db.db_size != 0);
 
-	dsl_pool_undirty_space(dmu_objset_pool(dn->dn_objset),
+	dsl_pool_undirty_space(dmu_objset_pool(dn->dn_objset), dn->dn_objset,
 	    dr->dr_accounted, txg);
 
 	*drp = dr->dr_next;
@@ -1623,7 +1909,11 @@ dmu_buf_will_not_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
 {
 	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
 
+	mutex_enter(&db->db_mtx);
+	if (db->db_state == DB_PARTIAL)
+		dbuf_partial_overwrite(db, tx);
 	db->db_state = DB_NOFILL;
+	mutex_exit(&db->db_mtx);
 
 	dmu_buf_will_fill(db_fake, tx);
 }
@@ -1641,7 +1931,7 @@ dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	ASSERT(db->db.db_object != DMU_META_DNODE_OBJECT ||
 	    dmu_tx_private_ok(tx));
 
-	dbuf_noread(db);
+	dbuf_noread(db, tx);
 	(void) dbuf_dirty(db, tx);
 }
 
@@ -1667,6 +1957,126 @@ dbuf_fill_done(dmu_buf_impl_t *db, dmu_tx_t *tx)
 	mutex_exit(&db->db_mtx);
 }
 
+/*
+ * Prepare to write size bytes at off within a data block, which the caller
+ * must follow with dmu_buf_fill_range_done().  If the block is neither
+ * cached nor dirty it is not read in first: the dbuf is given an empty
+ * buffer and goes DB_PARTIAL, tracking which ranges have been written, and
+ * the old block is only read if the rest of it is needed before it has all
+ * been overwritten.  Otherwise this is just dmu_buf_will_dirty().
+ */
+void
+dmu_buf_will_dirty_range(dmu_buf_t *db_fake, uint64_t off, uint64_t size,
+    dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
+	dbuf_dirty_record_t *dr;
+	boolean_t drop_struct_lock = B_FALSE;
+	dnode_t *dn;
+
+	ASSERT(tx->tx_txg != 0);
+	ASSERT(!refcount_is_zero(&db->db_holds));
+	ASSERT3U(off + size, <=, db->db.db_size);
+
+	if (!zfs_dbuf_defer_partial_read || db->db_level != 0 ||
+	    db->db_blkid == DMU_BONUS_BLKID ||
+	    db->db_blkid == DMU_SPILL_BLKID ||
+	    db->db.db_object == DMU_META_DNODE_OBJECT ||
+	    dmu_tx_is_syncing(tx)) {
+		dmu_buf_will_dirty(db_fake, tx);
+		return;
+	}
+
+	DB_DNODE_ENTER(db);
+	dn = DB_DNODE(db);
+	/* We need the struct_rwlock to prevent db_blkptr from changing. */
+	if (!RW_WRITE_HELD(&dn->dn_struct_rwlock)) {
+		rw_enter(&dn->dn_struct_rwlock, RW_READER);
+		drop_struct_lock = B_TRUE;
+	}
+
+	mutex_enter(&db->db_mtx);
+	while (db->db_state == DB_READ || db->db_state == DB_FILL)
+		cv_wait(&db->db_changed, &db->db_mtx);
+
+	dr = db->db_last_dirty;
+	if (db->db_state == DB_UNCACHED && dr == NULL &&
+	    db->db_blkptr != NULL && !BP_IS_HOLE(db->db_blkptr) &&
+	    !BP_IS_EMBEDDED(db->db_blkptr) &&
+	    !dnode_block_freed(dn, db->db_blkid)) {
+		dbuf_partial_t *dp;
+
+		dp = kmem_alloc(sizeof (dbuf_partial_t), KM_SLEEP);
+		dp->dp_written = range_tree_create(NULL, NULL, &db->db_mtx);
+		dp->dp_blkptr = *db->db_blkptr;
+		db->db_partial = dp;
+		dbuf_set_data(db, arc_buf_alloc(dn->dn_objset->os_spa,
+		    db->db.db_size, db, DBUF_GET_BUFC_TYPE(db)));
+		db->db_state = DB_FILL;
+		DBUF_PARTIAL_STAT_BUMP(dps_deferred);
+	} else if (db->db_state == DB_PARTIAL && dr->dr_txg == tx->tx_txg) {
+		db->db_state = DB_FILL;
+	} else {
+		mutex_exit(&db->db_mtx);
+		if (drop_struct_lock)
+			rw_exit(&dn->dn_struct_rwlock);
+		DB_DNODE_EXIT(db);
+		dmu_buf_will_dirty(db_fake, tx);
+		return;
+	}
+	mutex_exit(&db->db_mtx);
+
+	if (drop_struct_lock)
+		rw_exit(&dn->dn_struct_rwlock);
+	DB_DNODE_EXIT(db);
+
+	(void) dbuf_dirty(db, tx);
+}
+
+/*
+ * Finish a write started with dmu_buf_will_dirty_range().  The size may be
+ * less than was asked for if the copy failed part way.  A partially
+ * written dbuf goes back to DB_PARTIAL, or to DB_CACHED without any read
+ * at all once the whole block has been written.
+ */
+/* ARGSUSED */
+void
+dmu_buf_fill_range_done(dmu_buf_t *db_fake, uint64_t off, uint64_t size,
+    dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
+	dbuf_partial_t *dp;
+
+	mutex_enter(&db->db_mtx);
+	dp = db->db_partial;
+	if (db->db_state != DB_FILL || dp == NULL) {
+		mutex_exit(&db->db_mtx);
+		return;
+	}
+
+	if (db->db_freed_in_flight) {
+		/* we were freed while filling */
+		bzero(db->db.db_data, db->db.db_size);
+		db->db_freed_in_flight = FALSE;
+		dbuf_partial_destroy(db);
+		db->db_state = DB_CACHED;
+	} else {
+		if (size != 0) {
+			range_tree_clear(dp->dp_written, off, size);
+			range_tree_add(dp->dp_written, off, size);
+		}
+		if (range_tree_space(dp->dp_written) == db->db.db_size) {
+			dbuf_partial_destroy(db);
+			db->db_state = DB_CACHED;
+			DBUF_PARTIAL_STAT_BUMP(dps_avoided);
+		} else {
+			db->db_state = DB_PARTIAL;
+		}
+	}
+	cv_broadcast(&db->db_changed);
+	mutex_exit(&db->db_mtx);
+}
+
 void
 dmu_buf_write_embedded(dmu_buf_t *dbuf, void *data,
     bp_embedded_type_t etype, enum zio_compress comp,
@@ -1727,6 +2137,9 @@ dbuf_assign_arcbuf(dmu_buf_impl_t *db, arc_buf_t *buf, dmu_tx_t *tx)
 	while (db->db_state == DB_READ || db->db_state == DB_FILL)
 		cv_wait(&db->db_changed, &db->db_mtx);
 
+	if (db->db_state == DB_PARTIAL)
+		dbuf_partial_overwrite(db, tx);
+
 	ASSERT(db->db_state == DB_CACHED || db->db_state == DB_UNCACHED);
 
 	if (db->db_state == DB_CACHED &&
@@ -1947,6 +2360,7 @@ dbuf_create(dnode_t *dn, uint8_t level, uint64_t blkid,
 	db->db_level = level;
 	db->db_blkid = blkid;
 	db->db_last_dirty = NULL;
+	db->db_partial = NULL;
 	db->db_dirtycnt = 0;
 	db->db_dnode_handle = dn->dn_handle;
 	db->db_parent = parent;
@@ -2040,6 +2454,7 @@ static void
 dbuf_destroy(dmu_buf_impl_t *db)
 {
 	ASSERT(refcount_is_zero(&db->db_holds));
+	ASSERT3P(db->db_partial, ==, NULL);
 
 	if (db->db_blkid != DMU_BONUS_BLKID) {
 		/*
@@ -2856,6 +3271,23 @@ dbuf_sync_leaf(dbuf_dirty_record_t *dr, dmu_tx_t *tx)
 	dprintf_dbuf_bp(db, db->db_blkptr, "blkptr=%p", db->db_blkptr);
 
 	mutex_enter(&db->db_mtx);
+	/*
+	 * A partially written block gets the rest of its data now, read as
+	 * for any other read-modify-write in syncing context.  The read may
+	 * already be in flight from open context.
+	 */
+	while (db->db_state == DB_PARTIAL || db->db_state == DB_READ) {
+		if (db->db_state == DB_READ) {
+			cv_wait(&db->db_changed, &db->db_mtx);
+			continue;
+		}
+		ASSERT3P(db->db_last_dirty, ==, dr);
+		mutex_exit(&db->db_mtx);
+		(void) dbuf_read(db, NULL, DB_RF_MUST_SUCCEED |
+		    DB_RF_NOPREFETCH);
+		mutex_enter(&db->db_mtx);
+	}
+
 	/*
 	 * To be synced, we must be dirtied.  But we
 	 * might have been freed after the dirty.
@@ -2984,6 +3416,7 @@ dbuf_sync_leaf(dbuf_dirty_record_t *dr, dmu_tx_t *tx)
 void
 dbuf_sync_list(list_t *list, int level, dmu_tx_t *tx)
 {
+	spa_t *spa = dmu_tx_pool(tx)->dp_spa;
 	dbuf_dirty_record_t *dr;
 
 	while ((dr = list_head(list))) {
@@ -3004,6 +3437,7 @@ dbuf_sync_list(list_t *list, int level, dmu_tx_t *tx)
 			VERIFY3U(dr->dr_dbuf->db_level, ==, level);
 		}
 		list_remove(list, dr);
+		spa_sync_stat_add(spa, SPA_SYNC_DBUFS, 1);
 		if (dr->dr_dbuf->db_level > 0)
 			dbuf_sync_indirect(dr, tx);
 		else
@@ -3123,7 +3557,7 @@ dbuf_write_physdone(zio_t *zio, arc_buf_t *buf, void *arg)
 	 * dsl_pool_undirty_space().
 	 */
 	delta = dr->dr_accounted / zio->io_phys_children;
-	dsl_pool_undirty_space(dp, delta, zio->io_txg);
+	dsl_pool_undirty_space(dp, os, delta, zio->io_txg);
 }
 
 /* ARGSUSED */
@@ -3388,6 +3822,8 @@ EXPORT_SYMBOL(dmu_buf_will_dirty);
 EXPORT_SYMBOL(dmu_buf_will_not_fill);
 EXPORT_SYMBOL(dmu_buf_will_fill);
 EXPORT_SYMBOL(dmu_buf_fill_done);
+EXPORT_SYMBOL(dmu_buf_will_dirty_range);
+EXPORT_SYMBOL(dmu_buf_fill_range_done);
 EXPORT_SYMBOL(dmu_buf_rele);
 EXPORT_SYMBOL(dbuf_assign_arcbuf);
 EXPORT_SYMBOL(dbuf_clear);
@@ -3408,4 +3844,8 @@ EXPORT_SYMBOL(dmu_buf_set_user_ie);
 EXPORT_SYMBOL(dmu_buf_get_user);
 EXPORT_SYMBOL(dmu_buf_freeable);
 EXPORT_SYMBOL(dmu_buf_get_blkptr);
+
+module_param(zfs_dbuf_defer_partial_read, int, 0644);
+MODULE_PARM_DESC(zfs_dbuf_defer_partial_read,
+	"Defer reading blocks for partial writes until needed");
 #endif
@@ -379,20 +379,24 @@ dmu_spill_hold_by_bonus(dmu_buf_t *bonus, void *tag, dmu_buf_t **dbp)
 }
 
 /*
- * Note: longer-term, we should modify all of the dmu_buf_*() interfaces
- * to take a held dnode rather than <os, object> -- the lookup is wasteful,
- * and can induce severe lock contention when writing to several files
- * whose dnodes are in the same block.
+ * Completes blocking dmu_read_async() requests; see dmu_read_async_done().
+ */
+static taskq_t *dmu_read_taskq;
+
+/*
+ * Hold the dbufs covering the given range, issuing any reads needed under
+ * the given zio.  On success the caller must wait for the zio, and then for
+ * any reads of the same dbufs already in progress (dmu_buf_hold_array_wait()).
+ * On failure nothing is held, and the caller must still dispose of the zio.
  */
 static int
-dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
-    boolean_t read, void *tag, int *numbufsp, dmu_buf_t ***dbpp, uint32_t flags)
+dmu_buf_hold_array_issue(dnode_t *dn, uint64_t offset, uint64_t length,
+    boolean_t read, void *tag, zio_t *zio, int *numbufsp, dmu_buf_t ***dbpp,
+    uint32_t flags)
 {
 	dmu_buf_t **dbp;
 	uint64_t blkid, nblks, i;
 	uint32_t dbuf_flags;
-	int err;
-	zio_t *zio;
 
 	ASSERT(length <= DMU_MAX_ACCESS);
 
@@ -424,14 +428,12 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 	}
 	dbp = kmem_zalloc(sizeof (dmu_buf_t *) * nblks, KM_SLEEP);
 
-	zio = zio_root(dn->dn_objset->os_spa, NULL, NULL, ZIO_FLAG_CANFAIL);
 	blkid = dbuf_whichblock(dn, 0, offset);
 	for (i = 0; i < nblks; i++) {
 		dmu_buf_impl_t *db = dbuf_hold(dn, blkid + i, tag);
 		if (db == NULL) {
 			rw_exit(&dn->dn_struct_rwlock);
 			dmu_buf_rele_array(dbp, nblks, tag);
-			zio_nowait(zio);
 			return (SET_ERROR(EIO));
 		}
 
@@ -447,29 +449,73 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 	}
 	rw_exit(&dn->dn_struct_rwlock);
 
-	/* wait for async i/o */
-	err = zio_wait(zio);
+	*numbufsp = nblks;
+	*dbpp = dbp;
+	return (0);
+}
+
+/*
+ * Wait for reads of the held dbufs issued by other threads, which
+ * dmu_buf_hold_array_issue() does not wait for, to complete.
+ */
+static int
+dmu_buf_hold_array_wait(dmu_buf_t **dbp, int numbufs)
+{
+	int i, err = 0;
+
+	for (i = 0; i < numbufs && err == 0; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		mutex_enter(&db->db_mtx);
+		while (db->db_state == DB_READ ||
+		    db->db_state == DB_FILL)
+			cv_wait(&db->db_changed, &db->db_mtx);
+		if (db->db_state == DB_PARTIAL) {
+			/* a partial write finished; dbuf_read() completes it */
+			mutex_exit(&db->db_mtx);
+			err = dbuf_read(db, NULL, DB_RF_CANFAIL |
+			    DB_RF_NOPREFETCH);
+			continue;
+		}
+		if (db->db_state == DB_UNCACHED)
+			err = SET_ERROR(EIO);
+		mutex_exit(&db->db_mtx);
+	}
+
+	return (err);
+}
+
+/*
+ * Note: longer-term, we should modify all of the dmu_buf_*() interfaces
+ * to take a held dnode rather than <os, object> -- the lookup is wasteful,
+ * and can induce severe lock contention when writing to several files
+ * whose dnodes are in the same block.
+ */
+static int
+dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
+    boolean_t read, void *tag, int *numbufsp, dmu_buf_t ***dbpp, uint32_t flags)
+{
+	dmu_buf_t **dbp;
+	int nblks, err;
+	zio_t *zio;
+
+	zio = zio_root(dn->dn_objset->os_spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	err = dmu_buf_hold_array_issue(dn, offset, length, read, tag, zio,
+	    &nblks, &dbp, flags);
 	if (err) {
-		dmu_buf_rele_array(dbp, nblks, tag);
+		zio_nowait(zio);
 		return (err);
 	}
 
+	/* wait for async i/o */
+	err = zio_wait(zio);
+
 	/* wait for other io to complete */
-	if (read) {
-		for (i = 0; i < nblks; i++) {
-			dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
-			mutex_enter(&db->db_mtx);
-			while (db->db_state == DB_READ ||
-			    db->db_state == DB_FILL)
-				cv_wait(&db->db_changed, &db->db_mtx);
-			if (db->db_state == DB_UNCACHED)
-				err = SET_ERROR(EIO);
-			mutex_exit(&db->db_mtx);
-			if (err) {
-				dmu_buf_rele_array(dbp, nblks, tag);
-				return (err);
-			}
-		}
+	if (err == 0 && read)
+		err = dmu_buf_hold_array_wait(dbp, nblks);
+
+	if (err) {
+		dmu_buf_rele_array(dbp, nblks, tag);
+		return (err);
 	}
 
 	*numbufsp = nblks;
@@ -830,18 +876,144 @@ dmu_read(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
 	return (err);
 }
 
-void
-dmu_write(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
-    const void *buf, dmu_tx_t *tx)
+typedef struct dmu_read_async_arg {
+	dmu_buf_t		**dra_dbp;
+	int			dra_numbufs;
+	int			dra_err;
+	dmu_read_done_func_t	*dra_done;
+	void			*dra_arg;
+	taskq_ent_t		dra_tqent;
+} dmu_read_async_arg_t;
+
+static void
+dmu_read_async_finish(dmu_read_async_arg_t *dra)
 {
-	dmu_buf_t **dbp;
-	int numbufs, i;
+	dra->dra_done(dra->dra_arg, dra->dra_dbp, dra->dra_numbufs,
+	    dra->dra_err);
+	kmem_free(dra, sizeof (dmu_read_async_arg_t));
+}
 
-	if (size == 0)
+static void
+dmu_read_async_wait(void *arg)
+{
+	dmu_read_async_arg_t *dra = arg;
+
+	dra->dra_err = dmu_buf_hold_array_wait(dra->dra_dbp,
+	    dra->dra_numbufs);
+	dmu_read_async_finish(dra);
+}
+
+static void
+dmu_read_async_done(zio_t *zio)
+{
+	dmu_read_async_arg_t *dra = zio->io_private;
+	int i;
+
+	/*
+	 * The buffers could not be held, and dmu_read_async() has
+	 * already returned the error to its caller.
+	 */
+	if (dra->dra_dbp == NULL) {
+		kmem_free(dra, sizeof (dmu_read_async_arg_t));
 		return;
+	}
 
-	VERIFY0(dmu_buf_hold_array(os, object, offset, size,
-	    FALSE, FTAG, &numbufs, &dbp));
+	dra->dra_err = zio->io_error;
+	if (dra->dra_err != 0) {
+		dmu_read_async_finish(dra);
+		return;
+	}
+
+	/*
+	 * Our own reads are done, but some of the buffers may have been
+	 * in the middle of being read by another thread, which we have to
+	 * wait for.  Do that from a taskq rather than blocking this zio
+	 * completion thread, which may be the one that completes them.
+	 */
+	for (i = 0; i < dra->dra_numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dra->dra_dbp[i];
+		boolean_t pending;
+
+		mutex_enter(&db->db_mtx);
+		pending = (db->db_state == DB_READ ||
+		    db->db_state == DB_FILL || db->db_state == DB_PARTIAL);
+		mutex_exit(&db->db_mtx);
+
+		if (pending) {
+			taskq_dispatch_ent(dmu_read_taskq, dmu_read_async_wait,
+			    dra, 0, &dra->dra_tqent);
+			return;
+		}
+	}
+
+	dmu_read_async_wait(dra);
+}
+
+/*
+ * Read the given range of an object without waiting for the i/o.  The
+ * dbufs covering the range are held and reads issued for any which are
+ * not cached, then done(arg, dbp, numbufs, err) is called once they have
+ * all been read, or one of them failed.  The buffers are held with arg
+ * as the tag, and the callback must release them with
+ * dmu_buf_rele_array(dbp, numbufs, arg) once it has copied out what it
+ * needs; until then the caller must keep the objset from being evicted.
+ *
+ * The callback may be called from the caller's context before
+ * dmu_read_async() returns (when everything was cached), from zio
+ * completion context or from a taskq, and should not block.  If the
+ * buffers cannot be held at all, the error is returned and the callback
+ * is not called.
+ */
+int
+dmu_read_async(dnode_t *dn, uint64_t offset, uint64_t size, uint32_t flags,
+    dmu_read_done_func_t *done, void *arg)
+{
+	dmu_read_async_arg_t *dra;
+	zio_t *zio;
+	int err;
+
+	if (size == 0) {
+		done(arg, NULL, 0, 0);
+		return (0);
+	}
+
+	dra = kmem_zalloc(sizeof (dmu_read_async_arg_t), KM_SLEEP);
+	dra->dra_done = done;
+	dra->dra_arg = arg;
+	taskq_init_ent(&dra->dra_tqent);
+
+	zio = zio_root(dn->dn_objset->os_spa, dmu_read_async_done, dra,
+	    ZIO_FLAG_CANFAIL);
+	err = dmu_buf_hold_array_issue(dn, offset, size, B_TRUE, arg, zio,
+	    &dra->dra_numbufs, &dra->dra_dbp, flags);
+	zio_nowait(zio);
+
+	return (err);
+}
+
+/*
+ * As dmu_read_async(), for the object containing the given dbuf (e.g.
+ * its bonus buffer), which saves looking up its dnode.
+ */
+int
+dmu_read_async_dbuf(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    uint32_t flags, dmu_read_done_func_t *done, void *arg)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	int err;
+
+	DB_DNODE_ENTER(db);
+	err = dmu_read_async(DB_DNODE(db), offset, size, flags, done, arg);
+	DB_DNODE_EXIT(db);
+
+	return (err);
+}
+
+static void
+dmu_write_impl(dmu_buf_t **dbp, int numbufs, uint64_t offset, uint64_t size,
+    const void *buf, dmu_tx_t *tx)
+{
+	int i;
 
 	for (i = 0; i < numbufs; i++) {
 		uint64_t tocpy;
@@ -858,20 +1030,99 @@ dmu_write(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
 		if (tocpy == db->db_size)
 			dmu_buf_will_fill(db, tx);
 		else
-			dmu_buf_will_dirty(db, tx);
+			dmu_buf_will_dirty_range(db, bufoff, tocpy, tx);
 
 		(void) memcpy((char *)db->db_data + bufoff, buf, tocpy);
 
 		if (tocpy == db->db_size)
 			dmu_buf_fill_done(db, tx);
+		else
+			dmu_buf_fill_range_done(db, bufoff, tocpy, tx);
 
 		offset += tocpy;
 		size -= tocpy;
 		buf = (char *)buf + tocpy;
 	}
+}
+
+void
+dmu_write(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
+    const void *buf, dmu_tx_t *tx)
+{
+	dmu_buf_t **dbp;
+	int numbufs;
+
+	if (size == 0)
+		return;
+
+	VERIFY0(dmu_buf_hold_array(os, object, offset, size,
+	    FALSE, FTAG, &numbufs, &dbp));
+	dmu_write_impl(dbp, numbufs, offset, size, buf, tx);
 	dmu_buf_rele_array(dbp, numbufs, FTAG);
 }
 
+/*
+ * Write a batch of ranges, which must all have been held in the given tx
+ * (see dmu_tx_hold_write_batch()).  Consecutive ranges of the same object
+ * share one dnode and bonus buffer hold.  If an object can't be held, the
+ * error is returned and any arc buffers not yet assigned are left in
+ * place for the caller to return.
+ */
+int
+dmu_write_batch(objset_t *os, dmu_write_range_t *dwr, int count,
+    dmu_tx_t *tx)
+{
+	dnode_t *dn = NULL;
+	dmu_buf_t *bonus = NULL;
+	int i, err = 0;
+
+	for (i = 0; i < count && err == 0; i++) {
+		dmu_write_range_t *r = &dwr[i];
+		dmu_buf_t **dbp;
+		int numbufs;
+
+		if (dn == NULL || dn->dn_object != r->dwr_object) {
+			if (bonus != NULL) {
+				dmu_buf_rele(bonus, FTAG);
+				bonus = NULL;
+			}
+			if (dn != NULL)
+				dnode_rele(dn, FTAG);
+			err = dnode_hold(os, r->dwr_object, FTAG, &dn);
+			if (err) {
+				dn = NULL;
+				break;
+			}
+		}
+
+		if (r->dwr_abuf != NULL) {
+			if (bonus == NULL) {
+				err = dmu_bonus_hold(os, r->dwr_object, FTAG,
+				    &bonus);
+				if (err)
+					break;
+			}
+			dmu_assign_arcbuf(bonus, r->dwr_offset, r->dwr_abuf,
+			    tx);
+			r->dwr_abuf = NULL;
+		} else if (r->dwr_length != 0) {
+			VERIFY0(dmu_buf_hold_array_by_dnode(dn, r->dwr_offset,
+			    r->dwr_length, FALSE, FTAG, &numbufs, &dbp,
+			    DMU_READ_PREFETCH));
+			dmu_write_impl(dbp, numbufs, r->dwr_offset,
+			    r->dwr_length, r->dwr_data, tx);
+			dmu_buf_rele_array(dbp, numbufs, FTAG);
+		}
+	}
+
+	if (bonus != NULL)
+		dmu_buf_rele(bonus, FTAG);
+	if (dn != NULL)
+		dnode_rele(dn, FTAG);
+
+	return (err);
+}
+
 void
 dmu_prealloc(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
     dmu_tx_t *tx)
@@ -1061,22 +1312,16 @@ xuio_stat_wbuf_nocopy()
 }
 
 #ifdef _KERNEL
-static int
-dmu_read_uio_dnode(dnode_t *dn, uio_t *uio, uint64_t size)
+/*
+ * Copy 'size' bytes starting at uio->uio_loffset from the held dbufs into
+ * the uio buffer.  Used with dmu_read_async().
+ */
+int
+dmu_read_uio_bufs(dmu_buf_t **dbp, int numbufs, uio_t *uio, uint64_t size)
 {
-	dmu_buf_t **dbp;
-	int numbufs, i, err;
+	int i, err = 0;
 	xuio_t *xuio = NULL;
 
-	/*
-	 * NB: we could do this block-at-a-time, but it's nice
-	 * to be reading in parallel.
-	 */
-	err = dmu_buf_hold_array_by_dnode(dn, uio->uio_loffset, size,
-	    TRUE, FTAG, &numbufs, &dbp, 0);
-	if (err)
-		return (err);
-
 	for (i = 0; i < numbufs; i++) {
 		uint64_t tocpy;
 		int64_t bufoff;
@@ -1110,6 +1355,26 @@ dmu_read_uio_dnode(dnode_t *dn, uio_t *uio, uint64_t size)
 
 		size -= tocpy;
 	}
+
+	return (err);
+}
+
+static int
+dmu_read_uio_dnode(dnode_t *dn, uio_t *uio, uint64_t size)
+{
+	dmu_buf_t **dbp;
+	int numbufs, err;
+
+	/*
+	 * NB: we could do this block-at-a-time, but it's nice
+	 * to be reading in parallel.
+	 */
+	err = dmu_buf_hold_array_by_dnode(dn, uio->uio_loffset, size,
+	    TRUE, FTAG, &numbufs, &dbp, 0);
+	if (err)
+		return (err);
+
+	err = dmu_read_uio_bufs(dbp, numbufs, uio, size);
 	dmu_buf_rele_array(dbp, numbufs, FTAG);
 
 	return (err);
@@ -1171,6 +1436,7 @@ static int
 dmu_write_uio_dnode(dnode_t *dn, uio_t *uio, uint64_t size, dmu_tx_t *tx)
 {
 	dmu_buf_t **dbp;
+	ssize_t resid;
 	int numbufs;
 	int err = 0;
 	int i;
@@ -1195,7 +1461,7 @@ dmu_write_uio_dnode(dnode_t *dn, uio_t *uio, uint64_t size, dmu_tx_t *tx)
 		if (tocpy == db->db_size)
 			dmu_buf_will_fill(db, tx);
 		else
-			dmu_buf_will_dirty(db, tx);
+			dmu_buf_will_dirty_range(db, bufoff, tocpy, tx);
 
 		/*
 		 * XXX uiomove could block forever (eg.nfs-backed
@@ -1203,11 +1469,19 @@ dmu_write_uio_dnode(dnode_t *dn, uio_t *uio, uint64_t size, dmu_tx_t *tx)
 		 * to lock the pages in memory, so that uiomove won't
 		 * block.
 		 */
+		resid = uio->uio_resid;
 		err = uiomove((char *)db->db_data + bufoff, tocpy,
 		    UIO_WRITE, uio);
 
+		/*
+		 * Only what was actually copied may be marked as written
+		 * in a partially written block.
+		 */
 		if (tocpy == db->db_size)
 			dmu_buf_fill_done(db, tx);
+		else
+			dmu_buf_fill_range_done(db, bufoff,
+			    resid - uio->uio_resid, tx);
 
 		if (err)
 			break;
@@ -1612,6 +1886,17 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	DB_DNODE_EXIT(db);
 
 	ASSERT(dr->dr_txg == txg);
+	if (dr->dt.dl.dr_early_write) {
+		/*
+		 * This block is being (or has been) written ahead of its
+		 * txg's sync by dmu_sync_early().  That write was not for
+		 * the log and may not be on stable storage yet, so treat
+		 * it as if the txg were syncing; just write a new log block.
+		 */
+		mutex_exit(&db->db_mtx);
+		return (dmu_sync_late_arrival(pio, os, done, zgd, &zp, &zb));
+	}
+
 	if (dr->dt.dl.dr_override_state == DR_IN_DMU_SYNC ||
 	    dr->dt.dl.dr_override_state == DR_OVERRIDDEN) {
 		/*
@@ -1642,6 +1927,103 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	return (0);
 }
 
+static void
+dmu_sync_early_done(zgd_t *zgd, int error)
+{
+	dbuf_rele((dmu_buf_impl_t *)zgd->zgd_db, zgd);
+	kmem_free(zgd->zgd_bp, sizeof (blkptr_t));
+	kmem_free(zgd, sizeof (zgd_t));
+}
+
+/*
+ * Write the dirty level 0 block of a quiesced txg ahead of that txg's sync,
+ * in the same way that dmu_sync() does for the intent log.  When the txg
+ * syncs, dbuf_sync_leaf() waits for the write and dbuf_write() only has to
+ * record the resulting block pointer.  This lets the data writes of the
+ * next txg overlap with the uberblock and label writes of the syncing one;
+ * see dsl_pool_early_write().
+ *
+ * The caller must ensure that the txg is quiesced and not yet syncing, so
+ * that nothing else can change its dirty records.  Returns the number of
+ * bytes issued, or zero if the block was skipped.
+ */
+uint64_t
+dmu_sync_early(dbuf_dirty_record_t *dr)
+{
+	dmu_buf_impl_t *db = dr->dr_dbuf;
+	objset_t *os = db->db_objset;
+	dmu_sync_arg_t *dsa;
+	zbookmark_phys_t zb;
+	zio_prop_t zp;
+	arc_buf_t *data;
+	zgd_t *zgd;
+	int blksz;
+
+	ASSERT0(db->db_level);
+
+	if (db->db_blkid == DMU_BONUS_BLKID || db->db_blkid == DMU_SPILL_BLKID)
+		return (0);
+
+	zgd = kmem_zalloc(sizeof (zgd_t), KM_SLEEP);
+	zgd->zgd_bp = kmem_zalloc(sizeof (blkptr_t), KM_SLEEP);
+	zgd->zgd_db = &db->db;
+
+	mutex_enter(&db->db_mtx);
+	data = dr->dt.dl.dr_data;
+	if (db->db_state != DB_CACHED || data == NULL || dr->dr_next != NULL ||
+	    dr->dt.dl.dr_override_state != DR_NOT_OVERRIDDEN) {
+		mutex_exit(&db->db_mtx);
+		kmem_free(zgd->zgd_bp, sizeof (blkptr_t));
+		kmem_free(zgd, sizeof (zgd_t));
+		return (0);
+	}
+
+	blksz = arc_buf_size(data);
+	if (data == db->db_buf) {
+		/*
+		 * Unlike the intent log, we hold no range lock, so the open
+		 * txg may modify db_buf while the write is in progress.
+		 * Give the dirty record its own copy, as dbuf_sync_leaf()
+		 * does; dbuf_write_done() frees it.
+		 */
+		data = arc_buf_alloc(os->os_spa, blksz, db,
+		    DBUF_GET_BUFC_TYPE(db));
+		bcopy(db->db.db_data, data->b_data, blksz);
+		dr->dt.dl.dr_data = data;
+	}
+	dr->dt.dl.dr_override_state = DR_IN_DMU_SYNC;
+	dr->dt.dl.dr_early_write = B_TRUE;
+	dbuf_add_ref(db, zgd);
+	mutex_exit(&db->db_mtx);
+
+	SET_BOOKMARK(&zb, os->os_dsl_dataset->ds_object,
+	    db->db.db_object, db->db_level, db->db_blkid);
+
+	DB_DNODE_ENTER(db);
+	dmu_write_policy(os, DB_DNODE(db), db->db_level, WP_DMU_SYNC, &zp);
+	DB_DNODE_EXIT(db);
+
+	/*
+	 * The previous txg has not committed yet, so the on-disk block a
+	 * nopwrite would compare against may still change.
+	 */
+	zp.zp_nopwrite = B_FALSE;
+
+	dsa = kmem_alloc(sizeof (dmu_sync_arg_t), KM_SLEEP);
+	dsa->dsa_dr = dr;
+	dsa->dsa_done = dmu_sync_early_done;
+	dsa->dsa_zgd = zgd;
+	dsa->dsa_tx = NULL;
+
+	zio_nowait(arc_write(NULL, os->os_spa, dr->dr_txg,
+	    zgd->zgd_bp, data, DBUF_IS_L2CACHEABLE(db),
+	    DBUF_IS_L2COMPRESSIBLE(db), &zp, dmu_sync_ready,
+	    NULL, dmu_sync_done, dsa, ZIO_PRIORITY_ASYNC_WRITE,
+	    ZIO_FLAG_CANFAIL, &zb));
+
+	return (blksz);
+}
+
 int
 dmu_object_set_blocksize(objset_t *os, uint64_t object, uint64_t size, int ibs,
 	dmu_tx_t *tx)
@@ -1978,6 +2360,7 @@ dmu_init(void)
 {
 	zfs_dbgmsg_init();
 	sa_cache_init();
+	zap_init();
 	xuio_stat_init();
 	dmu_objset_init();
 	dnode_init();
@@ -1986,11 +2369,15 @@ dmu_init(void)
 	dmu_tx_init();
 	l2arc_init();
 	arc_init();
+
+	dmu_read_taskq = taskq_create("dmu_read", max_ncpus, defclsyspri,
+	    max_ncpus, INT_MAX, TASKQ_PREPOPULATE | TASKQ_DYNAMIC);
 }
 
 void
 dmu_fini(void)
 {
+	taskq_destroy(dmu_read_taskq);
 	arc_fini(); /* arc depends on l2arc, so arc must go first */
 	l2arc_fini();
 	dmu_tx_fini();
@@ -2012,7 +2399,10 @@ EXPORT_SYMBOL(dmu_free_range);
 EXPORT_SYMBOL(dmu_free_long_range);
 EXPORT_SYMBOL(dmu_free_long_object);
 EXPORT_SYMBOL(dmu_read);
+EXPORT_SYMBOL(dmu_read_async);
+EXPORT_SYMBOL(dmu_read_async_dbuf);
 EXPORT_SYMBOL(dmu_write);
+EXPORT_SYMBOL(dmu_write_batch);
 EXPORT_SYMBOL(dmu_prealloc);
 EXPORT_SYMBOL(dmu_object_info);
 EXPORT_SYMBOL(dmu_object_info_from_dnode);
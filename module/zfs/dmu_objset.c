@@ -67,6 +67,13 @@ krwlock_t os_lock;
  */
 int dmu_find_threads = 0;
 
+/*
+ * How far, in milliseconds, an I/O rate limited dataset may run ahead of
+ * its limits after a period of inactivity.  This is the size of each
+ * token bucket, expressed as time at the limited rate.
+ */
+int zfs_ratelimit_burst_ms = 100;
+
 static void dmu_objset_find_dp_cb(void *arg);
 
 void
@@ -279,6 +286,152 @@ recordsize_changed_cb(void *arg, uint64_t newval)
 	os->os_recordsize = newval;
 }
 
+static void
+dirty_limit_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+	dsl_pool_t *dp = dmu_objset_pool(os);
+
+	/* Wake any writers waiting on the old limit */
+	mutex_enter(&dp->dp_lock);
+	os->os_dirty_limit = newval;
+	cv_broadcast(&os->os_dirty_cv);
+	mutex_exit(&dp->dp_lock);
+}
+
+static void
+rate_limit_changed(objset_t *os, objset_rate_t type, uint64_t newval)
+{
+	/*
+	 * Time reserved under the old limit no longer means anything, so
+	 * start the bucket over and let anyone sleeping on it go.
+	 */
+	mutex_enter(&os->os_rate_lock);
+	os->os_rate_limit[type] = newval;
+	os->os_rate_next[type] = 0;
+	os->os_rate_gen[type]++;
+	cv_broadcast(&os->os_rate_cv);
+	mutex_exit(&os->os_rate_lock);
+}
+
+static void
+limit_bw_read_changed_cb(void *arg, uint64_t newval)
+{
+	rate_limit_changed(arg, OS_RATE_BW_READ, newval);
+}
+
+static void
+limit_bw_write_changed_cb(void *arg, uint64_t newval)
+{
+	rate_limit_changed(arg, OS_RATE_BW_WRITE, newval);
+}
+
+static void
+limit_iops_read_changed_cb(void *arg, uint64_t newval)
+{
+	rate_limit_changed(arg, OS_RATE_IOPS_READ, newval);
+}
+
+static void
+limit_iops_write_changed_cb(void *arg, uint64_t newval)
+{
+	rate_limit_changed(arg, OS_RATE_IOPS_WRITE, newval);
+}
+
+/*
+ * Per-dataset write throttle and I/O rate limit statistics, exported as
+ * /proc/spl/kstat/zfs/<pool>/objset-0x<objsetid>.
+ */
+typedef struct objset_stats {
+	kstat_named_t	dirty_bytes;
+	kstat_named_t	dirty_limit;
+	kstat_named_t	delay_count;
+	kstat_named_t	delay_time_ns;
+	kstat_named_t	dirty_limit_waits;
+	kstat_named_t	read_throttle_count;
+	kstat_named_t	read_throttle_time_ns;
+	kstat_named_t	write_throttle_count;
+	kstat_named_t	write_throttle_time_ns;
+} objset_stats_t;
+
+static objset_stats_t objset_stats_template = {
+	{ "dirty_bytes",		KSTAT_DATA_UINT64 },
+	{ "dirty_limit",		KSTAT_DATA_UINT64 },
+	{ "delay_count",		KSTAT_DATA_UINT64 },
+	{ "delay_time_ns",		KSTAT_DATA_UINT64 },
+	{ "dirty_limit_waits",		KSTAT_DATA_UINT64 },
+	{ "read_throttle_count",	KSTAT_DATA_UINT64 },
+	{ "read_throttle_time_ns",	KSTAT_DATA_UINT64 },
+	{ "write_throttle_count",	KSTAT_DATA_UINT64 },
+	{ "write_throttle_time_ns",	KSTAT_DATA_UINT64 },
+};
+
+static int
+dmu_objset_kstat_update(kstat_t *ksp, int rw)
+{
+	objset_stats_t *ods = ksp->ks_data;
+	objset_t *os = ksp->ks_private;
+	dsl_pool_t *dp = dmu_objset_pool(os);
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	mutex_enter(&dp->dp_lock);
+	ods->dirty_bytes.value.ui64 = os->os_dirty_total;
+	ods->dirty_limit.value.ui64 = os->os_dirty_limit;
+	ods->delay_count.value.ui64 = os->os_delay_count;
+	ods->delay_time_ns.value.ui64 = os->os_delay_time;
+	ods->dirty_limit_waits.value.ui64 = os->os_dirty_limit_waits;
+	mutex_exit(&dp->dp_lock);
+
+	mutex_enter(&os->os_rate_lock);
+	ods->read_throttle_count.value.ui64 = os->os_throttle_count[0];
+	ods->read_throttle_time_ns.value.ui64 = os->os_throttle_time[0];
+	ods->write_throttle_count.value.ui64 = os->os_throttle_count[1];
+	ods->write_throttle_time_ns.value.ui64 = os->os_throttle_time[1];
+	mutex_exit(&os->os_rate_lock);
+
+	return (0);
+}
+
+static void
+dmu_objset_kstat_create(objset_t *os)
+{
+	char name[KSTAT_STRLEN];
+	char kname[KSTAT_STRLEN];
+	kstat_t *ksp;
+
+	(void) snprintf(name, KSTAT_STRLEN, "zfs/%s", spa_name(os->os_spa));
+	(void) snprintf(kname, KSTAT_STRLEN, "objset-0x%llx",
+	    (u_longlong_t)dmu_objset_id(os));
+
+	ksp = kstat_create(name, 0, kname, "misc", KSTAT_TYPE_NAMED,
+	    sizeof (objset_stats_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (ksp != NULL) {
+		ksp->ks_data = kmem_alloc(sizeof (objset_stats_t),
+		    KM_SLEEP);
+		bcopy(&objset_stats_template, ksp->ks_data,
+		    sizeof (objset_stats_t));
+		ksp->ks_private = os;
+		ksp->ks_update = dmu_objset_kstat_update;
+		kstat_install(ksp);
+	}
+	os->os_ksp = ksp;
+}
+
+static void
+dmu_objset_kstat_destroy(objset_t *os)
+{
+	kstat_t *ksp = os->os_ksp;
+
+	if (ksp != NULL) {
+		kmem_free(ksp->ks_data, sizeof (objset_stats_t));
+		kstat_delete(ksp);
+		os->os_ksp = NULL;
+	}
+}
+
 void
 dmu_objset_byteswap(void *buf, size_t size)
 {
@@ -356,6 +509,10 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 		bzero(os->os_phys, size);
 	}
 
+	cv_init(&os->os_dirty_cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&os->os_rate_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&os->os_rate_cv, NULL, CV_DEFAULT, NULL);
+
 	/*
 	 * Note: the changed_cb will be called once before the register
 	 * func returns, thus changing the checksum/compression from the
@@ -413,13 +570,43 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 				    zfs_prop_to_name(ZFS_PROP_RECORDSIZE),
 				    recordsize_changed_cb, os);
 			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_DIRTY_LIMIT),
+				    dirty_limit_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_LIMIT_BW_READ),
+				    limit_bw_read_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_LIMIT_BW_WRITE),
+				    limit_bw_write_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_LIMIT_IOPS_READ),
+				    limit_iops_read_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_LIMIT_IOPS_WRITE),
+				    limit_iops_write_changed_cb, os);
+			}
 		}
 		if (err != 0) {
 			VERIFY(arc_buf_remove_ref(os->os_phys_buf,
 			    &os->os_phys_buf));
+			cv_destroy(&os->os_dirty_cv);
+			mutex_destroy(&os->os_rate_lock);
+			cv_destroy(&os->os_rate_cv);
 			kmem_free(os, sizeof (objset_t));
 			return (err);
 		}
+		if (!ds->ds_is_snapshot)
+			dmu_objset_kstat_create(os);
 	} else {
 		/* It's the meta-objset. */
 		os->os_checksum = ZIO_CHECKSUM_FLETCHER_4;
@@ -692,6 +879,9 @@ dmu_objset_evict(objset_t *os)
 	if (ds)
 		dsl_prop_unregister_all(ds, os);
 
+	ASSERT0(os->os_dirty_total);
+	dmu_objset_kstat_destroy(os);
+
 	if (os->os_sa)
 		sa_tear_down(os);
 
@@ -733,6 +923,9 @@ dmu_objset_evict_done(objset_t *os)
 	mutex_destroy(&os->os_lock);
 	mutex_destroy(&os->os_obj_lock);
 	mutex_destroy(&os->os_user_ptr_lock);
+	cv_destroy(&os->os_dirty_cv);
+	mutex_destroy(&os->os_rate_lock);
+	cv_destroy(&os->os_rate_cv);
 	spa_evicting_os_deregister(os->os_spa, os);
 	kmem_free(os, sizeof (objset_t));
 }
@@ -743,6 +936,83 @@ dmu_objset_snap_cmtime(objset_t *os)
 	return (dsl_dir_snap_cmtime(os->os_dsl_dataset->ds_dir));
 }
 
+/*
+ * Charge n units to one of an objset's token buckets and return the time at
+ * which the I/O may start.  Each bucket is kept as the time at which it
+ * will be empty again, os_rate_next; an operation costs n / limit seconds
+ * and may start once that time is no more than the burst allowance ahead
+ * of now.
+ */
+static hrtime_t
+dmu_objset_rate_charge(objset_t *os, objset_rate_t type, uint64_t n,
+    hrtime_t now)
+{
+	uint64_t limit = os->os_rate_limit[type];
+	uint64_t cost;
+	hrtime_t next;
+
+	ASSERT(MUTEX_HELD(&os->os_rate_lock));
+
+	if (limit == 0)
+		return (now);
+
+	if (n < UINT64_MAX / NANOSEC)
+		cost = (n * NANOSEC) / limit;
+	else
+		cost = (n / limit) * NANOSEC;
+
+	next = MAX(os->os_rate_next[type], now);
+	os->os_rate_next[type] = next + cost;
+
+	return (next - MSEC2NSEC(zfs_ratelimit_burst_ms));
+}
+
+/*
+ * Apply the limit_bw_* and limit_iops_* properties to a read or write of
+ * the given size, sleeping until it may proceed.  Called from the ZPL and
+ * zvol entry points before any locks are taken.  The sleep can be
+ * interrupted by a signal, in which case EINTR is returned, and ends early
+ * if either limit is changed.
+ */
+int
+dmu_objset_rate_limit(objset_t *os, boolean_t write, uint64_t bytes)
+{
+	objset_rate_t bw = write ? OS_RATE_BW_WRITE : OS_RATE_BW_READ;
+	objset_rate_t iops = write ? OS_RATE_IOPS_WRITE : OS_RATE_IOPS_READ;
+	uint64_t bw_gen, iops_gen;
+	hrtime_t now, wakeup;
+	int error = 0;
+
+	/* Unlocked check, so that unlimited datasets pay nothing */
+	if (os->os_rate_limit[bw] == 0 && os->os_rate_limit[iops] == 0)
+		return (0);
+
+	now = gethrtime();
+	mutex_enter(&os->os_rate_lock);
+	wakeup = MAX(dmu_objset_rate_charge(os, bw, bytes, now),
+	    dmu_objset_rate_charge(os, iops, 1, now));
+	if (wakeup > now) {
+		os->os_throttle_count[write]++;
+		os->os_throttle_time[write] += wakeup - now;
+	}
+
+	bw_gen = os->os_rate_gen[bw];
+	iops_gen = os->os_rate_gen[iops];
+	while ((now = gethrtime()) < wakeup &&
+	    os->os_rate_gen[bw] == bw_gen &&
+	    os->os_rate_gen[iops] == iops_gen) {
+		(void) cv_timedwait_sig(&os->os_rate_cv, &os->os_rate_lock,
+		    ddi_get_lbolt() + MAX(NSEC_TO_TICK(wakeup - now), 1));
+		if (issig(JUSTLOOKING) && issig(FORREAL)) {
+			error = SET_ERROR(EINTR);
+			break;
+		}
+	}
+	mutex_exit(&os->os_rate_lock);
+
+	return (error);
+}
+
 /* called from dsl for meta-objset */
 objset_t *
 dmu_objset_create_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
@@ -1001,6 +1271,7 @@ dmu_objset_snapshot_one(const char *fsname, const char *snapname)
 static void
 dmu_objset_sync_dnodes(list_t *list, list_t *newlist, dmu_tx_t *tx)
 {
+	spa_t *spa = dmu_tx_pool(tx)->dp_spa;
 	dnode_t *dn;
 
 	while ((dn = list_head(list))) {
@@ -1022,6 +1293,7 @@ dmu_objset_sync_dnodes(list_t *list, list_t *newlist, dmu_tx_t *tx)
 		}
 
 		dnode_sync(dn, tx);
+		spa_sync_stat_add(spa, SPA_SYNC_DNODES, 1);
 	}
 }
 
@@ -1166,6 +1438,59 @@ dmu_objset_is_dirty(objset_t *os, uint64_t txg)
 	    !list_is_empty(&os->os_free_dnodes[txg & TXG_MASK]));
 }
 
+static uint64_t
+dmu_objset_early_write_list(list_t *list, uint64_t limit)
+{
+	dbuf_dirty_record_t *dr;
+	uint64_t issued = 0;
+
+	for (dr = list_head(list); dr != NULL && issued < limit;
+	    dr = list_next(list, dr)) {
+		if (dr->dr_dbuf->db_level > 0) {
+			mutex_enter(&dr->dt.di.dr_mtx);
+			issued += dmu_objset_early_write_list(
+			    &dr->dt.di.dr_children, limit - issued);
+			mutex_exit(&dr->dt.di.dr_mtx);
+		} else {
+			issued += dmu_sync_early(dr);
+		}
+	}
+
+	return (issued);
+}
+
+/*
+ * Start writing the dirty data of a quiesced txg ahead of its sync, up to
+ * about limit bytes; see dsl_pool_early_write().  Returns the number of
+ * bytes issued.
+ */
+uint64_t
+dmu_objset_early_write(objset_t *os, uint64_t txg, uint64_t limit)
+{
+	list_t *list = &os->os_dirty_dnodes[txg & TXG_MASK];
+	uint64_t issued = 0;
+	dnode_t *dn;
+
+	/*
+	 * Blocks written by dmu_sync() are not deduplicated until they
+	 * sync, which would waste the early write.
+	 */
+	if (os->os_dedup_checksum != ZIO_CHECKSUM_OFF)
+		return (0);
+
+	for (dn = list_head(list); dn != NULL && issued < limit;
+	    dn = list_next(list, dn)) {
+		/* Freed dnodes throw away their dirty records when synced */
+		if (dn->dn_free_txg != 0)
+			continue;
+
+		issued += dmu_objset_early_write_list(
+		    &dn->dn_dirty_records[txg & TXG_MASK], limit - issued);
+	}
+
+	return (issued);
+}
+
 static objset_used_cb_t *used_cbs[DMU_OST_NUMTYPES];
 
 void
@@ -2008,6 +2333,7 @@ EXPORT_SYMBOL(dmu_objset_find);
 EXPORT_SYMBOL(dmu_objset_byteswap);
 EXPORT_SYMBOL(dmu_objset_evict_dbufs);
 EXPORT_SYMBOL(dmu_objset_snap_cmtime);
+EXPORT_SYMBOL(dmu_objset_rate_limit);
 
 EXPORT_SYMBOL(dmu_objset_sync);
 EXPORT_SYMBOL(dmu_objset_is_dirty);
@@ -2020,4 +2346,8 @@ EXPORT_SYMBOL(dmu_objset_userquota_get_ids);
 EXPORT_SYMBOL(dmu_objset_userused_enabled);
 EXPORT_SYMBOL(dmu_objset_userspace_upgrade);
 EXPORT_SYMBOL(dmu_objset_userspace_present);
+
+module_param(zfs_ratelimit_burst_ms, int, 0644);
+MODULE_PARM_DESC(zfs_ratelimit_burst_ms,
+	"Time a rate limited dataset may run ahead of its limits");
 #endif
@@ -61,6 +61,10 @@
 int zfs_send_corrupt_data = B_FALSE;
 int zfs_send_queue_length = 16 * 1024 * 1024;
 int zfs_recv_queue_length = 16 * 1024 * 1024;
+/* Bytes of consecutive DRR_WRITE records to apply in a single tx */
+int zfs_recv_write_batch_bytes = 1024 * 1024;
+
+#define	RECV_WRITE_BATCH_MAX	64
 
 static char *dmu_recv_tag = "dmu_recv_tag";
 static const char *recv_clone_name = "%recv";
@@ -449,8 +453,16 @@ dump_dnode(dmu_sendarg_t *dsp, uint64_t object, dnode_phys_t *dnp)
 	drro->drr_toguid = dsp->dsa_toguid;
 
 	if (!(dsp->dsa_featureflags & DMU_BACKUP_FEATURE_LARGE_BLOCKS) &&
-	    drro->drr_blksz > SPA_OLD_MAXBLOCKSIZE)
+	    drro->drr_blksz > SPA_OLD_MAXBLOCKSIZE) {
+		/*
+		 * A microzap is a single block and can't be split into
+		 * smaller ones, so one larger than 128KB can only be
+		 * sent in a stream that allows large blocks.
+		 */
+		if (DMU_OT_BYTESWAP(dnp->dn_type) == DMU_BSWAP_ZAP)
+			return (SET_ERROR(ENOTSUP));
 		drro->drr_blksz = SPA_OLD_MAXBLOCKSIZE;
+	}
 
 	if (dump_record(dsp, DN_BONUS(dnp),
 	    P2ROUNDUP(dnp->dn_bonuslen, 8)) != 0) {
@@ -735,6 +747,10 @@ dmu_send_impl(void *tag, dsl_pool_t *dp, dsl_dataset_t *to_ds,
 
 	if (large_block_ok && to_ds->ds_feature_inuse[SPA_FEATURE_LARGE_BLOCKS])
 		featureflags |= DMU_BACKUP_FEATURE_LARGE_BLOCKS;
+	if (to_ds->ds_feature_inuse[SPA_FEATURE_LARGE_MICROZAP])
+		featureflags |= DMU_BACKUP_FEATURE_LARGE_MICROZAP;
+	if (to_ds->ds_feature_inuse[SPA_FEATURE_ZAP_CRC32C])
+		featureflags |= DMU_BACKUP_FEATURE_ZAP_CRC32C;
 	if (embedok &&
 	    spa_feature_is_active(dp->dp_spa, SPA_FEATURE_EMBEDDED_DATA)) {
 		featureflags |= DMU_BACKUP_FEATURE_EMBED_DATA;
@@ -1251,6 +1267,19 @@ dmu_recv_begin_check(void *arg, dmu_tx_t *tx)
 	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LARGE_BLOCKS))
 		return (SET_ERROR(ENOTSUP));
 
+	/*
+	 * Microzaps in the stream are written out as-is, so the pool
+	 * must understand the large_microzap format if the sender used it.
+	 */
+	if ((featureflags & DMU_BACKUP_FEATURE_LARGE_MICROZAP) &&
+	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LARGE_MICROZAP))
+		return (SET_ERROR(ENOTSUP));
+
+	/* Likewise, CRC32C-hashed ZAPs are only readable with zap_crc32c. */
+	if ((featureflags & DMU_BACKUP_FEATURE_ZAP_CRC32C) &&
+	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_ZAP_CRC32C))
+		return (SET_ERROR(ENOTSUP));
+
 	error = dsl_dataset_hold(dp, tofs, FTAG, &ds);
 	if (error == 0) {
 		/* target fs already exists; recv into temp clone */
@@ -1381,6 +1410,13 @@ dmu_recv_begin_sync(void *arg, dmu_tx_t *tx)
 	dmu_buf_will_dirty(newds->ds_dbuf, tx);
 	dsl_dataset_phys(newds)->ds_flags |= DS_FLAG_INCONSISTENT;
 
+	if (DMU_GET_FEATUREFLAGS(drrb->drr_versioninfo) &
+	    DMU_BACKUP_FEATURE_LARGE_MICROZAP)
+		dsl_dataset_need_feature(newds, SPA_FEATURE_LARGE_MICROZAP);
+	if (DMU_GET_FEATUREFLAGS(drrb->drr_versioninfo) &
+	    DMU_BACKUP_FEATURE_ZAP_CRC32C)
+		dsl_dataset_need_feature(newds, SPA_FEATURE_ZAP_CRC32C);
+
 	/*
 	 * If we actually created a non-clone, we need to create the
 	 * objset in our new dataset.
@@ -1474,6 +1510,10 @@ struct receive_writer_arg {
 	int err;
 	/* A map from guid to dataset to help handle dedup'd streams. */
 	avl_tree_t *guid_to_ds_map;
+	/* DRR_WRITE records waiting to be applied in one tx */
+	dmu_write_range_t *wbatch;
+	int wcount;
+	uint64_t wbytes;
 };
 
 struct receive_arg  {
@@ -1785,13 +1825,61 @@ receive_freeobjects(struct receive_writer_arg *rwa,
 	return (0);
 }
 
+/*
+ * Return the arc bufs of any queued writes which were not applied.
+ */
+static void
+receive_write_discard(struct receive_writer_arg *rwa)
+{
+	int i;
+
+	for (i = 0; i < rwa->wcount; i++) {
+		if (rwa->wbatch[i].dwr_abuf != NULL)
+			dmu_return_arcbuf(rwa->wbatch[i].dwr_abuf);
+	}
+	rwa->wcount = 0;
+	rwa->wbytes = 0;
+}
+
+/*
+ * Apply the queued writes.  Streams mostly consist of runs of writes to
+ * the same object, so doing them all in one tx saves assigning and
+ * committing a tx for every block.
+ */
+static int
+receive_write_flush(struct receive_writer_arg *rwa)
+{
+	dmu_tx_t *tx;
+	int err;
+
+	if (rwa->wcount == 0)
+		return (0);
+
+	tx = dmu_tx_create(rwa->os);
+	dmu_tx_hold_write_batch(tx, rwa->wbatch, rwa->wcount);
+	err = dmu_tx_assign(tx, TXG_WAIT);
+	if (err != 0) {
+		dmu_tx_abort(tx);
+		receive_write_discard(rwa);
+		return (err);
+	}
+	if (dmu_write_batch(rwa->os, rwa->wbatch, rwa->wcount, tx) != 0)
+		err = SET_ERROR(EINVAL);
+	dmu_tx_commit(tx);
+	receive_write_discard(rwa);
+	return (err);
+}
+
+/*
+ * Queue a write to be applied along with the following writes.  On
+ * success the arc_buf is consumed; the caller flushes the batch once it
+ * is full.
+ */
 noinline static int
 receive_write(struct receive_writer_arg *rwa, struct drr_write *drrw,
 	arc_buf_t *abuf)
 {
-	dmu_tx_t *tx;
-	dmu_buf_t *bonus;
-	int err;
+	dmu_write_range_t *dwr;
 
 	if (drrw->drr_offset + drrw->drr_length < drrw->drr_offset ||
 	    !DMU_OT_IS_VALID(drrw->drr_type))
@@ -1800,15 +1888,6 @@ receive_write(struct receive_writer_arg *rwa, struct drr_write *drrw,
 	if (dmu_object_info(rwa->os, drrw->drr_object, NULL) != 0)
 		return (SET_ERROR(EINVAL));
 
-	tx = dmu_tx_create(rwa->os);
-
-	dmu_tx_hold_write(tx, drrw->drr_object,
-	    drrw->drr_offset, drrw->drr_length);
-	err = dmu_tx_assign(tx, TXG_WAIT);
-	if (err != 0) {
-		dmu_tx_abort(tx);
-		return (err);
-	}
 	if (rwa->byteswap) {
 		dmu_object_byteswap_t byteswap =
 		    DMU_OT_BYTESWAP(drrw->drr_type);
@@ -1816,11 +1895,13 @@ receive_write(struct receive_writer_arg *rwa, struct drr_write *drrw,
 		    drrw->drr_length);
 	}
 
-	if (dmu_bonus_hold(rwa->os, drrw->drr_object, FTAG, &bonus) != 0)
-		return (SET_ERROR(EINVAL));
-	dmu_assign_arcbuf(bonus, drrw->drr_offset, abuf, tx);
-	dmu_tx_commit(tx);
-	dmu_buf_rele(bonus, FTAG);
+	dwr = &rwa->wbatch[rwa->wcount++];
+	dwr->dwr_object = drrw->drr_object;
+	dwr->dwr_offset = drrw->drr_offset;
+	dwr->dwr_length = drrw->drr_length;
+	dwr->dwr_data = NULL;
+	dwr->dwr_abuf = abuf;
+	rwa->wbytes += drrw->drr_length;
 	return (0);
 }
 
@@ -2240,6 +2321,18 @@ receive_process_record(struct receive_writer_arg *rwa,
 {
 	int err;
 
+	/* Writes are batched; everything else must see them applied first */
+	if (rrd->header.drr_type != DRR_WRITE) {
+		err = receive_write_flush(rwa);
+		if (err != 0) {
+			if (rrd->payload != NULL) {
+				kmem_free(rrd->payload, rrd->payload_size);
+				rrd->payload = NULL;
+			}
+			return (err);
+		}
+	}
+
 	switch (rrd->header.drr_type) {
 	case DRR_OBJECT:
 	{
@@ -2259,11 +2352,15 @@ receive_process_record(struct receive_writer_arg *rwa,
 	{
 		struct drr_write *drrw = &rrd->header.drr_u.drr_write;
 		err = receive_write(rwa, drrw, rrd->write_buf);
-		/* if receive_write() is successful, it consumes the arc_buf */
+		/* if receive_write() is successful, it queues the arc_buf */
 		if (err != 0)
 			dmu_return_arcbuf(rrd->write_buf);
 		rrd->write_buf = NULL;
 		rrd->payload = NULL;
+		/* the flush returns the queued arc_bufs even on failure */
+		if (err == 0 && (rwa->wcount == RECV_WRITE_BATCH_MAX ||
+		    rwa->wbytes >= zfs_recv_write_batch_bytes))
+			err = receive_write_flush(rwa);
 		return (err);
 	}
 	case DRR_WRITE_BYREF:
@@ -2308,6 +2405,9 @@ receive_writer_thread(void *arg)
 {
 	struct receive_writer_arg *rwa = arg;
 	struct receive_record_arg *rrd;
+
+	rwa->wbatch = kmem_alloc(RECV_WRITE_BATCH_MAX *
+	    sizeof (dmu_write_range_t), KM_SLEEP);
 	for (rrd = bqueue_dequeue(&rwa->q); !rrd->eos_marker;
 	    rrd = bqueue_dequeue(&rwa->q)) {
 		/*
@@ -2328,6 +2428,12 @@ receive_writer_thread(void *arg)
 		kmem_free(rrd, sizeof (*rrd));
 	}
 	kmem_free(rrd, sizeof (*rrd));
+	if (rwa->err == 0)
+		rwa->err = receive_write_flush(rwa);
+	else
+		receive_write_discard(rwa);
+	kmem_free(rwa->wbatch, RECV_WRITE_BATCH_MAX *
+	    sizeof (dmu_write_range_t));
 	mutex_enter(&rwa->mutex);
 	rwa->done = B_TRUE;
 	cv_signal(&rwa->cv);
@@ -2758,4 +2864,8 @@ dmu_objset_is_receiving(objset_t *os)
 #if defined(_KERNEL)
 module_param(zfs_send_corrupt_data, int, 0644);
 MODULE_PARM_DESC(zfs_send_corrupt_data, "Allow sending corrupt data");
+
+module_param(zfs_recv_write_batch_bytes, int, 0644);
+MODULE_PARM_DESC(zfs_recv_write_batch_bytes,
+	"Bytes of received writes to apply per transaction");
 #endif
@@ -654,6 +654,19 @@ traverse_dataset_destroyed(spa_t *spa, blkptr_t *blkptr,
 	    blkptr, txg_start, resume, flags, func, arg));
 }
 
+/*
+ * Visit only the blocks of the MOS itself, not the datasets it describes.
+ * Callers that want to divide up the datasets themselves (eg, zdb) use this
+ * together with traverse_dataset().
+ */
+int
+traverse_mos(spa_t *spa, uint64_t txg_start, int flags,
+    blkptr_cb_t func, void *arg)
+{
+	return (traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
+	    txg_start, NULL, flags, func, arg));
+}
+
 /*
  * NB: pool must not be changing on-disk (eg, from zdb or sync context).
  */
@@ -668,8 +681,7 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 	boolean_t hard = (flags & TRAVERSE_HARD);
 
 	/* visit the MOS */
-	err = traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
-	    txg_start, NULL, flags, func, arg);
+	err = traverse_mos(spa, txg_start, flags, func, arg);
 	if (err != 0)
 		return (err);
 
@@ -712,6 +724,7 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 
 #if defined(_KERNEL) && defined(HAVE_SPL)
 EXPORT_SYMBOL(traverse_dataset);
+EXPORT_SYMBOL(traverse_mos);
 EXPORT_SYMBOL(traverse_pool);
 
 module_param(zfs_pd_bytes_max, int, 0644);
@@ -441,6 +441,31 @@ dmu_tx_hold_write(dmu_tx_t *tx, uint64_t object, uint64_t off, int len)
 	dmu_tx_count_dnode(txh);
 }
 
+/*
+ * Hold all of the ranges of a batched write.  Contiguous ranges of the
+ * same object are merged, which saves looking up the dnode and walking
+ * its indirect blocks for each of them.
+ */
+void
+dmu_tx_hold_write_batch(dmu_tx_t *tx, const dmu_write_range_t *dwr,
+    int count)
+{
+	int i = 0;
+
+	while (i < count) {
+		uint64_t object = dwr[i].dwr_object;
+		uint64_t off = dwr[i].dwr_offset;
+		uint64_t end = off + dwr[i].dwr_length;
+
+		for (i++; i < count && dwr[i].dwr_object == object &&
+		    dwr[i].dwr_offset == end &&
+		    end + dwr[i].dwr_length - off <= DMU_MAX_ACCESS; i++)
+			end += dwr[i].dwr_length;
+
+		dmu_tx_hold_write(tx, object, off, end - off);
+	}
+}
+
 static void
 dmu_tx_count_free(dmu_tx_hold_t *txh, uint64_t off, uint64_t len)
 {
@@ -763,6 +788,7 @@ dmu_tx_hold_zap(dmu_tx_t *tx, uint64_t object, int add, const char *name)
 
 	if (dn->dn_maxblkid == 0 && !add) {
 		blkptr_t *bp;
+		uint64_t maxsz;
 
 		/*
 		 * If there is only one block  (i.e. this is a micro-zap)
@@ -778,14 +804,15 @@ dmu_tx_hold_zap(dmu_tx_t *tx, uint64_t object, int add, const char *name)
 		 * Use max block size here, since we don't know how much
 		 * the size will change between now and the dbuf dirty call.
 		 */
+		maxsz = mzap_max_blksz(dn->dn_objset);
 		bp = &dn->dn_phys->dn_blkptr[0];
 		if (dsl_dataset_block_freeable(dn->dn_objset->os_dsl_dataset,
 		    bp, bp->blk_birth))
-			txh->txh_space_tooverwrite += MZAP_MAX_BLKSZ;
+			txh->txh_space_tooverwrite += maxsz;
 		else
-			txh->txh_space_towrite += MZAP_MAX_BLKSZ;
+			txh->txh_space_towrite += maxsz;
 		if (!BP_IS_HOLE(bp))
-			txh->txh_space_tounref += MZAP_MAX_BLKSZ;
+			txh->txh_space_tounref += maxsz;
 		return;
 	}
 
@@ -1077,16 +1104,13 @@ int zfs_delay_resolution_ns = 100 * 1000; /* 100 microseconds */
  * optimal throughput on the backend storage, and then by changing the value
  * of zfs_delay_scale to increase the steepness of the curve.
  */
-static void
-dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
+static hrtime_t
+dmu_tx_delay_time(uint64_t dirty, uint64_t max)
 {
-	dsl_pool_t *dp = tx->tx_pool;
-	uint64_t delay_min_bytes =
-	    zfs_dirty_data_max * zfs_delay_min_dirty_percent / 100;
-	hrtime_t wakeup, min_tx_time, now;
+	uint64_t delay_min_bytes = max * zfs_delay_min_dirty_percent / 100;
 
 	if (dirty <= delay_min_bytes)
-		return;
+		return (0);
 
 	/*
 	 * The caller has already waited until we are under the max.
@@ -1094,12 +1118,66 @@ dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 	 * have to handle the case of it being >= the max, which could
 	 * cause a divide-by-zero if it's == the max.
 	 */
-	ASSERT3U(dirty, <, zfs_dirty_data_max);
+	ASSERT3U(dirty, <, max);
+
+	return (MIN(zfs_delay_scale * (dirty - delay_min_bytes) /
+	    (max - dirty), zfs_delay_max_ns));
+}
+
+/*
+ * The objset whose dirty data is accounted to this tx, if any.  Transactions
+ * on the MOS, or not tied to an objset, are only throttled pool-wide.
+ */
+static objset_t *
+dmu_tx_dirty_objset(dmu_tx_t *tx)
+{
+	objset_t *os = tx->tx_objset;
+
+	if (os == NULL || os->os_dsl_dataset == NULL)
+		return (NULL);
+	return (os);
+}
+
+/*
+ * The pool-wide delay is adjusted per dataset in two ways.  If the dataset
+ * has a dirty_limit, the same curve is applied to its own dirty data and
+ * limit, and the larger of the two delays is used.  If zfs_delay_fair_share
+ * is set and several datasets have dirty data, the pool-wide delay is
+ * scaled by the ratio of the dataset's dirty data to an equal share of the
+ * pool's, and delayed transactions are spaced out per dataset, so that a
+ * dataset writing heavily does not hold back the others.
+ */
+static void
+dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty, uint64_t os_dirty,
+    uint64_t nobjsets)
+{
+	dsl_pool_t *dp = tx->tx_pool;
+	objset_t *os = dmu_tx_dirty_objset(tx);
+	hrtime_t wakeup, min_tx_time, now, *last_wakeup;
+	uint64_t limit;
+
+	min_tx_time = dmu_tx_delay_time(dirty, zfs_dirty_data_max);
+	last_wakeup = &dp->dp_last_wakeup;
+
+	if (os != NULL) {
+		if (zfs_delay_fair_share && nobjsets > 1) {
+			uint64_t share = MAX(dirty / nobjsets, 1);
+
+			min_tx_time = MIN(min_tx_time *
+			    (os_dirty * 256 / share) / 256, zfs_delay_max_ns);
+			last_wakeup = &os->os_last_wakeup;
+		}
+		if ((limit = dsl_pool_dirty_limit(os)) != 0 &&
+		    os_dirty < limit) {
+			min_tx_time = MAX(min_tx_time,
+			    dmu_tx_delay_time(os_dirty, limit));
+		}
+	}
+
+	if (min_tx_time == 0)
+		return;
 
 	now = gethrtime();
-	min_tx_time = zfs_delay_scale *
-	    (dirty - delay_min_bytes) / (zfs_dirty_data_max - dirty);
-	min_tx_time = MIN(min_tx_time, zfs_delay_max_ns);
 	if (now > tx->tx_start + min_tx_time)
 		return;
 
@@ -1108,8 +1186,12 @@ dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 
 	mutex_enter(&dp->dp_lock);
 	wakeup = MAX(tx->tx_start + min_tx_time,
-	    dp->dp_last_wakeup + min_tx_time);
-	dp->dp_last_wakeup = wakeup;
+	    *last_wakeup + min_tx_time);
+	*last_wakeup = wakeup;
+	if (os != NULL) {
+		os->os_delay_count++;
+		os->os_delay_time += wakeup - now;
+	}
 	mutex_exit(&dp->dp_lock);
 
 	zfs_sleep_until(wakeup);
@@ -1150,7 +1232,7 @@ dmu_tx_try_assign(dmu_tx_t *tx, txg_how_t txg_how)
 	}
 
 	if (!tx->tx_waited &&
-	    dsl_pool_need_dirty_delay(tx->tx_pool)) {
+	    dsl_pool_need_dirty_delay(tx->tx_pool, dmu_tx_dirty_objset(tx))) {
 		tx->tx_wait_dirty = B_TRUE;
 		DMU_TX_STAT_BUMP(dmu_tx_dirty_delay);
 		return (ERESTART);
@@ -1331,22 +1413,44 @@ dmu_tx_wait(dmu_tx_t *tx)
 	before = gethrtime();
 
 	if (tx->tx_wait_dirty) {
-		uint64_t dirty;
+		objset_t *os = dmu_tx_dirty_objset(tx);
+		uint64_t dirty, os_dirty = 0, nobjsets;
+		uint64_t limit;
 
 		/*
 		 * dmu_tx_try_assign() has determined that we need to wait
 		 * because we've consumed much or all of the dirty buffer
-		 * space.
+		 * space, either the pool's or that allowed for our objset.
 		 */
 		mutex_enter(&dp->dp_lock);
 		if (dp->dp_dirty_total >= zfs_dirty_data_max)
 			DMU_TX_STAT_BUMP(dmu_tx_dirty_over_max);
-		while (dp->dp_dirty_total >= zfs_dirty_data_max)
-			cv_wait(&dp->dp_spaceavail_cv, &dp->dp_lock);
+		for (;;) {
+			if (dp->dp_dirty_total >= zfs_dirty_data_max) {
+				cv_wait(&dp->dp_spaceavail_cv, &dp->dp_lock);
+			} else if (os != NULL &&
+			    (limit = dsl_pool_dirty_limit(os)) != 0 &&
+			    os->os_dirty_total >= limit) {
+				/*
+				 * Only syncing a txg frees up our objset's
+				 * dirty data, so keep one moving rather than
+				 * wait for the pool to fill or the txg timeout.
+				 */
+				os->os_dirty_limit_waits++;
+				txg_kick(dp);
+				(void) cv_timedwait(&os->os_dirty_cv,
+				    &dp->dp_lock, ddi_get_lbolt() + (hz / 10));
+			} else {
+				break;
+			}
+		}
 		dirty = dp->dp_dirty_total;
+		if (os != NULL)
+			os_dirty = os->os_dirty_total;
+		nobjsets = dp->dp_dirty_objsets;
 		mutex_exit(&dp->dp_lock);
 
-		dmu_tx_delay(tx, dirty);
+		dmu_tx_delay(tx, dirty, os_dirty, nobjsets);
 
 		tx->tx_wait_dirty = B_FALSE;
 
@@ -1704,6 +1808,7 @@ dmu_tx_fini(void)
 #if defined(_KERNEL) && defined(HAVE_SPL)
 EXPORT_SYMBOL(dmu_tx_create);
 EXPORT_SYMBOL(dmu_tx_hold_write);
+EXPORT_SYMBOL(dmu_tx_hold_write_batch);
 EXPORT_SYMBOL(dmu_tx_hold_free);
 EXPORT_SYMBOL(dmu_tx_hold_zap);
 EXPORT_SYMBOL(dmu_tx_hold_bonus);
@@ -1825,7 +1825,7 @@ dnode_willuse_space(dnode_t *dn, int64_t space, dmu_tx_t *tx)
 
 	if (ds != NULL) {
 		dsl_dir_willuse_space(ds->ds_dir, aspace, tx);
-		dsl_pool_dirty_space(dmu_tx_pool(tx), space, tx);
+		dsl_pool_dirty_space(dmu_tx_pool(tx), os, space, tx);
 	}
 
 	dmu_tx_willuse_space(tx, aspace);
@@ -1626,6 +1626,26 @@ dsl_dataset_sync(dsl_dataset_t *ds, zio_t *zio, dmu_tx_t *tx)
 	}
 }
 
+/*
+ * Request activation of a per-dataset feature.  This may be called from
+ * open context by a consumer which is about to dirty data in ds that
+ * depends on the feature; the feature is activated when the dataset is
+ * synced in that txg.
+ */
+void
+dsl_dataset_need_feature(dsl_dataset_t *ds, spa_feature_t f)
+{
+	ASSERT(spa_feature_table[f].fi_flags & ZFEATURE_FLAG_PER_DATASET);
+	ASSERT(spa_feature_is_enabled(ds->ds_dir->dd_pool->dp_spa, f));
+
+	if (ds->ds_feature_inuse[f])
+		return;
+
+	mutex_enter(&ds->ds_lock);
+	ds->ds_feature_activation_needed[f] = B_TRUE;
+	mutex_exit(&ds->ds_lock);
+}
+
 static void
 get_clones_stat(dsl_dataset_t *ds, nvlist_t *nv)
 {
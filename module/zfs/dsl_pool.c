@@ -128,6 +128,23 @@ int zfs_delay_min_dirty_percent = 60;
  */
 unsigned long zfs_delay_scale = 1000 * 1000 * 1000 / 2000;
 
+/*
+ * When more than one dataset has dirty data, scale each transaction's delay
+ * by how much of the dirty data belongs to its dataset relative to an equal
+ * share, and queue delayed transactions per dataset rather than pool-wide.
+ * A dataset writing more than its share is then delayed more, and one
+ * writing less is delayed less, instead of all writers being throttled
+ * alike by the pool-wide amount of dirty data.
+ */
+int zfs_delay_fair_share = 1;
+
+/*
+ * While the syncing txg writes its uberblock and labels, write up to this
+ * much of the next txg's dirty data, if the next txg is to be synced right
+ * after it.  See dsl_pool_early_write().  Zero disables early writes.
+ */
+unsigned long zfs_sync_early_write_max = 64 * 1024 * 1024;
+
 hrtime_t zfs_throttle_delay = MSEC2NSEC(10);
 hrtime_t zfs_throttle_resolution = MSEC2NSEC(10);
 
@@ -173,6 +190,9 @@ dsl_pool_open_impl(spa_t *spa, uint64_t txg)
 	dp->dp_iput_taskq = taskq_create("z_iput", max_ncpus, defclsyspri,
 	    max_ncpus * 8, INT_MAX, TASKQ_PREPOPULATE | TASKQ_DYNAMIC);
 
+	dp->dp_early_taskq = taskq_create("z_early_write", 1, defclsyspri,
+	    1, 1, 0);
+
 	return (dp);
 }
 
@@ -332,6 +352,7 @@ dsl_pool_close(dsl_pool_t *dp)
 	rrw_destroy(&dp->dp_config_rwlock);
 	mutex_destroy(&dp->dp_lock);
 	taskq_destroy(dp->dp_iput_taskq);
+	taskq_destroy(dp->dp_early_taskq);
 	if (dp->dp_blkstats)
 		vmem_free(dp->dp_blkstats, sizeof (zfs_all_blkstats_t));
 	kmem_free(dp, sizeof (dsl_pool_t));
@@ -459,6 +480,53 @@ dsl_pool_dirty_delta(dsl_pool_t *dp, int64_t delta)
 		cv_signal(&dp->dp_spaceavail_cv);
 }
 
+/*
+ * Account for a change in the dirty data of an objset in the given txg.
+ * Each objset's dirty_limit, if set, is enforced by waiting on os_dirty_cv
+ * in dmu_tx_wait().
+ */
+static void
+dsl_pool_objset_dirty_delta(dsl_pool_t *dp, objset_t *os, int64_t delta,
+    uint64_t txg)
+{
+	ASSERT(MUTEX_HELD(&dp->dp_lock));
+
+	if (delta < 0) {
+		/* As with the pool, undirtying may exceed what was dirtied */
+		delta = -MIN(-delta, os->os_dirty_pertxg[txg & TXG_MASK]);
+		if (delta == 0)
+			return;
+	} else if (os->os_dirty_total == 0) {
+		dp->dp_dirty_objsets++;
+	}
+
+	os->os_dirty_pertxg[txg & TXG_MASK] += delta;
+	os->os_dirty_total += delta;
+	if (os->os_dirty_total == 0) {
+		ASSERT3U(dp->dp_dirty_objsets, >, 0);
+		dp->dp_dirty_objsets--;
+	}
+
+	/*
+	 * As with dp_spaceavail_cv, signal on every change so that each
+	 * waiter wakes the next one.
+	 */
+	if (os->os_dirty_total < dsl_pool_dirty_limit(os))
+		cv_signal(&os->os_dirty_cv);
+}
+
+/*
+ * The dirty data limit of an objset, capped at the pool-wide limit, or
+ * zero if it has none.
+ */
+uint64_t
+dsl_pool_dirty_limit(objset_t *os)
+{
+	if (os->os_dirty_limit == 0)
+		return (0);
+	return (MIN(os->os_dirty_limit, zfs_dirty_data_max));
+}
+
 void
 dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 {
@@ -468,7 +536,9 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 	dsl_dataset_t *ds;
 	objset_t *mos = dp->dp_meta_objset;
 	list_t synced_datasets;
+	hrtime_t start, now;
 
+	start = gethrtime();
 	list_create(&synced_datasets, sizeof (dsl_dataset_t),
 	    offsetof(dsl_dataset_t, ds_synced_link));
 
@@ -497,7 +567,15 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 	 * rounding error in dbuf_write_physdone).
 	 * Shore up the accounting of any dirtied space now.
 	 */
-	dsl_pool_undirty_space(dp, dp->dp_dirty_pertxg[txg & TXG_MASK], txg);
+	for (ds = list_head(&synced_datasets); ds != NULL;
+	    ds = list_next(&synced_datasets, ds)) {
+		objset_t *os = ds->ds_objset;
+
+		dsl_pool_undirty_space(dp, os,
+		    os->os_dirty_pertxg[txg & TXG_MASK], txg);
+	}
+	dsl_pool_undirty_space(dp, NULL, dp->dp_dirty_pertxg[txg & TXG_MASK],
+	    txg);
 
 	/*
 	 * After the data blocks have been written (ensured by the zio_wait()
@@ -558,11 +636,19 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 		dp->dp_mos_uncompressed_delta = 0;
 	}
 
+	now = gethrtime();
+	spa_sync_stat_add(dp->dp_spa, SPA_SYNC_TIME_DATASETS, now - start);
+	start = now;
+
 	if (list_head(&mos->os_dirty_dnodes[txg & TXG_MASK]) != NULL ||
 	    list_head(&mos->os_free_dnodes[txg & TXG_MASK]) != NULL) {
 		dsl_pool_sync_mos(dp, tx);
 	}
 
+	now = gethrtime();
+	spa_sync_stat_add(dp->dp_spa, SPA_SYNC_TIME_MOS, now - start);
+	start = now;
+
 	/*
 	 * If we modify a dataset in the same txg that we want to destroy it,
 	 * its dsl_dir's dd_dbuf will be dirty, and thus have a hold on it.
@@ -585,6 +671,9 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 
 	dmu_tx_commit(tx);
 
+	spa_sync_stat_add(dp->dp_spa, SPA_SYNC_TIME_TASKS,
+	    gethrtime() - start);
+
 	DTRACE_PROBE2(dsl_pool_sync__done, dsl_pool_t *dp, dp, uint64_t, txg);
 }
 
@@ -602,6 +691,67 @@ dsl_pool_sync_done(dsl_pool_t *dp, uint64_t txg)
 	ASSERT(!dmu_objset_is_dirty(dp->dp_meta_objset, txg));
 }
 
+static void
+dsl_pool_early_write_task(void *arg)
+{
+	dsl_pool_t *dp = arg;
+	uint64_t txg = dp->dp_early_txg;
+	uint64_t limit = zfs_sync_early_write_max;
+	uint64_t issued = 0;
+	dsl_dataset_t *ds;
+
+	if (!txg_wait_quiesced(dp, txg))
+		return;
+
+	for (ds = txg_list_head(&dp->dp_dirty_datasets, txg);
+	    ds != NULL && issued < limit;
+	    ds = txg_list_next(&dp->dp_dirty_datasets, ds, txg))
+		issued += dmu_objset_early_write(ds->ds_objset, txg,
+		    limit - issued);
+
+	dp->dp_early_bytes[txg & TXG_MASK] = issued;
+}
+
+/*
+ * Called by spa_sync() once txg - 1 has converged.  All that is left of
+ * that sync is to write the uberblock and labels, which is dominated by
+ * cache flushes.  If txg will be synced as soon as txg - 1 is done, get it
+ * quiesced and start writing its dirty data in the background, in the same
+ * way that the intent log does with dmu_sync().  The blocks are allocated
+ * in txg and are only referenced once txg syncs, so nothing on disk
+ * changes until txg - 1 has committed.
+ */
+void
+dsl_pool_early_write(dsl_pool_t *dp, uint64_t txg)
+{
+	if (zfs_sync_early_write_max == 0 ||
+	    txg > spa_freeze_txg(dp->dp_spa) ||
+	    !txg_quiesce_early(dp, txg - 1))
+		return;
+
+	dp->dp_early_txg = txg;
+	dp->dp_early_bytes[txg & TXG_MASK] = 0;
+	VERIFY(taskq_dispatch(dp->dp_early_taskq, dsl_pool_early_write_task,
+	    dp, TQ_SLEEP) != 0);
+}
+
+/*
+ * Called by spa_sync() before it touches txg, to wait for any early writes
+ * to finish being issued.  Returns the number of bytes written early.
+ */
+uint64_t
+dsl_pool_early_write_wait(dsl_pool_t *dp, uint64_t txg)
+{
+	uint64_t issued;
+
+	taskq_wait(dp->dp_early_taskq);
+
+	issued = dp->dp_early_bytes[txg & TXG_MASK];
+	dp->dp_early_bytes[txg & TXG_MASK] = 0;
+
+	return (issued);
+}
+
 /*
  * TRUE if the current thread is the tx_sync_thread or if we
  * are being called from SPA context during pool initialization.
@@ -631,40 +781,58 @@ dsl_pool_adjustedsize(dsl_pool_t *dp, boolean_t netfree)
 	return (space - resv);
 }
 
+/*
+ * Determine whether a transaction should be delayed, either because the
+ * pool has enough dirty data to start delaying all writers, or because the
+ * objset it modifies is approaching its own dirty data limit.
+ */
 boolean_t
-dsl_pool_need_dirty_delay(dsl_pool_t *dp)
+dsl_pool_need_dirty_delay(dsl_pool_t *dp, objset_t *os)
 {
 	uint64_t delay_min_bytes =
 	    zfs_dirty_data_max * zfs_delay_min_dirty_percent / 100;
+	uint64_t limit;
 	boolean_t rv;
 
 	mutex_enter(&dp->dp_lock);
 	if (dp->dp_dirty_total > zfs_dirty_data_sync)
 		txg_kick(dp);
 	rv = (dp->dp_dirty_total > delay_min_bytes);
+	if (!rv && os != NULL && (limit = dsl_pool_dirty_limit(os)) != 0 &&
+	    os->os_dirty_total > limit * zfs_delay_min_dirty_percent / 100) {
+		/* Only a txg sync will bring this objset back under */
+		txg_kick(dp);
+		rv = B_TRUE;
+	}
 	mutex_exit(&dp->dp_lock);
 	return (rv);
 }
 
 void
-dsl_pool_dirty_space(dsl_pool_t *dp, int64_t space, dmu_tx_t *tx)
+dsl_pool_dirty_space(dsl_pool_t *dp, objset_t *os, int64_t space,
+    dmu_tx_t *tx)
 {
 	if (space > 0) {
 		mutex_enter(&dp->dp_lock);
 		dp->dp_dirty_pertxg[tx->tx_txg & TXG_MASK] += space;
 		dsl_pool_dirty_delta(dp, space);
+		if (os != NULL)
+			dsl_pool_objset_dirty_delta(dp, os, space, tx->tx_txg);
 		mutex_exit(&dp->dp_lock);
 	}
 }
 
 void
-dsl_pool_undirty_space(dsl_pool_t *dp, int64_t space, uint64_t txg)
+dsl_pool_undirty_space(dsl_pool_t *dp, objset_t *os, int64_t space,
+    uint64_t txg)
 {
 	ASSERT3S(space, >=, 0);
 	if (space == 0)
 		return;
 
 	mutex_enter(&dp->dp_lock);
+	if (os != NULL)
+		dsl_pool_objset_dirty_delta(dp, os, -space, txg);
 	if (dp->dp_dirty_pertxg[txg & TXG_MASK] < space) {
 		/* XXX writing something we didn't dirty? */
 		space = dp->dp_dirty_pertxg[txg & TXG_MASK];
@@ -1104,4 +1272,12 @@ MODULE_PARM_DESC(zfs_dirty_data_sync, "sync txg when this much dirty data");
 
 module_param(zfs_delay_scale, ulong, 0644);
 MODULE_PARM_DESC(zfs_delay_scale, "how quickly delay approaches infinity");
+
+module_param(zfs_delay_fair_share, int, 0644);
+MODULE_PARM_DESC(zfs_delay_fair_share,
+	"delay datasets by their share of the dirty data");
+
+module_param(zfs_sync_early_write_max, ulong, 0644);
+MODULE_PARM_DESC(zfs_sync_early_write_max,
+	"max bytes of the next txg to write while a txg commits");
 #endif
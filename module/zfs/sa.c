@@ -1549,6 +1549,14 @@ sa_find_idx_tab(objset_t *os, dmu_object_type_t bonustype, void *data)
 			}
 		}
 		if (valid_idx) {
+			/*
+			 * Keep the most recently used table at the head
+			 * so that the common variant is found first.
+			 */
+			if (idx_tab != list_head(&tb->lot_idx_tab)) {
+				list_remove(&tb->lot_idx_tab, idx_tab);
+				list_insert_head(&tb->lot_idx_tab, idx_tab);
+			}
 			sa_idx_tab_hold(os, idx_tab);
 			return (idx_tab);
 		}
@@ -1568,7 +1576,7 @@ sa_find_idx_tab(objset_t *os, dmu_object_type_t bonustype, void *data)
 	    tb, idx_tab);
 	sa_idx_tab_hold(os, idx_tab);   /* one hold for consumer */
 	sa_idx_tab_hold(os, idx_tab);	/* one for layout */
-	list_insert_tail(&tb->lot_idx_tab, idx_tab);
+	list_insert_head(&tb->lot_idx_tab, idx_tab);
 	return (idx_tab);
 }
 
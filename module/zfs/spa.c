@@ -6571,6 +6571,19 @@ spa_sync_upgrades(spa_t *spa, dmu_tx_t *tx)
 	rrw_exit(&dp->dp_config_rwlock, FTAG);
 }
 
+/*
+ * Charge the time since *start to the given sync phase, and restart the
+ * clock for the next one.
+ */
+static void
+spa_sync_time(spa_t *spa, spa_sync_stat_t stat, hrtime_t *start)
+{
+	hrtime_t now = gethrtime();
+
+	spa_sync_stat_add(spa, stat, now - *start);
+	*start = now;
+}
+
 /*
  * Sync the specified transaction group.  New blocks may be dirtied as
  * part of the process, so we iterate until it converges.
@@ -6584,11 +6597,21 @@ spa_sync(spa_t *spa, uint64_t txg)
 	vdev_t *rvd = spa->spa_root_vdev;
 	vdev_t *vd;
 	dmu_tx_t *tx;
+	hrtime_t start;
 	int error;
 	int c;
 
 	VERIFY(spa_writeable(spa));
 
+	bzero(spa->spa_sync_stats, sizeof (spa->spa_sync_stats));
+
+	/*
+	 * Wait for any early writes of this txg, which were started while
+	 * the previous txg committed, to be issued.
+	 */
+	spa_sync_stat_add(spa, SPA_SYNC_EARLY,
+	    dsl_pool_early_write_wait(dp, txg));
+
 	/*
 	 * Lock out configuration changes.
 	 */
@@ -6656,13 +6679,20 @@ spa_sync(spa_t *spa, uint64_t txg)
 	do {
 		int pass = ++spa->spa_sync_pass;
 
+		spa_sync_stat_add(spa, SPA_SYNC_PASSES, 1);
+		start = gethrtime();
+
 		spa_sync_config_object(spa, tx);
 		spa_sync_aux_dev(spa, &spa->spa_spares, tx,
 		    ZPOOL_CONFIG_SPARES, DMU_POOL_SPARES);
 		spa_sync_aux_dev(spa, &spa->spa_l2cache, tx,
 		    ZPOOL_CONFIG_L2CACHE, DMU_POOL_L2CACHE);
 		spa_errlog_sync(spa, txg);
+		spa_sync_time(spa, SPA_SYNC_TIME_CONFIG, &start);
+
+		/* dsl_pool_sync() accounts for its own phases */
 		dsl_pool_sync(dp, txg);
+		start = gethrtime();
 
 		if (pass < zfs_sync_pass_deferred_free) {
 			spa_sync_frees(spa, free_bpl, tx);
@@ -6675,15 +6705,21 @@ spa_sync(spa_t *spa, uint64_t txg)
 			bplist_iterate(free_bpl, bpobj_enqueue_cb,
 			    &spa->spa_deferred_bpobj, tx);
 		}
+		spa_sync_time(spa, SPA_SYNC_TIME_FREES, &start);
 
 		ddt_sync(spa, txg);
+		spa_sync_time(spa, SPA_SYNC_TIME_DDT, &start);
+
 		dsl_scan_sync(dp, tx);
+		spa_sync_time(spa, SPA_SYNC_TIME_SCAN, &start);
 
 		while ((vd = txg_list_remove(&spa->spa_vdev_txg_list, txg)))
 			vdev_sync(vd, txg);
+		spa_sync_time(spa, SPA_SYNC_TIME_VDEVS, &start);
 
 		if (pass == 1) {
 			spa_sync_upgrades(spa, tx);
+			spa_sync_time(spa, SPA_SYNC_TIME_CONFIG, &start);
 			ASSERT3U(txg, >=,
 			    spa->spa_uberblock.ub_rootbp.blk_birth);
 			/*
@@ -6712,6 +6748,7 @@ spa_sync(spa_t *spa, uint64_t txg)
 				break;
 			}
 			spa_sync_deferred_frees(spa, tx);
+			spa_sync_time(spa, SPA_SYNC_TIME_FREES, &start);
 		}
 
 	} while (dmu_objset_is_dirty(mos, txg));
@@ -6733,6 +6770,13 @@ spa_sync(spa_t *spa, uint64_t txg)
 	}
 #endif
 
+	/*
+	 * The data for this txg is all written.  While we commit it, start
+	 * writing the data for the next one if it is due to be synced next.
+	 */
+	start = gethrtime();
+	dsl_pool_early_write(dp, txg + 1);
+
 	/*
 	 * Rewrite the vdev configuration (which includes the uberblock)
 	 * to commit the transaction group.
@@ -6780,6 +6824,7 @@ spa_sync(spa_t *spa, uint64_t txg)
 		zio_resume_wait(spa);
 	}
 	dmu_tx_commit(tx);
+	spa_sync_time(spa, SPA_SYNC_TIME_COMMIT, &start);
 
 	taskq_cancel_id(system_taskq, spa->spa_deadman_tqid);
 	spa->spa_deadman_tqid = 0;
@@ -6820,6 +6865,9 @@ spa_sync(spa_t *spa, uint64_t txg)
 	ASSERT(txg_list_empty(&dp->dp_dirty_dirs, txg));
 	ASSERT(txg_list_empty(&spa->spa_vdev_txg_list, txg));
 
+	spa_sync_time(spa, SPA_SYNC_TIME_DONE, &start);
+	spa_txg_history_set_sync(spa, txg, spa->spa_sync_stats);
+
 	spa->spa_sync_pass = 0;
 
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
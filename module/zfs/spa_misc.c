@@ -40,6 +40,7 @@
 #include <sys/uberblock_impl.h>
 #include <sys/txg.h>
 #include <sys/avl.h>
+#include <sys/btree.h>
 #include <sys/unique.h>
 #include <sys/dsl_pool.h>
 #include <sys/dsl_dir.h>
@@ -1570,6 +1571,15 @@ spa_syncing_txg(spa_t *spa)
 	return (spa->spa_syncing_txg);
 }
 
+/*
+ * Account work done for the txg being synced, see spa_sync_stat_t.
+ */
+void
+spa_sync_stat_add(spa_t *spa, spa_sync_stat_t stat, uint64_t delta)
+{
+	atomic_add_64(&spa->spa_sync_stats[stat], delta);
+}
+
 pool_state_t
 spa_state(spa_t *spa)
 {
@@ -1825,7 +1835,7 @@ spa_init(int mode)
 	fm_init();
 	refcount_init();
 	unique_init();
-	range_tree_init();
+	zfs_btree_init();
 	ddt_init();
 	zio_init();
 	dmu_init();
@@ -1850,7 +1860,7 @@ spa_fini(void)
 	dmu_fini();
 	zio_fini();
 	ddt_fini();
-	range_tree_fini();
+	zfs_btree_fini();
 	unique_fini();
 	refcount_fini();
 	fm_fini();
@@ -246,18 +246,40 @@ typedef struct spa_txg_history {
 	uint64_t	reads;		/* number of read operations */
 	uint64_t	writes;		/* number of write operations */
 	uint64_t	ndirty;		/* number of dirty bytes */
+	uint64_t	sync[SPA_SYNC_STATS]; /* sync phase statistics */
 	hrtime_t	times[TXG_STATE_COMMITTED]; /* completion times */
 	list_node_t	sth_link;
 } spa_txg_history_t;
 
+/*
+ * Column names for spa_sync_stat_t, in order.
+ */
+static const char *spa_txg_history_sync_names[SPA_SYNC_STATS] = {
+	"passes", "ndnodes", "ndbufs", "nfrees", "nearly",
+	"cfgtime", "dstime", "mostime", "tasktime", "freetime",
+	"ddttime", "scantime", "vdevtime", "condtime", "ctime", "donetime"
+};
+
 static int
 spa_txg_history_headers(char *buf, size_t size)
 {
+	size_t len;
+	int i;
+
 	(void) snprintf(buf, size, "%-8s %-16s %-5s %-12s %-12s %-12s "
-	    "%-8s %-8s %-12s %-12s %-12s %-12s\n", "txg", "birth", "state",
+	    "%-8s %-8s %-12s %-12s %-12s %-12s", "txg", "birth", "state",
 	    "ndirty", "nread", "nwritten", "reads", "writes",
 	    "otime", "qtime", "wtime", "stime");
 
+	for (i = 0; i < SPA_SYNC_STATS; i++) {
+		len = strlen(buf);
+		(void) snprintf(buf + len, size - len, " %-12s",
+		    spa_txg_history_sync_names[i]);
+	}
+
+	len = strlen(buf);
+	(void) snprintf(buf + len, size - len, "\n");
+
 	return (0);
 }
 
@@ -266,7 +288,9 @@ spa_txg_history_data(char *buf, size_t size, void *data)
 {
 	spa_txg_history_t *sth = (spa_txg_history_t *)data;
 	uint64_t open = 0, quiesce = 0, wait = 0, sync = 0;
+	size_t len;
 	char state;
+	int i;
 
 	switch (sth->state) {
 		case TXG_STATE_BIRTH:		state = 'B';	break;
@@ -295,7 +319,7 @@ spa_txg_history_data(char *buf, size_t size, void *data)
 		    sth->times[TXG_STATE_WAIT_FOR_SYNC];
 
 	(void) snprintf(buf, size, "%-8llu %-16llu %-5c %-12llu "
-	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu\n",
+	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu",
 	    (longlong_t)sth->txg, sth->times[TXG_STATE_BIRTH], state,
 	    (u_longlong_t)sth->ndirty,
 	    (u_longlong_t)sth->nread, (u_longlong_t)sth->nwritten,
@@ -303,6 +327,15 @@ spa_txg_history_data(char *buf, size_t size, void *data)
 	    (u_longlong_t)open, (u_longlong_t)quiesce, (u_longlong_t)wait,
 	    (u_longlong_t)sync);
 
+	for (i = 0; i < SPA_SYNC_STATS; i++) {
+		len = strlen(buf);
+		(void) snprintf(buf + len, size - len, " %-12llu",
+		    (u_longlong_t)sth->sync[i]);
+	}
+
+	len = strlen(buf);
+	(void) snprintf(buf + len, size - len, "\n");
+
 	return (0);
 }
 
@@ -503,6 +536,33 @@ spa_txg_history_set_io(spa_t *spa, uint64_t txg, uint64_t nread,
 	return (error);
 }
 
+/*
+ * Set txg sync phase stats.
+ */
+int
+spa_txg_history_set_sync(spa_t *spa, uint64_t txg, const uint64_t *stats)
+{
+	spa_stats_history_t *ssh = &spa->spa_stats.txg_history;
+	spa_txg_history_t *sth;
+	int error = ENOENT;
+
+	if (zfs_txg_history == 0)
+		return (0);
+
+	mutex_enter(&ssh->lock);
+	for (sth = list_head(&ssh->list); sth != NULL;
+	    sth = list_next(&ssh->list, sth)) {
+		if (sth->txg == txg) {
+			bcopy(stats, sth->sync, sizeof (sth->sync));
+			error = 0;
+			break;
+		}
+	}
+	mutex_exit(&ssh->lock);
+
+	return (error);
+}
+
 /*
  * ==========================================================================
  * SPA TX Assign Histogram Routines
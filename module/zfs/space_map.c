@@ -213,7 +213,8 @@ space_map_histogram_add(space_map_t *sm, range_tree_t *rt, dmu_tx_t *tx)
 uint64_t
 space_map_entries(space_map_t *sm, range_tree_t *rt)
 {
-	avl_tree_t *t = &rt->rt_root;
+	zfs_btree_t *t = &rt->rt_root;
+	zfs_btree_index_t where;
 	range_seg_t *rs;
 	uint64_t size, entries;
 
@@ -226,7 +227,8 @@ space_map_entries(space_map_t *sm, range_tree_t *rt)
 	 * Traverse the range tree and calculate the number of space map
 	 * entries that would be required to write out the range tree.
 	 */
-	for (rs = avl_first(t); rs != NULL; rs = AVL_NEXT(t, rs)) {
+	for (rs = zfs_btree_first(t, &where); rs != NULL;
+	    rs = zfs_btree_next(t, &where, &where)) {
 		size = (rs->rs_end - rs->rs_start) >> sm->sm_shift;
 		entries += howmany(size, SM_RUN_MAX);
 	}
@@ -242,7 +244,8 @@ space_map_write(space_map_t *sm, range_tree_t *rt, maptype_t maptype,
 {
 	objset_t *os = sm->sm_os;
 	spa_t *spa = dmu_objset_spa(os);
-	avl_tree_t *t = &rt->rt_root;
+	zfs_btree_t *t = &rt->rt_root;
+	zfs_btree_index_t where;
 	range_seg_t *rs;
 	uint64_t size, total, rt_space, nodes;
 	uint64_t *entry, *entry_map, *entry_map_end;
@@ -282,9 +285,10 @@ space_map_write(space_map_t *sm, range_tree_t *rt, maptype_t maptype,
 	    SM_DEBUG_TXG_ENCODE(dmu_tx_get_txg(tx));
 
 	total = 0;
-	nodes = avl_numnodes(&rt->rt_root);
+	nodes = zfs_btree_numnodes(&rt->rt_root);
 	rt_space = range_tree_space(rt);
-	for (rs = avl_first(t); rs != NULL; rs = AVL_NEXT(t, rs)) {
+	for (rs = zfs_btree_first(t, &where); rs != NULL;
+	    rs = zfs_btree_next(t, &where, &where)) {
 		uint64_t start;
 
 		size = (rs->rs_end - rs->rs_start) >> sm->sm_shift;
@@ -331,7 +335,7 @@ space_map_write(space_map_t *sm, range_tree_t *rt, maptype_t maptype,
 	 * Ensure that the space_map's accounting wasn't changed
 	 * while we were in the middle of writing it out.
 	 */
-	VERIFY3U(nodes, ==, avl_numnodes(&rt->rt_root));
+	VERIFY3U(nodes, ==, zfs_btree_numnodes(&rt->rt_root));
 	VERIFY3U(range_tree_space(rt), ==, rt_space);
 	VERIFY3U(range_tree_space(rt), ==, total);
 
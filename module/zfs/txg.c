@@ -730,6 +730,58 @@ txg_kick(dsl_pool_t *dp)
 	mutex_exit(&tx->tx_sync_lock);
 }
 
+/*
+ * The sync thread calls this once txg has converged, before writing its
+ * uberblock and labels.  If the sync thread will sync the open txg as soon
+ * as txg is done (someone is waiting for it, or it already holds enough
+ * dirty data; see txg_sync_thread()), start quiescing it now so that its
+ * dirty data can be written while txg commits.
+ */
+boolean_t
+txg_quiesce_early(dsl_pool_t *dp, uint64_t txg)
+{
+	tx_state_t *tx = &dp->dp_tx;
+	boolean_t quiescing = B_TRUE;
+
+	mutex_enter(&tx->tx_sync_lock);
+	ASSERT3U(tx->tx_syncing_txg, ==, txg);
+	if (tx->tx_open_txg > txg + 1 ||
+	    tx->tx_quiesce_txg_waiting > txg + 1) {
+		/* Already quiescing or quiesced */
+	} else if (tx->tx_sync_txg_waiting > txg ||
+	    dp->dp_dirty_total >= zfs_dirty_data_sync) {
+		tx->tx_quiesce_txg_waiting = txg + 2;
+		cv_broadcast(&tx->tx_quiesce_more_cv);
+	} else {
+		quiescing = B_FALSE;
+	}
+	mutex_exit(&tx->tx_sync_lock);
+
+	return (quiescing);
+}
+
+/*
+ * Wait for txg to be quiesced and handed off to the sync thread.  Returns
+ * B_FALSE if the sync thread has already started on it.  A txg which is
+ * quiesced but not yet syncing has no holders left, so its dirty state
+ * cannot change until the sync thread gets to it.
+ */
+boolean_t
+txg_wait_quiesced(dsl_pool_t *dp, uint64_t txg)
+{
+	tx_state_t *tx = &dp->dp_tx;
+	boolean_t quiesced;
+
+	mutex_enter(&tx->tx_sync_lock);
+	while (!tx->tx_exiting && tx->tx_quiesced_txg != txg &&
+	    tx->tx_syncing_txg != txg && tx->tx_synced_txg < txg)
+		cv_wait(&tx->tx_quiesce_done_cv, &tx->tx_sync_lock);
+	quiesced = (tx->tx_quiesced_txg == txg);
+	mutex_exit(&tx->tx_sync_lock);
+
+	return (quiesced);
+}
+
 boolean_t
 txg_stalled(dsl_pool_t *dp)
 {
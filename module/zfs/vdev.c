@@ -1777,7 +1777,7 @@ vdev_dtl_min(vdev_t *vd)
 	ASSERT3U(range_tree_space(vd->vdev_dtl[DTL_MISSING]), !=, 0);
 	ASSERT0(vd->vdev_children);
 
-	rs = avl_first(&vd->vdev_dtl[DTL_MISSING]->rt_root);
+	rs = zfs_btree_first(&vd->vdev_dtl[DTL_MISSING]->rt_root, NULL);
 	return (rs->rs_start - 1);
 }
 
@@ -1793,7 +1793,7 @@ vdev_dtl_max(vdev_t *vd)
 	ASSERT3U(range_tree_space(vd->vdev_dtl[DTL_MISSING]), !=, 0);
 	ASSERT0(vd->vdev_children);
 
-	rs = avl_last(&vd->vdev_dtl[DTL_MISSING]->rt_root);
+	rs = zfs_btree_last(&vd->vdev_dtl[DTL_MISSING]->rt_root, NULL);
 	return (rs->rs_end);
 }
 
@@ -53,7 +53,7 @@ int fzap_default_block_shift = 14; /* 16k blocksize */
 
 extern inline zap_phys_t *zap_f_phys(zap_t *zap);
 
-static uint64_t zap_allocate_blocks(zap_t *zap, int nblocks);
+static uint64_t zap_allocate_blocks(zap_t *zap, int nblocks, dmu_tx_t *tx);
 
 void
 fzap_byteswap(void *vbuf, size_t size)
@@ -159,7 +159,7 @@ zap_table_grow(zap_t *zap, zap_table_phys_t *tbl,
 	if (tbl->zt_nextblk != 0) {
 		newblk = tbl->zt_nextblk;
 	} else {
-		newblk = zap_allocate_blocks(zap, tbl->zt_numblks * 2);
+		newblk = zap_allocate_blocks(zap, tbl->zt_numblks * 2, tx);
 		tbl->zt_nextblk = newblk;
 		ASSERT0(tbl->zt_blks_copied);
 		dmu_prefetch(zap->zap_objset, zap->zap_object, 0,
@@ -342,7 +342,7 @@ zap_grow_ptrtbl(zap_t *zap, dmu_tx_t *tx)
 		    ZAP_EMBEDDED_PTRTBL_SHIFT(zap));
 		ASSERT0(zap_f_phys(zap)->zap_ptrtbl.zt_blk);
 
-		newblk = zap_allocate_blocks(zap, 1);
+		newblk = zap_allocate_blocks(zap, 1, tx);
 		err = dmu_buf_hold(zap->zap_objset, zap->zap_object,
 		    newblk << FZAP_BLOCK_SHIFT(zap), FTAG, &db_new,
 		    DMU_READ_NO_PREFETCH);
@@ -371,20 +371,29 @@ zap_grow_ptrtbl(zap_t *zap, dmu_tx_t *tx)
 static void
 zap_increment_num_entries(zap_t *zap, int delta, dmu_tx_t *tx)
 {
-	dmu_buf_will_dirty(zap->zap_dbuf, tx);
 	mutex_enter(&zap->zap_f.zap_num_entries_mtx);
+	dmu_buf_will_dirty(zap->zap_dbuf, tx);
 	ASSERT(delta > 0 || zap_f_phys(zap)->zap_num_entries >= -delta);
 	zap_f_phys(zap)->zap_num_entries += delta;
 	mutex_exit(&zap->zap_f.zap_num_entries_mtx);
 }
 
+/*
+ * Leafs may be split while holding zap_rwlock as reader, so block
+ * allocation is serialized by zap_num_entries_mtx rather than by the
+ * table lock.  The header is dirtied under the same mutex so that a
+ * concurrent dirty from the next txg cannot snapshot it mid-update.
+ */
 static uint64_t
-zap_allocate_blocks(zap_t *zap, int nblocks)
+zap_allocate_blocks(zap_t *zap, int nblocks, dmu_tx_t *tx)
 {
 	uint64_t newblk;
-	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+	ASSERT(RW_LOCK_HELD(&zap->zap_rwlock));
+	mutex_enter(&zap->zap_f.zap_num_entries_mtx);
+	dmu_buf_will_dirty(zap->zap_dbuf, tx);
 	newblk = zap_f_phys(zap)->zap_freeblk;
 	zap_f_phys(zap)->zap_freeblk += nblocks;
+	mutex_exit(&zap->zap_f.zap_num_entries_mtx);
 	return (newblk);
 }
 
@@ -403,11 +412,11 @@ zap_create_leaf(zap_t *zap, dmu_tx_t *tx)
 	void *winner;
 	zap_leaf_t *l = kmem_zalloc(sizeof (zap_leaf_t), KM_SLEEP);
 
-	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+	ASSERT(RW_LOCK_HELD(&zap->zap_rwlock));
 
 	rw_init(&l->l_rwlock, NULL, RW_NOLOCKDEP, NULL);
 	rw_enter(&l->l_rwlock, RW_WRITER);
-	l->l_blkid = zap_allocate_blocks(zap, 1);
+	l->l_blkid = zap_allocate_blocks(zap, 1, tx);
 	l->l_dbuf = NULL;
 
 	VERIFY(0 == dmu_buf_hold(zap->zap_objset, zap->zap_object,
@@ -420,7 +429,9 @@ zap_create_leaf(zap_t *zap, dmu_tx_t *tx)
 
 	zap_leaf_init(l, zap->zap_normflags != 0);
 
+	mutex_enter(&zap->zap_f.zap_num_entries_mtx);
 	zap_f_phys(zap)->zap_num_leafs++;
+	mutex_exit(&zap->zap_f.zap_num_entries_mtx);
 
 	return (l);
 }
@@ -562,40 +573,74 @@ zap_idx_to_blk(zap_t *zap, uint64_t idx, uint64_t *valp)
 	}
 }
 
+/*
+ * The caller must either hold zap_rwlock as writer, or hold it as
+ * reader along with the writer lock on the leaf that entry idx
+ * currently points to.  In the latter case other splitters may be
+ * storing into different entries of the same ptrtbl block, so the
+ * dirty and the store are serialized by zap_num_entries_mtx.
+ */
 static int
 zap_set_idx_to_blk(zap_t *zap, uint64_t idx, uint64_t blk, dmu_tx_t *tx)
 {
+	int err = 0;
+
 	ASSERT(tx != NULL);
-	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+	ASSERT(RW_LOCK_HELD(&zap->zap_rwlock));
 
+	mutex_enter(&zap->zap_f.zap_num_entries_mtx);
 	if (zap_f_phys(zap)->zap_ptrtbl.zt_blk == 0) {
+		dmu_buf_will_dirty(zap->zap_dbuf, tx);
 		ZAP_EMBEDDED_PTRTBL_ENT(zap, idx) = blk;
-		return (0);
 	} else {
-		return (zap_table_store(zap, &zap_f_phys(zap)->zap_ptrtbl,
-		    idx, blk, tx));
+		err = zap_table_store(zap, &zap_f_phys(zap)->zap_ptrtbl,
+		    idx, blk, tx);
 	}
+	mutex_exit(&zap->zap_f.zap_num_entries_mtx);
+
+	return (err);
 }
 
 static int
 zap_deref_leaf(zap_t *zap, uint64_t h, dmu_tx_t *tx, krw_t lt, zap_leaf_t **lp)
 {
 	uint64_t idx, blk;
+	uint64_t retries = 0;
 	int err;
 
 	ASSERT(zap->zap_dbuf == NULL ||
 	    zap_f_phys(zap) == zap->zap_dbuf->db_data);
 	ASSERT3U(zap_f_phys(zap)->zap_magic, ==, ZAP_MAGIC);
+top:
 	idx = ZAP_HASH_IDX(h, zap_f_phys(zap)->zap_ptrtbl.zt_shift);
 	err = zap_idx_to_blk(zap, idx, &blk);
 	if (err != 0)
 		return (err);
 	err = zap_get_leaf_byblk(zap, blk, tx, lt, lp);
+	if (err != 0)
+		return (err);
 
-	ASSERT(err ||
-	    ZAP_HASH_IDX(h, zap_leaf_phys(*lp)->l_hdr.lh_prefix_len) ==
-	    zap_leaf_phys(*lp)->l_hdr.lh_prefix);
-	return (err);
+	/*
+	 * Leafs are split with zap_rwlock held only as reader, so the
+	 * leaf we looked up may have been split while we waited for its
+	 * lock.  If it no longer covers our hash, the pointer table has
+	 * already been updated; look it up again.
+	 *
+	 * Every such split lengthens the prefix of the leaf covering our
+	 * hash, and no prefix can be longer than zt_shift, which does not
+	 * change while we hold zap_rwlock.  A mismatch that persists past
+	 * that many retries, or any mismatch when no split can be running,
+	 * means the pointer table is damaged.
+	 */
+	if (ZAP_HASH_IDX(h, zap_leaf_phys(*lp)->l_hdr.lh_prefix_len) !=
+	    zap_leaf_phys(*lp)->l_hdr.lh_prefix) {
+		zap_put_leaf(*lp);
+		if (RW_WRITE_HELD(&zap->zap_rwlock) ||
+		    ++retries > zap_f_phys(zap)->zap_ptrtbl.zt_shift)
+			return (SET_ERROR(EIO));
+		goto top;
+	}
+	return (0);
 }
 
 static int
@@ -614,9 +659,11 @@ zap_expand_leaf(zap_name_t *zn, zap_leaf_t *l, dmu_tx_t *tx, zap_leaf_t **lp)
 	ASSERT3U(ZAP_HASH_IDX(hash, old_prefix_len), ==,
 	    zap_leaf_phys(l)->l_hdr.lh_prefix);
 
-	if (zap_tryupgradedir(zap, tx) == 0 ||
-	    old_prefix_len == zap_f_phys(zap)->zap_ptrtbl.zt_shift) {
-		/* We failed to upgrade, or need to grow the pointer table */
+	if (old_prefix_len == zap_f_phys(zap)->zap_ptrtbl.zt_shift) {
+		/*
+		 * We need to grow the pointer table, which is the only
+		 * part of a split that requires zap_rwlock as writer.
+		 */
 		objset_t *os = zap->zap_objset;
 		uint64_t object = zap->zap_object;
 
@@ -646,7 +693,13 @@ zap_expand_leaf(zap_name_t *zn, zap_leaf_t *l, dmu_tx_t *tx, zap_leaf_t **lp)
 			return (0);
 		}
 	}
-	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+	/*
+	 * The pointer table is big enough for this split.  Holding the
+	 * leaf's writer lock gives us exclusive ownership of the sibling
+	 * pointers, so zap_rwlock may be held as reader.
+	 */
+	ASSERT(RW_LOCK_HELD(&zap->zap_rwlock));
+	ASSERT(RW_WRITE_HELD(&l->l_rwlock));
 	ASSERT3U(old_prefix_len, <, zap_f_phys(zap)->zap_ptrtbl.zt_shift);
 	ASSERT3U(ZAP_HASH_IDX(hash, old_prefix_len), ==,
 	    zap_leaf_phys(l)->l_hdr.lh_prefix);
@@ -667,6 +720,13 @@ zap_expand_leaf(zap_name_t *zn, zap_leaf_t *l, dmu_tx_t *tx, zap_leaf_t **lp)
 	nl = zap_create_leaf(zap, tx);
 	zap_leaf_split(l, nl, zap->zap_normflags != 0);
 
+	/*
+	 * Make the new leaf visible before publishing pointers to it;
+	 * lockless readers of the pointer table will immediately try
+	 * to look it up.
+	 */
+	membar_producer();
+
 	/* set sibling pointers */
 	for (i = 0; i < (1ULL << prefix_diff); i++) {
 		err = zap_set_idx_to_blk(zap, sibling+i, nl->l_blkid, tx);
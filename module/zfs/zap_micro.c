@@ -35,20 +35,104 @@
 #include <sys/avl.h>
 #include <sys/arc.h>
 #include <sys/dmu_objset.h>
+#include <sys/dsl_dataset.h>
+#include <sys/zfeature.h>
 
 #ifdef _KERNEL
 #include <sys/sunddi.h>
 #endif
 
+/*
+ * Maximum size of a microzap block before it is upgraded to a fat zap.
+ * Sizes above 128KB require the large_microzap and large_blocks
+ * features, and are capped at MZAP_LARGE_MAX_BLKSZ.
+ */
+int zap_micro_max_size = MZAP_MAX_BLKSZ;
+
+/*
+ * Hash new string-keyed ZAPs with CRC32C.  This activates the zap_crc32c
+ * feature, so it is off unless the administrator asks for it.
+ */
+int zap_hash_crc32c = 0;
+
 extern inline mzap_phys_t *zap_m_phys(zap_t *zap);
 
 static int mzap_upgrade(zap_t **zapp, dmu_tx_t *tx, zap_flags_t flags);
+static boolean_t mzap_grow(zap_t *zap, int nchunks, dmu_tx_t *tx);
+
+/*
+ * CRC32C (Castagnoli) lookup tables for slicing-by-8: zap_crc32c_table[0]
+ * is the usual byte-at-a-time table, and zap_crc32c_table[k][b] is the
+ * CRC of byte b followed by k zero bytes.
+ */
+#define	ZAP_CRC32C_POLY	0x82F63B78U
+static uint32_t zap_crc32c_table[8][256];
+
+void
+zap_init(void)
+{
+	uint32_t *ct;
+	int i, j, k;
+
+	for (i = 0; i < 256; i++) {
+		for (ct = &zap_crc32c_table[0][i], *ct = i, j = 8; j > 0; j--)
+			*ct = (*ct >> 1) ^ (-(*ct & 1) & ZAP_CRC32C_POLY);
+	}
+	for (i = 0; i < 256; i++) {
+		for (k = 1; k < 8; k++) {
+			uint32_t c = zap_crc32c_table[k - 1][i];
+			zap_crc32c_table[k][i] = (c >> 8) ^
+			    zap_crc32c_table[0][c & 0xFF];
+		}
+	}
+}
+
+/*
+ * Returns B_TRUE if new ZAP objects in this objset should be hashed with
+ * CRC32C.  Like large microzaps, this is tracked per dataset.
+ */
+static boolean_t
+zap_crc32c_ok(objset_t *os)
+{
+	return (zap_hash_crc32c != 0 && dmu_objset_ds(os) != NULL &&
+	    spa_feature_is_enabled(dmu_objset_spa(os),
+	    SPA_FEATURE_ZAP_CRC32C));
+}
+
+static uint32_t
+zap_crc32c(uint32_t crc, const uint8_t *cp, int len)
+{
+	uint32_t (*ct)[256] = zap_crc32c_table;
+
+	ASSERT3U(zap_crc32c_table[0][128], ==, ZAP_CRC32C_POLY);
+
+	/*
+	 * Consume eight bytes per iteration.  The eight table lookups are
+	 * independent of each other, unlike the byte-at-a-time loop where
+	 * every lookup depends on the previous one.
+	 */
+	for (; len >= 8; cp += 8, len -= 8) {
+		uint32_t lo = crc ^ (cp[0] | (cp[1] << 8) | (cp[2] << 16) |
+		    ((uint32_t)cp[3] << 24));
+		uint32_t hi = cp[4] | (cp[5] << 8) | (cp[6] << 16) |
+		    ((uint32_t)cp[7] << 24);
+
+		crc = ct[7][lo & 0xFF] ^ ct[6][(lo >> 8) & 0xFF] ^
+		    ct[5][(lo >> 16) & 0xFF] ^ ct[4][lo >> 24] ^
+		    ct[3][hi & 0xFF] ^ ct[2][(hi >> 8) & 0xFF] ^
+		    ct[1][(hi >> 16) & 0xFF] ^ ct[0][hi >> 24];
+	}
+	for (; len > 0; cp++, len--)
+		crc = (crc >> 8) ^ ct[0][(crc ^ *cp) & 0xFF];
+
+	return (crc);
+}
 
 uint64_t
 zap_getflags(zap_t *zap)
 {
 	if (zap->zap_ismicro)
-		return (0);
+		return (zap_m_phys(zap)->mz_flags);
 	return (zap_f_phys(zap)->zap_flags);
 }
 
@@ -79,6 +163,18 @@ zap_hash(zap_name_t *zn)
 	if (zap_getflags(zap) & ZAP_FLAG_PRE_HASHED_KEY) {
 		ASSERT(zap_getflags(zap) & ZAP_FLAG_UINT64_KEY);
 		h = *(uint64_t *)zn->zn_key_orig;
+	} else if (zap_getflags(zap) & ZAP_FLAG_HASH_CRC32C) {
+		/*
+		 * Only the top zap_hashbits() (28) bits are used, so a
+		 * single 32-bit CRC seeded from the salt is sufficient.
+		 * As with CRC64, the terminating null is not hashed.
+		 */
+		ASSERT(!(zap_getflags(zap) &
+		    (ZAP_FLAG_HASH64 | ZAP_FLAG_UINT64_KEY)));
+		ASSERT(zn->zn_key_intlen == 1);
+		h = (uint64_t)zap_crc32c((uint32_t)(zap->zap_salt ^
+		    (zap->zap_salt >> 32)), zn->zn_key_norm,
+		    zn->zn_key_norm_numints - 1) << 32;
 	} else {
 		h = zap->zap_salt;
 		ASSERT(h != 0);
@@ -157,6 +253,13 @@ zap_match(zap_name_t *zn, const char *matchname)
 	if (zn->zn_matchtype == MT_FIRST) {
 		char norm[ZAP_MAXNAMELEN];
 
+		/*
+		 * Identical names always normalize identically; only
+		 * normalize the candidate when the cached key may differ.
+		 */
+		if (strcmp(zn->zn_key_orig, matchname) == 0)
+			return (B_TRUE);
+
 		if (zap_normalize(zn->zn_zap, matchname, norm) != 0)
 			return (B_FALSE);
 
@@ -226,12 +329,17 @@ mzap_byteswap(mzap_phys_t *buf, size_t size)
 	buf->mz_block_type = BSWAP_64(buf->mz_block_type);
 	buf->mz_salt = BSWAP_64(buf->mz_salt);
 	buf->mz_normflags = BSWAP_64(buf->mz_normflags);
+	buf->mz_flags = BSWAP_64(buf->mz_flags);
 	max = (size / MZAP_ENT_LEN) - 1;
 	for (i = 0; i < max; i++) {
 		buf->mz_chunk[i].mze_value =
 		    BSWAP_64(buf->mz_chunk[i].mze_value);
 		buf->mz_chunk[i].mze_cd =
 		    BSWAP_32(buf->mz_chunk[i].mze_cd);
+		buf->mz_chunk[i].mze_chain =
+		    BSWAP_16(buf->mz_chunk[i].mze_chain);
+		/* continuation chunks hold only name bytes */
+		i += MIN(buf->mz_chunk[i].mze_chain, MZAP_MAX_CHAIN);
 	}
 }
 
@@ -342,9 +450,16 @@ mze_find_unused_cd(zap_t *zap, uint64_t hash)
 static void
 mze_remove(zap_t *zap, mzap_ent_t *mze)
 {
+	mzap_ent_phys_t *mzep = MZE_PHYS(zap, mze);
+	int nchunks = 1 + mzep->mze_chain;
+
 	ASSERT(zap->zap_ismicro);
 	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
 
+	zap->zap_m.zap_num_entries--;
+	zap->zap_m.zap_num_used -= nchunks;
+	bzero(mzep, nchunks * MZAP_ENT_LEN);
+
 	avl_remove(&zap->zap_m.zap_avl, mze);
 	kmem_free(mze, sizeof (mzap_ent_t));
 }
@@ -413,11 +528,16 @@ mzap_open(objset_t *os, uint64_t obj, dmu_buf_t *db)
 			if (mze->mze_name[0]) {
 				zap_name_t *zn;
 
+				ASSERT3U(mze->mze_chain, <=, MZAP_MAX_CHAIN);
+				ASSERT3U(i + mze->mze_chain, <,
+				    zap->zap_m.zap_num_chunks);
 				zap->zap_m.zap_num_entries++;
+				zap->zap_m.zap_num_used += 1 + mze->mze_chain;
 				zn = zap_name_alloc(zap, mze->mze_name,
 				    MT_EXACT);
 				mze_insert(zap, i, zn->zn_hash);
 				zap_name_free(zn);
+				i += mze->mze_chain;
 			}
 		}
 	} else {
@@ -447,6 +567,80 @@ mzap_open(objset_t *os, uint64_t obj, dmu_buf_t *db)
 	return (zap);
 }
 
+/*
+ * Microzaps larger than 128KB, and entries with names longer than
+ * MZAP_NAME_LEN, are only used in datasets (not the MOS) of pools with
+ * the large_microzap feature enabled.
+ */
+static boolean_t
+mzap_large_ok(objset_t *os)
+{
+	return (dmu_objset_ds(os) != NULL &&
+	    spa_feature_is_enabled(dmu_objset_spa(os),
+	    SPA_FEATURE_LARGE_MICROZAP));
+}
+
+uint64_t
+mzap_max_blksz(objset_t *os)
+{
+	uint64_t maxsz;
+
+	maxsz = P2ROUNDUP(MAX(zap_micro_max_size, SPA_MINBLOCKSIZE),
+	    SPA_MINBLOCKSIZE);
+	if (!mzap_large_ok(os))
+		return (MIN(maxsz, MZAP_MAX_BLKSZ));
+	maxsz = MIN(maxsz, spa_maxblocksize(dmu_objset_spa(os)));
+	return (MIN(maxsz, MZAP_LARGE_MAX_BLKSZ));
+}
+
+/*
+ * Mark the dataset as using the large_microzap format before we dirty
+ * a microzap block that depends on it.  A microzap block larger than
+ * 128K also needs large_blocks, so that it may be sent with 'zfs send -L'.
+ */
+static void
+mzap_activate_large(zap_t *zap, uint64_t blksz)
+{
+	dsl_dataset_t *ds = dmu_objset_ds(zap->zap_objset);
+
+	ASSERT(mzap_large_ok(zap->zap_objset));
+	dsl_dataset_need_feature(ds, SPA_FEATURE_LARGE_MICROZAP);
+	if (blksz > SPA_OLD_MAXBLOCKSIZE)
+		dsl_dataset_need_feature(ds, SPA_FEATURE_LARGE_BLOCKS);
+}
+
+/*
+ * Grow the microzap block until at least nchunks chunks are free.
+ * Returns B_FALSE if that would exceed the maximum microzap size, in
+ * which case the caller must upgrade to a fat zap instead.
+ */
+static boolean_t
+mzap_grow(zap_t *zap, int nchunks, dmu_tx_t *tx)
+{
+	dmu_buf_t *db = zap->zap_dbuf;
+	int nfree = zap->zap_m.zap_num_chunks - zap->zap_m.zap_num_used;
+	uint64_t newsz;
+
+	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+
+	if (nfree >= nchunks)
+		return (B_TRUE);
+
+	newsz = db->db_size +
+	    P2ROUNDUP((nchunks - nfree) * MZAP_ENT_LEN, SPA_MINBLOCKSIZE);
+	if (newsz > mzap_max_blksz(zap->zap_objset))
+		return (B_FALSE);
+
+	if (newsz > MZAP_MAX_BLKSZ)
+		mzap_activate_large(zap, newsz);
+	VERIFY0(dmu_object_set_blocksize(zap->zap_objset, zap->zap_object,
+	    newsz, 0, tx));
+	zap->zap_m.zap_num_chunks = db->db_size / MZAP_ENT_LEN - 1;
+	ASSERT3S(zap->zap_m.zap_num_chunks - zap->zap_m.zap_num_used, >=,
+	    nchunks);
+	return (B_TRUE);
+}
+
 int
 zap_lockdir(objset_t *os, uint64_t obj, dmu_tx_t *tx,
     krw_t lti, boolean_t fatreader, boolean_t adding, zap_t **zapp)
@@ -497,20 +691,15 @@ zap_lockdir(objset_t *os, uint64_t obj, dmu_tx_t *tx,
 	ASSERT3P(zap->zap_dbuf, ==, db);
 
 	ASSERT(!zap->zap_ismicro ||
-	    zap->zap_m.zap_num_entries <= zap->zap_m.zap_num_chunks);
+	    zap->zap_m.zap_num_used <= zap->zap_m.zap_num_chunks);
 	if (zap->zap_ismicro && tx && adding &&
-	    zap->zap_m.zap_num_entries == zap->zap_m.zap_num_chunks) {
-		uint64_t newsz = db->db_size + SPA_MINBLOCKSIZE;
-		if (newsz > MZAP_MAX_BLKSZ) {
+	    zap->zap_m.zap_num_used == zap->zap_m.zap_num_chunks) {
+		if (!mzap_grow(zap, 1, tx)) {
 			dprintf("upgrading obj %llu: num_entries=%u\n",
 			    obj, zap->zap_m.zap_num_entries);
 			*zapp = zap;
 			return (mzap_upgrade(zapp, tx, 0));
 		}
-		err = dmu_object_set_blocksize(os, obj, newsz, 0, tx);
-		ASSERT0(err);
-		zap->zap_m.zap_num_chunks =
-		    db->db_size / MZAP_ENT_LEN - 1;
 	}
 
 	*zapp = zap;
@@ -548,6 +737,9 @@ mzap_upgrade(zap_t **zapp, dmu_tx_t *tx, zap_flags_t flags)
 		}
 	}
 
+	/* A CRC32C microzap must keep its hash, or cursors would move. */
+	flags |= zap_getflags(zap);
+
 	dprintf("upgrading obj=%llu with %u chunks\n",
 	    zap->zap_object, nchunks);
 	/* XXX destroy the avl later, so we can use the stored hash value */
@@ -568,6 +760,7 @@ mzap_upgrade(zap_t **zapp, dmu_tx_t *tx, zap_flags_t flags)
 		zap_name_free(zn);
 		if (err)
 			break;
+		i += mze->mze_chain;
 	}
 	zio_buf_free(mzp, sz);
 	*zapp = zap;
@@ -596,6 +789,13 @@ mzap_create_impl(objset_t *os, uint64_t obj, int normflags, zap_flags_t flags,
 	zp->mz_block_type = ZBT_MICRO;
 	zp->mz_salt = ((uintptr_t)db ^ (uintptr_t)tx ^ (obj << 1)) | 1ULL;
 	zp->mz_normflags = normflags;
+	zp->mz_flags = 0;
+	if (!(flags & (ZAP_FLAG_HASH64 | ZAP_FLAG_UINT64_KEY)) &&
+	    zap_crc32c_ok(os)) {
+		zp->mz_flags = ZAP_FLAG_HASH_CRC32C;
+		dsl_dataset_need_feature(dmu_objset_ds(os),
+		    SPA_FEATURE_ZAP_CRC32C);
+	}
 	dmu_buf_rele(db, FTAG);
 
 	if (flags != 0) {
@@ -949,21 +1149,87 @@ zap_length_uint64(objset_t *os, uint64_t zapobj, const uint64_t *key,
 	return (err);
 }
 
+/*
+ * Return the first chunk of a run of nchunks free chunks at or after
+ * start, or -1 if there is none.  start must be at an entry boundary.
+ */
+static int
+mzap_find_free(zap_t *zap, int start, int nchunks)
+{
+	int i = start;
+	int run = 0;
+
+	while (i < zap->zap_m.zap_num_chunks) {
+		mzap_ent_phys_t *mze = &zap_m_phys(zap)->mz_chunk[i];
+
+		if (mze->mze_name[0] != 0) {
+			run = 0;
+			i += 1 + mze->mze_chain;
+			continue;
+		}
+		if (++run == nchunks)
+			return (i - nchunks + 1);
+		i++;
+	}
+	return (-1);
+}
+
+/*
+ * Slide all entries to the front of the block, so that the free chunks
+ * form one run at the end.  Only needed when a long entry can't find
+ * enough contiguous free chunks.
+ */
+static void
+mzap_compact(zap_t *zap)
+{
+	mzap_phys_t *mzp = zap_m_phys(zap);
+	int sz = zap->zap_dbuf->db_size;
+	mzap_phys_t *omzp;
+	mzap_ent_t *mze;
+	int next = 0;
+
+	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+
+	omzp = zio_buf_alloc(sz);
+	bcopy(mzp, omzp, sz);
+	bzero(mzp->mz_chunk, zap->zap_m.zap_num_chunks * MZAP_ENT_LEN);
+
+	for (mze = avl_first(&zap->zap_m.zap_avl); mze != NULL;
+	    mze = AVL_NEXT(&zap->zap_m.zap_avl, mze)) {
+		mzap_ent_phys_t *omze = &omzp->mz_chunk[mze->mze_chunkid];
+		int nchunks = 1 + omze->mze_chain;
+
+		bcopy(omze, &mzp->mz_chunk[next], nchunks * MZAP_ENT_LEN);
+		mze->mze_chunkid = next;
+		next += nchunks;
+	}
+	ASSERT3S(next, ==, zap->zap_m.zap_num_used);
+	zap->zap_m.zap_alloc_next = next;
+
+	zio_buf_free(omzp, sz);
+}
+
 static void
 mzap_addent(zap_name_t *zn, uint64_t value)
 {
 	int i;
 	zap_t *zap = zn->zn_zap;
 	int start = zap->zap_m.zap_alloc_next;
+	int len = zn->zn_key_orig_numints;
+	int chain = MZE_CHAIN_FOR_LEN(len);
+	mzap_ent_phys_t *mze;
 	uint32_t cd;
 
 	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+	ASSERT3S(chain, <=, MZAP_MAX_CHAIN);
+	ASSERT3S(zap->zap_m.zap_num_chunks - zap->zap_m.zap_num_used, >,
+	    chain);
 
 #ifdef ZFS_DEBUG
 	for (i = 0; i < zap->zap_m.zap_num_chunks; i++) {
-		ASSERTV(mzap_ent_phys_t *mze);
-		ASSERT(mze = &zap_m_phys(zap)->mz_chunk[i]);
-		ASSERT(strcmp(zn->zn_key_orig, mze->mze_name) != 0);
+		mzap_ent_phys_t *mzep = &zap_m_phys(zap)->mz_chunk[i];
+		ASSERT(strcmp(zn->zn_key_orig, mzep->mze_name) != 0);
+		i += mzep->mze_chain;
 	}
 #endif
 
@@ -971,27 +1237,51 @@ mzap_addent(zap_name_t *zn, uint64_t value)
 	/* given the limited size of the microzap, this can't happen */
 	ASSERT(cd < zap_maxcd(zap));
 
-again:
-	for (i = start; i < zap->zap_m.zap_num_chunks; i++) {
-		mzap_ent_phys_t *mze = &zap_m_phys(zap)->mz_chunk[i];
-		if (mze->mze_name[0] == 0) {
-			mze->mze_value = value;
-			mze->mze_cd = cd;
-			(void) strcpy(mze->mze_name, zn->zn_key_orig);
-			zap->zap_m.zap_num_entries++;
-			zap->zap_m.zap_alloc_next = i+1;
-			if (zap->zap_m.zap_alloc_next ==
-			    zap->zap_m.zap_num_chunks)
-				zap->zap_m.zap_alloc_next = 0;
-			mze_insert(zap, i, zn->zn_hash);
-			return;
-		}
-	}
-	if (start != 0) {
-		start = 0;
-		goto again;
+	i = mzap_find_free(zap, start, 1 + chain);
+	if (i == -1 && start != 0)
+		i = mzap_find_free(zap, 0, 1 + chain);
+	if (i == -1) {
+		mzap_compact(zap);
+		i = mzap_find_free(zap, zap->zap_m.zap_alloc_next, 1 + chain);
 	}
-	cmn_err(CE_PANIC, "out of entries!");
+	if (i == -1)
+		cmn_err(CE_PANIC, "out of entries!");
+
+	mze = &zap_m_phys(zap)->mz_chunk[i];
+	mze->mze_value = value;
+	mze->mze_cd = cd;
+	mze->mze_chain = chain;
+	bcopy(zn->zn_key_orig, mze->mze_name, len);
+	zap->zap_m.zap_num_entries++;
+	zap->zap_m.zap_num_used += 1 + chain;
+	zap->zap_m.zap_alloc_next = i + 1 + chain;
+	if (zap->zap_m.zap_alloc_next == zap->zap_m.zap_num_chunks)
+		zap->zap_m.zap_alloc_next = 0;
+	mze_insert(zap, i, zn->zn_hash);
+}
+
+/*
+ * Check whether an entry named zn can be added to this microzap,
+ * growing the block to make room for a long name if needed.  Returns
+ * B_FALSE if the microzap must be upgraded to a fat zap first.
+ */
+static boolean_t
+mzap_make_room(zap_name_t *zn, dmu_tx_t *tx)
+{
+	zap_t *zap = zn->zn_zap;
+	int len = zn->zn_key_orig_numints;
+
+	if (len <= MZAP_NAME_LEN)
+		return (B_TRUE);
+	if (len > ZAP_MAXNAMELEN || !mzap_large_ok(zap->zap_objset))
+		return (B_FALSE);
+	if (mze_find(zn) != NULL)
+		return (B_TRUE);
+	if (!mzap_grow(zap, 1 + MZE_CHAIN_FOR_LEN(len), tx))
+		return (B_FALSE);
+
+	mzap_activate_large(zap, zap->zap_dbuf->db_size);
+	return (B_TRUE);
 }
 
 int
@@ -1017,7 +1307,7 @@ zap_add(objset_t *os, uint64_t zapobj, const char *key,
 		err = fzap_add(zn, integer_size, num_integers, val, tx);
 		zap = zn->zn_zap;	/* fzap_add() may change zap */
 	} else if (integer_size != 8 || num_integers != 1 ||
-	    strlen(key) >= MZAP_NAME_LEN) {
+	    !mzap_make_room(zn, tx)) {
 		err = mzap_upgrade(&zn->zn_zap, tx, 0);
 		if (err == 0)
 			err = fzap_add(zn, integer_size, num_integers, val, tx);
@@ -1095,7 +1385,7 @@ zap_update(objset_t *os, uint64_t zapobj, const char *name,
 		err = fzap_update(zn, integer_size, num_integers, val, tx);
 		zap = zn->zn_zap;	/* fzap_update() may change zap */
 	} else if (integer_size != 8 || num_integers != 1 ||
-	    strlen(name) >= MZAP_NAME_LEN) {
+	    !mzap_make_room(zn, tx)) {
 		dprintf("upgrading obj %llu: intsz=%u numint=%llu name=%s\n",
 		    zapobj, integer_size, num_integers, name);
 		err = mzap_upgrade(&zn->zn_zap, tx, 0);
@@ -1174,9 +1464,6 @@ zap_remove_norm(objset_t *os, uint64_t zapobj, const char *name,
 		if (mze == NULL) {
 			err = SET_ERROR(ENOENT);
 		} else {
-			zap->zap_m.zap_num_entries--;
-			bzero(&zap_m_phys(zap)->mz_chunk[mze->mze_chunkid],
-			    sizeof (mzap_ent_phys_t));
 			mze_remove(zap, mze);
 		}
 	}
@@ -1424,10 +1711,12 @@ zap_count_write(objset_t *os, uint64_t zapobj, const char *name, int add,
 		 * 4 new blocks written : 2 new split leaf, 2 grown
 		 *			ptrtbl blocks
 		 */
+		uint64_t maxsz = mzap_max_blksz(os);
+
 		if (dmu_buf_freeable(zap->zap_dbuf))
-			*tooverwrite += MZAP_MAX_BLKSZ;
+			*tooverwrite += maxsz;
 		else
-			*towrite += MZAP_MAX_BLKSZ;
+			*towrite += maxsz;
 
 		if (add) {
 			*towrite += 4 * MZAP_MAX_BLKSZ;
@@ -1479,4 +1768,10 @@ EXPORT_SYMBOL(zap_cursor_advance);
 EXPORT_SYMBOL(zap_cursor_serialize);
 EXPORT_SYMBOL(zap_cursor_init_serialized);
 EXPORT_SYMBOL(zap_get_stats);
+
+module_param(zap_micro_max_size, int, 0644);
+MODULE_PARM_DESC(zap_micro_max_size, "Maximum micro ZAP size in bytes");
+
+module_param(zap_hash_crc32c, int, 0644);
+MODULE_PARM_DESC(zap_hash_crc32c, "Hash new ZAP objects with CRC32C");
 #endif
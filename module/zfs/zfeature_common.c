@@ -242,4 +242,26 @@ zpool_feature_init(void)
 	    "Support for blocks larger than 128KB.",
 	    ZFEATURE_FLAG_PER_DATASET, large_blocks_deps);
 	}
+
+	{
+	static const spa_feature_t large_microzap_deps[] = {
+		SPA_FEATURE_EXTENSIBLE_DATASET,
+		SPA_FEATURE_NONE
+	};
+	zfeature_register(SPA_FEATURE_LARGE_MICROZAP,
+	    "org.zfsonlinux:large_microzap", "large_microzap",
+	    "Microzaps with long names and blocks larger than 128KB.",
+	    ZFEATURE_FLAG_PER_DATASET, large_microzap_deps);
+	}
+
+	{
+	static const spa_feature_t zap_crc32c_deps[] = {
+		SPA_FEATURE_EXTENSIBLE_DATASET,
+		SPA_FEATURE_NONE
+	};
+	zfeature_register(SPA_FEATURE_ZAP_CRC32C,
+	    "org.zfsonlinux:zap_crc32c", "zap_crc32c",
+	    "ZAP objects hashed with CRC32C.",
+	    ZFEATURE_FLAG_PER_DATASET, zap_crc32c_deps);
+	}
 }
@@ -199,6 +199,7 @@ extern void zfs_init(void);
 extern void zfs_fini(void);
 
 uint_t zfs_fsyncer_key;
+uint_t zfs_replay_eof_key;
 extern uint_t rrw_tsd_key;
 static uint_t zfs_allow_log_key;
 
@@ -6020,6 +6021,7 @@ _init(void)
 		goto out;
 
 	tsd_create(&zfs_fsyncer_key, NULL);
+	tsd_create(&zfs_replay_eof_key, NULL);
 	tsd_create(&rrw_tsd_key, rrw_tsd_destroy);
 	tsd_create(&zfs_allow_log_key, zfs_allow_log_destroy);
 
@@ -6053,6 +6055,7 @@ _fini(void)
 	zvol_fini();
 
 	tsd_destroy(&zfs_fsyncer_key);
+	tsd_destroy(&zfs_replay_eof_key);
 	tsd_destroy(&rrw_tsd_key);
 	tsd_destroy(&zfs_allow_log_key);
 
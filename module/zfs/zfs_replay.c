@@ -657,11 +657,10 @@ zfs_replay_write(zfs_sb_t *zsb, lr_write_t *lr, boolean_t byteswap)
 	 * write needs to be there. So we write the whole block and
 	 * reduce the eof. This needs to be done within the single dmu
 	 * transaction created within vn_rdwr -> zfs_write. So a possible
-	 * new end of file is passed through in zsb->z_replay_eof
+	 * new end of file is passed through zfs_replay_eof_key, which is
+	 * per thread as writes to different files may be replayed at once.
 	 */
 
-	zsb->z_replay_eof = 0; /* 0 means don't change end of file */
-
 	/* If it's a dmu_sync() block, write the whole block */
 	if (lr->lr_common.lrc_reclen == sizeof (lr_write_t)) {
 		uint64_t blocksize = BP_GET_LSIZE(&lr->lr_blkptr);
@@ -670,7 +669,7 @@ zfs_replay_write(zfs_sb_t *zsb, lr_write_t *lr, boolean_t byteswap)
 			length = blocksize;
 		}
 		if (zp->z_size < eod)
-			zsb->z_replay_eof = eod;
+			(void) tsd_set(zfs_replay_eof_key, &eod);
 	}
 
 	written = zpl_write_common(ZTOI(zp), data, length, &offset,
@@ -681,7 +680,7 @@ zfs_replay_write(zfs_sb_t *zsb, lr_write_t *lr, boolean_t byteswap)
 		error = SET_ERROR(EIO); /* short write */
 
 	iput(ZTOI(zp));
-	zsb->z_replay_eof = 0;	/* safety */
+	(void) tsd_set(zfs_replay_eof_key, NULL);
 
 	return (error);
 }
@@ -788,6 +788,7 @@ zfs_sb_create(const char *osname, zfs_mntopts_t *zmo, zfs_sb_t **zsbp)
 
 	mutex_init(&zsb->z_znodes_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&zsb->z_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zsb->z_async_reads_cv, NULL, CV_DEFAULT, NULL);
 	list_create(&zsb->z_all_znodes, sizeof (znode_t),
 	    offsetof(znode_t, z_link_node));
 	rrm_init(&zsb->z_teardown_lock, B_FALSE);
@@ -908,6 +909,7 @@ zfs_sb_free(zfs_sb_t *zsb)
 
 	mutex_destroy(&zsb->z_znodes_lock);
 	mutex_destroy(&zsb->z_lock);
+	cv_destroy(&zsb->z_async_reads_cv);
 	list_destroy(&zsb->z_all_znodes);
 	rrm_destroy(&zsb->z_teardown_lock);
 	rw_destroy(&zsb->z_teardown_inactive_lock);
@@ -1201,6 +1203,16 @@ zfs_sb_teardown(zfs_sb_t *zsb, boolean_t unmounting)
 
 	rrm_enter(&zsb->z_teardown_lock, RW_WRITER, FTAG);
 
+	/*
+	 * Reads issued by zfs_read_async() keep their range locks and dbuf
+	 * holds past its ZFS_EXIT until they complete.  No more can start
+	 * now that we hold z_teardown_lock as writer, so wait for them.
+	 */
+	mutex_enter(&zsb->z_lock);
+	while (zsb->z_async_reads != 0)
+		cv_wait(&zsb->z_async_reads_cv, &zsb->z_lock);
+	mutex_exit(&zsb->z_lock);
+
 	if (!unmounting) {
 		/*
 		 * We purge the parent filesystem's super block as the
@@ -1777,6 +1789,7 @@ zfs_init(void)
 {
 	zfsctl_init();
 	zfs_znode_init();
+	zpl_file_init();
 	dmu_objset_register_type(DMU_OST_ZFS, zfs_space_delta_cb);
 	register_filesystem(&zpl_fs_type);
 }
@@ -1786,6 +1799,7 @@ zfs_fini(void)
 {
 	taskq_wait_outstanding(system_taskq, 0);
 	unregister_filesystem(&zpl_fs_type);
+	zpl_file_fini();
 	zfs_znode_fini();
 	zfsctl_fini();
 }
@@ -419,6 +419,8 @@ mappedread(struct inode *ip, int nbytes, uio_t *uio)
 
 unsigned long zfs_read_chunk_size = 1024 * 1024; /* Tunable */
 unsigned long zfs_delete_blocks = DMU_MAX_DELETEBLKCNT;
+int zfs_aio_async = 1; /* Tunable */
+unsigned long zfs_write_batch_size = 1024 * 1024; /* Tunable */
 
 /*
  * Read bytes from specified file into supplied buffer.
@@ -480,6 +482,15 @@ zfs_read(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 	if (ioflag & FRSYNC || zsb->z_os->os_sync == ZFS_SYNC_ALWAYS)
 		zil_commit(zsb->z_log, zp->z_id);
 
+	/*
+	 * Apply the dataset's read rate limits before locking anything.
+	 */
+	error = dmu_objset_rate_limit(zsb->z_os, B_FALSE, uio->uio_resid);
+	if (error != 0) {
+		ZFS_EXIT(zsb);
+		return (error);
+	}
+
 	/*
 	 * Lock the range against changes.
 	 */
@@ -556,6 +567,153 @@ out:
 }
 EXPORT_SYMBOL(zfs_read);
 
+typedef struct zfs_read_async_arg {
+	zfs_sb_t	*zra_zsb;
+	uio_t		*zra_uio;
+	rl_t		*zra_rl;
+	ssize_t		zra_n;
+	zfs_read_done_t	*zra_done;
+	void		*zra_arg;
+} zfs_read_async_arg_t;
+
+/*
+ * Drop the count taken by zfs_read_async() once a read has released
+ * everything it held, so that zfs_sb_teardown() may go ahead.
+ */
+static void
+zfs_read_async_exit(zfs_sb_t *zsb)
+{
+	mutex_enter(&zsb->z_lock);
+	if (--zsb->z_async_reads == 0)
+		cv_broadcast(&zsb->z_async_reads_cv);
+	mutex_exit(&zsb->z_lock);
+}
+
+static void
+zfs_read_async_done(void *arg, dmu_buf_t **dbp, int numbufs, int error)
+{
+	zfs_read_async_arg_t *zra = arg;
+	zfs_sb_t *zsb = zra->zra_zsb;
+	uio_t *uio = zra->zra_uio;
+	ssize_t resid = uio->uio_resid;
+
+	if (error == 0)
+		error = dmu_read_uio_bufs(dbp, numbufs, uio, zra->zra_n);
+	dmu_buf_rele_array(dbp, numbufs, zra);
+
+	/* convert checksum errors into IO errors */
+	if (error == ECKSUM)
+		error = SET_ERROR(EIO);
+
+	zfs_range_unlock(zra->zra_rl);
+	zra->zra_done(zra->zra_arg, resid - uio->uio_resid, error);
+	kmem_free(zra, sizeof (zfs_read_async_arg_t));
+	zfs_read_async_exit(zsb);
+}
+
+/*
+ * Read bytes from specified file without waiting for the i/o.
+ *
+ *	IN:	ip	- inode of file to be read from.
+ *		uio	- structure supplying read location, range info,
+ *			  and return buffer, which must remain valid (and
+ *			  be accessible from any context) until done().
+ *		ioflag	- FSYNC flags; used to provide FRSYNC semantics.
+ *		cr	- credentials of caller.
+ *		done	- called with the byte count or error once the
+ *			  read completes, possibly before we return.
+ *
+ *	RETURN:	0 if done() will be called, ENOTSUP if the read must be
+ *		done with zfs_read() instead, or an error code.
+ */
+/* ARGSUSED */
+int
+zfs_read_async(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr,
+    zfs_read_done_t *done, void *arg)
+{
+	znode_t		*zp = ITOZ(ip);
+	zfs_sb_t	*zsb = ITOZSB(ip);
+	zfs_read_async_arg_t *zra;
+	ssize_t		n;
+	int		error;
+	rl_t		*rl;
+
+	ZFS_ENTER(zsb);
+	ZFS_VERIFY_ZP(zp);
+
+	if (zp->z_pflags & ZFS_AV_QUARANTINED) {
+		ZFS_EXIT(zsb);
+		return (SET_ERROR(EACCES));
+	}
+
+	if (uio->uio_loffset < (offset_t)0) {
+		ZFS_EXIT(zsb);
+		return (SET_ERROR(EINVAL));
+	}
+
+	/*
+	 * Mapped files may have newer data in the page cache, which only
+	 * mappedread() knows how to find.  Very large reads are split up by
+	 * zfs_read().
+	 */
+	if (!zfs_aio_async || uio->uio_resid == 0 ||
+	    uio->uio_resid > DMU_MAX_ACCESS >> 1 ||
+	    (zp->z_is_mapped && !(ioflag & O_DIRECT))) {
+		ZFS_EXIT(zsb);
+		return (SET_ERROR(ENOTSUP));
+	}
+
+	if (ioflag & FRSYNC || zsb->z_os->os_sync == ZFS_SYNC_ALWAYS)
+		zil_commit(zsb->z_log, zp->z_id);
+
+	error = dmu_objset_rate_limit(zsb->z_os, B_FALSE, uio->uio_resid);
+	if (error != 0) {
+		ZFS_EXIT(zsb);
+		return (error);
+	}
+
+	rl = zfs_range_lock(zp, uio->uio_loffset, uio->uio_resid, RL_READER);
+
+	if (uio->uio_loffset >= zp->z_size) {
+		zfs_range_unlock(rl);
+		ZFS_EXIT(zsb);
+		done(arg, 0, 0);
+		return (0);
+	}
+
+	n = MIN(uio->uio_resid, zp->z_size - uio->uio_loffset);
+
+	zra = kmem_alloc(sizeof (zfs_read_async_arg_t), KM_SLEEP);
+	zra->zra_zsb = zsb;
+	zra->zra_uio = uio;
+	zra->zra_rl = rl;
+	zra->zra_n = n;
+	zra->zra_done = done;
+	zra->zra_arg = arg;
+
+	/*
+	 * The completion may run after ZFS_EXIT below, so it is counted
+	 * here to hold off zfs_sb_teardown() until it has finished.
+	 */
+	mutex_enter(&zsb->z_lock);
+	zsb->z_async_reads++;
+	mutex_exit(&zsb->z_lock);
+
+	error = dmu_read_async_dbuf(sa_get_db(zp->z_sa_hdl), uio->uio_loffset,
+	    n, DMU_READ_PREFETCH, zfs_read_async_done, zra);
+	if (error) {
+		zfs_range_unlock(rl);
+		kmem_free(zra, sizeof (zfs_read_async_arg_t));
+		zfs_read_async_exit(zsb);
+		if (error == ECKSUM)
+			error = SET_ERROR(EIO);
+	}
+
+	ZFS_EXIT(zsb);
+	return (error);
+}
+EXPORT_SYMBOL(zfs_read_async);
+
 /*
  * Write the bytes to a file.
  *
@@ -584,6 +742,7 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 	ssize_t		start_resid = uio->uio_resid;
 	ssize_t		tx_bytes;
 	uint64_t	end_size;
+	uint64_t	*eofp;
 	dmu_tx_t	*tx;
 	zfs_sb_t	*zsb = ZTOZSB(zp);
 	zilog_t		*zilog;
@@ -591,6 +750,7 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 	ssize_t		n, nbytes;
 	rl_t		*rl;
 	int		max_blksz = zsb->z_max_blksz;
+	ssize_t		wchunk;
 	int		error = 0;
 	arc_buf_t	*abuf;
 	const iovec_t	*aiov = NULL;
@@ -652,6 +812,24 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		return (SET_ERROR(EINVAL));
 	}
 
+	/*
+	 * Apply the dataset's write rate limits before locking anything.
+	 * Replayed writes were already limited when they were first made.
+	 */
+	if (!zsb->z_replay &&
+	    (error = dmu_objset_rate_limit(zsb->z_os, B_TRUE, n)) != 0) {
+		ZFS_EXIT(zsb);
+		return (error);
+	}
+
+	/*
+	 * Copied data is written up to zfs_write_batch_size bytes per tx,
+	 * so that a pwritev() of many small iovecs or a large unaligned
+	 * write doesn't pay for a tx assignment per block.
+	 */
+	wchunk = MIN(zfs_write_batch_size, DMU_MAX_ACCESS >> 1);
+	wchunk = MAX(P2ALIGN(wchunk, (ssize_t)max_blksz), max_blksz);
+
 	/*
 	 * Pre-fault the pages to ensure slow (eg NFS) pages
 	 * don't hold up txg.
@@ -663,7 +841,7 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		xuio = (xuio_t *)uio;
 	else
 #endif
-		uio_prefaultpages(MIN(n, max_blksz), uio);
+		uio_prefaultpages(MIN(n, wchunk), uio);
 
 	/*
 	 * If in append mode, set the io offset pointer to eof.
@@ -758,12 +936,21 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			ASSERT(cbytes == max_blksz);
 		}
 
+		/*
+		 * Loaned buffers are written one block per tx, as is the
+		 * first chunk when the block size may still have to grow.
+		 */
+		if (abuf == NULL && rl->r_len != UINT64_MAX)
+			nbytes = MIN(n, wchunk - P2PHASE(woff, wchunk));
+		else
+			nbytes = MIN(n, max_blksz - P2PHASE(woff, max_blksz));
+
 		/*
 		 * Start a transaction.
 		 */
 		tx = dmu_tx_create(zsb->z_os);
 		dmu_tx_hold_sa(tx, zp->z_sa_hdl, B_FALSE);
-		dmu_tx_hold_write(tx, zp->z_id, woff, MIN(n, max_blksz));
+		dmu_tx_hold_write(tx, zp->z_id, woff, nbytes);
 		zfs_sa_upgrade_txholds(tx, zp);
 		error = dmu_tx_assign(tx, TXG_WAIT);
 		if (error) {
@@ -798,12 +985,6 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			zfs_range_reduce(rl, woff, n);
 		}
 
-		/*
-		 * XXX - should we really limit each write to z_max_blksz?
-		 * Perhaps we should use SPA_MAXBLOCKSIZE chunks?
-		 */
-		nbytes = MIN(n, max_blksz - P2PHASE(woff, max_blksz));
-
 		if (abuf == NULL) {
 			tx_bytes = uio->uio_resid;
 			error = dmu_write_uio_dbuf(sa_get_db(zp->z_sa_hdl),
@@ -886,12 +1067,14 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			ASSERT(error == 0);
 		}
 		/*
-		 * If we are replaying and eof is non zero then force
-		 * the file size to the specified eof. Note, there's no
-		 * concurrency during replay.
+		 * If we are replaying and an eof was given then force
+		 * the file size to the specified eof.  The eof is per
+		 * thread since writes to different files are replayed
+		 * concurrently.
 		 */
-		if (zsb->z_replay && zsb->z_replay_eof != 0)
-			zp->z_size = zsb->z_replay_eof;
+		if (zsb->z_replay &&
+		    (eofp = tsd_get(zfs_replay_eof_key)) != NULL)
+			zp->z_size = *eofp;
 
 		error = sa_bulk_update(zp->z_sa_hdl, bulk, count, tx);
 
@@ -905,7 +1088,7 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		n -= nbytes;
 
 		if (!xuio && n > 0)
-			uio_prefaultpages(MIN(n, max_blksz), uio);
+			uio_prefaultpages(MIN(n, wchunk), uio);
 	}
 
 	zfs_inode_update(zp);
@@ -4755,4 +4938,8 @@ module_param(zfs_delete_blocks, ulong, 0644);
 MODULE_PARM_DESC(zfs_delete_blocks, "Delete files larger than N blocks async");
 module_param(zfs_read_chunk_size, long, 0644);
 MODULE_PARM_DESC(zfs_read_chunk_size, "Bytes to read per chunk");
+module_param(zfs_aio_async, int, 0644);
+MODULE_PARM_DESC(zfs_aio_async, "Complete AIO reads and sync writes async");
+module_param(zfs_write_batch_size, ulong, 0644);
+MODULE_PARM_DESC(zfs_write_batch_size, "Bytes to write per transaction");
 #endif
@@ -525,7 +525,9 @@ zfs_inode_update_impl(znode_t *zp, boolean_t new)
 	struct inode	*ip;
 	uint32_t	blksize;
 	u_longlong_t	i_blocks;
-	uint64_t	atime[2], mtime[2], ctime[2];
+	sa_bulk_attr_t	bulk[3];
+	int		count = 0;
+	int		error, i;
 
 	ASSERT(zp != NULL);
 	zsb = ZTOZSB(zp);
@@ -535,12 +537,26 @@ zfs_inode_update_impl(znode_t *zp, boolean_t new)
 	if (zfsctl_is_node(ip))
 		return;
 
-	sa_lookup(zp->z_sa_hdl, SA_ZPL_ATIME(zsb), &atime, 16);
-	sa_lookup(zp->z_sa_hdl, SA_ZPL_MTIME(zsb), &mtime, 16);
-	sa_lookup(zp->z_sa_hdl, SA_ZPL_CTIME(zsb), &ctime, 16);
+	/*
+	 * This runs for every inode instantiation and after every write,
+	 * so decode the timestamps in place from the bonus buffer under a
+	 * single handle lock rather than copying each one out.
+	 */
+	SA_ADD_BULK_ATTR_PTR(bulk, count, SA_ZPL_ATIME(zsb));
+	SA_ADD_BULK_ATTR_PTR(bulk, count, SA_ZPL_MTIME(zsb));
+	SA_ADD_BULK_ATTR_PTR(bulk, count, SA_ZPL_CTIME(zsb));
 
 	dmu_object_size_from_db(sa_get_db(zp->z_sa_hdl), &blksize, &i_blocks);
 
+	sa_handle_lock(zp->z_sa_hdl);
+	error = sa_bulk_lookup_locked(zp->z_sa_hdl, bulk, count);
+
+	/* A damaged layout could give us a timestamp of the wrong size. */
+	for (i = 0; error == 0 && i < count; i++) {
+		if (SA_BULK_ATTR_SIZE(bulk, i) != sizeof (uint64_t) * 2)
+			error = SET_ERROR(EIO);
+	}
+
 	spin_lock(&ip->i_lock);
 	ip->i_uid = SUID_TO_KUID(zp->z_uid);
 	ip->i_gid = SGID_TO_KGID(zp->z_gid);
@@ -554,13 +570,19 @@ zfs_inode_update_impl(znode_t *zp, boolean_t new)
 	 * Only read atime from SA if we are newly created inode (or rezget),
 	 * otherwise i_atime might be dirty.
 	 */
-	if (new)
-		ZFS_TIME_DECODE(&ip->i_atime, atime);
-	ZFS_TIME_DECODE(&ip->i_mtime, mtime);
-	ZFS_TIME_DECODE(&ip->i_ctime, ctime);
+	if (error == 0) {
+		if (new)
+			ZFS_TIME_DECODE(&ip->i_atime,
+			    (uint64_t *)SA_BULK_ATTR_ADDR(bulk, 0));
+		ZFS_TIME_DECODE(&ip->i_mtime,
+		    (uint64_t *)SA_BULK_ATTR_ADDR(bulk, 1));
+		ZFS_TIME_DECODE(&ip->i_ctime,
+		    (uint64_t *)SA_BULK_ATTR_ADDR(bulk, 2));
+	}
 
 	i_size_write(ip, zp->z_size);
 	spin_unlock(&ip->i_lock);
+	sa_handle_unlock(zp->z_sa_hdl);
 }
 
 static void
@@ -84,6 +84,12 @@ zil_stats_t zil_stats = {
 	{ "zil_itx_metaslab_normal_bytes",	KSTAT_DATA_UINT64 },
 	{ "zil_itx_metaslab_slog_count",	KSTAT_DATA_UINT64 },
 	{ "zil_itx_metaslab_slog_bytes",	KSTAT_DATA_UINT64 },
+	{ "zil_replay_count",			KSTAT_DATA_UINT64 },
+	{ "zil_replay_records",			KSTAT_DATA_UINT64 },
+	{ "zil_replay_bytes",			KSTAT_DATA_UINT64 },
+	{ "zil_replay_time_ms",			KSTAT_DATA_UINT64 },
+	{ "zil_claim_count",			KSTAT_DATA_UINT64 },
+	{ "zil_claim_time_ms",			KSTAT_DATA_UINT64 },
 };
 
 static kstat_t *zil_ksp;
@@ -93,6 +99,16 @@ static kstat_t *zil_ksp;
  */
 int zil_replay_disable = 0;
 
+/*
+ * Number of threads used to replay TX_WRITE records within a dataset, and
+ * the most log record and write data bytes they may have outstanding.
+ * Writes are spread across the threads by object, so the writes to each
+ * object are still replayed in log order.  Setting zil_replay_threads to
+ * 1 replays every record on the calling thread.
+ */
+int zil_replay_threads = 4;
+unsigned long zil_replay_max_inflight = 64 * 1024 * 1024;
+
 /*
  * Tunable parameter for debugging or performance analysis.  Setting
  * zfs_nocacheflush will cause corruption on power loss if a volatile
@@ -272,6 +288,62 @@ zil_read_log_block(zilog_t *zilog, const blkptr_t *bp, blkptr_t *nbp, void *dst,
 	return (error);
 }
 
+/*
+ * Start reading a log block into the ARC without waiting for it.  The next
+ * block of a chain is only known once the current one has been read, so
+ * this is issued as soon as its address is known and overlaps the read
+ * with the processing of the records in the current block.
+ */
+static void
+zil_prefetch_log_block(zilog_t *zilog, const blkptr_t *bp)
+{
+	arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH;
+	zbookmark_phys_t zb;
+
+	SET_BOOKMARK(&zb, bp->blk_cksum.zc_word[ZIL_ZC_OBJSET],
+	    ZB_ZIL_OBJECT, ZB_ZIL_LEVEL, bp->blk_cksum.zc_word[ZIL_ZC_SEQ]);
+
+	(void) arc_read(NULL, zilog->zl_spa, bp, NULL, NULL,
+	    ZIO_PRIORITY_ASYNC_READ, ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE,
+	    &aflags, &zb);
+}
+
+/*
+ * Start reading the TX_WRITE data blocks referenced by the records of a
+ * log block which were born in or after txg.  These are the blocks which
+ * zil_claim_log_record() reads to verify them, so claiming a log issues
+ * all of a block's data reads at once rather than one at a time.
+ */
+static void
+zil_prefetch_log_data(zilog_t *zilog, char *lrbuf, char *end,
+    uint64_t claim_lr_seq, uint64_t txg)
+{
+	char *lrp;
+	int reclen;
+
+	for (lrp = lrbuf; lrp < end; lrp += reclen) {
+		lr_write_t *lr = (lr_write_t *)lrp;
+		const blkptr_t *bp = &lr->lr_blkptr;
+		arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH;
+		zbookmark_phys_t zb;
+
+		reclen = lr->lr_common.lrc_reclen;
+		if (lr->lr_common.lrc_seq > claim_lr_seq)
+			break;
+		if (lr->lr_common.lrc_txtype != TX_WRITE ||
+		    reclen < sizeof (lr_write_t) || BP_IS_HOLE(bp) ||
+		    bp->blk_birth < txg)
+			continue;
+
+		SET_BOOKMARK(&zb, dmu_objset_id(zilog->zl_os), lr->lr_foid,
+		    ZB_ZIL_LEVEL, lr->lr_offset / BP_GET_LSIZE(bp));
+
+		(void) arc_read(NULL, zilog->zl_spa, bp, NULL, NULL,
+		    ZIO_PRIORITY_ASYNC_READ,
+		    ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE, &aflags, &zb);
+	}
+}
+
 /*
  * Read a TX_WRITE log data block.
  */
@@ -368,6 +440,11 @@ zil_parse(zilog_t *zilog, zil_parse_blk_func_t *parse_blk_func,
 		if (error != 0)
 			break;
 
+		if (!BP_IS_HOLE(&next_blk) &&
+		    next_blk.blk_cksum.zc_word[ZIL_ZC_SEQ] <= claim_blk_seq)
+			zil_prefetch_log_block(zilog, &next_blk);
+		zil_prefetch_log_data(zilog, lrbuf, end, claim_lr_seq, txg);
+
 		for (lrp = lrbuf; lrp < end; lrp += reclen) {
 			lr_t *lr = (lr_t *)lrp;
 			reclen = lr->lrc_reclen;
@@ -667,6 +744,7 @@ zil_claim(dsl_pool_t *dp, dsl_dataset_t *ds, void *txarg)
 	zilog_t *zilog;
 	zil_header_t *zh;
 	objset_t *os;
+	hrtime_t delta;
 	int error;
 
 	error = dmu_objset_own_obj(dp, ds->ds_object,
@@ -705,8 +783,24 @@ zil_claim(dsl_pool_t *dp, dsl_dataset_t *ds, void *txarg)
 	 */
 	ASSERT3U(zh->zh_claim_txg, <=, first_txg);
 	if (zh->zh_claim_txg == 0 && !BP_IS_HOLE(&zh->zh_log)) {
+		hrtime_t start = gethrtime();
+		char *name;
+
 		(void) zil_parse(zilog, zil_claim_log_block,
 		    zil_claim_log_record, tx, first_txg);
+
+		delta = gethrtime() - start;
+		ZIL_STAT_BUMP(zil_claim_count);
+		ZIL_STAT_INCR(zil_claim_time_ms, NSEC2MSEC(delta));
+
+		name = kmem_alloc(MAXNAMELEN, KM_SLEEP);
+		dsl_dataset_name(ds, name);
+		zfs_dbgmsg("claimed %llu blocks and %llu records of %s's log "
+		    "in %llu ms", (u_longlong_t)zilog->zl_parse_blk_count,
+		    (u_longlong_t)zilog->zl_parse_lr_count, name,
+		    (u_longlong_t)NSEC2MSEC(delta));
+		kmem_free(name, MAXNAMELEN);
+
 		zh->zh_claim_txg = first_txg;
 		zh->zh_claim_blk_seq = zilog->zl_parse_blk_seq;
 		zh->zh_claim_lr_seq = zilog->zl_parse_lr_seq;
@@ -1688,7 +1782,12 @@ zil_sync(zilog_t *zilog, dmu_tx_t *tx)
 	ASSERT(zilog->zl_stop_sync == 0);
 
 	if (*replayed_seq != 0) {
-		ASSERT(zh->zh_replay_seq < *replayed_seq);
+		/*
+		 * Writes replayed in parallel record the sequence number
+		 * of the last record replayed before them, which may have
+		 * been synced already.
+		 */
+		ASSERT(zh->zh_replay_seq <= *replayed_seq);
 		zh->zh_replay_seq = *replayed_seq;
 		*replayed_seq = 0;
 	}
@@ -2073,8 +2172,29 @@ typedef struct zil_replay_arg {
 	void		*zr_arg;
 	boolean_t	zr_byteswap;
 	char		*zr_lr;
+	taskq_t		**zr_taskqs;	/* one per write replay thread */
+	int		zr_ntaskqs;
+	kmutex_t	zr_lock;
+	kcondvar_t	zr_cv;
+	uint64_t	zr_inflight;	/* bytes held by queued writes */
+	int		zr_error;	/* first error from a queued write */
+	uint64_t	zr_queued_seq;	/* seq of the last queued write */
+	uint64_t	zr_records;
+	uint64_t	zr_bytes;
 } zil_replay_arg_t;
 
+/*
+ * A TX_WRITE record queued for one of the write replay threads.  The
+ * record is copied, and any data it refers to is read in by the thread.
+ */
+typedef struct zil_replay_write {
+	zilog_t		*zrw_zilog;
+	zil_replay_arg_t *zrw_zr;
+	uint64_t	zrw_txtype;
+	size_t		zrw_size;	/* size of zrw_lr allocation */
+	char		*zrw_lr;
+} zil_replay_write_t;
+
 static int
 zil_replay_error(zilog_t *zilog, lr_t *lr, int error)
 {
@@ -2093,6 +2213,109 @@ zil_replay_error(zilog_t *zilog, lr_t *lr, int error)
 	return (error);
 }
 
+/*
+ * Read in the data for a TX_WRITE whose data was written elsewhere
+ * (dmu_sync()), and call the replay vector for the record in lrbuf.
+ */
+static int
+zil_replay_one(zilog_t *zilog, zil_replay_arg_t *zr, uint64_t txtype,
+    char *lrbuf, lr_t *lr)
+{
+	uint64_t reclen = lr->lrc_reclen;
+	int error;
+
+	/*
+	 * If this is a TX_WRITE with a blkptr, suck in the data.
+	 */
+	if (txtype == TX_WRITE && reclen == sizeof (lr_write_t)) {
+		error = zil_read_log_data(zilog, (lr_write_t *)lr,
+		    lrbuf + reclen);
+		if (error != 0)
+			return (error);
+	}
+
+	/*
+	 * The log block containing this lr may have been byteswapped
+	 * so that we can easily examine common fields like lrc_txtype.
+	 * However, the log is a mix of different record types, and only the
+	 * replay vectors know how to byteswap their records.  Therefore, if
+	 * the lr was byteswapped, undo it before invoking the replay vector.
+	 */
+	if (zr->zr_byteswap)
+		byteswap_uint64_array(lrbuf, reclen);
+
+	/*
+	 * We must now do two things atomically: replay this log record,
+	 * and update the log header sequence number to reflect the fact that
+	 * we did so. At the end of each replay function the sequence number
+	 * is updated if we are in replay mode.
+	 */
+	error = zr->zr_replay[txtype](zr->zr_arg, lrbuf, zr->zr_byteswap);
+	if (error != 0) {
+		/*
+		 * The DMU's dnode layer doesn't see removes until the txg
+		 * commits, so a subsequent claim can spuriously fail with
+		 * EEXIST. So if we receive any error we try syncing out
+		 * any removes then retry the transaction.  Note that we
+		 * specify B_FALSE for byteswap now, so we don't do it twice.
+		 */
+		txg_wait_synced(spa_get_dsl(zilog->zl_spa), 0);
+		error = zr->zr_replay[txtype](zr->zr_arg, lrbuf, B_FALSE);
+	}
+	return (error);
+}
+
+static void
+zil_replay_write_func(void *arg)
+{
+	zil_replay_write_t *zrw = arg;
+	zil_replay_arg_t *zr = zrw->zrw_zr;
+	lr_t lr = *(lr_t *)zrw->zrw_lr;
+	int error = 0;
+
+	mutex_enter(&zr->zr_lock);
+	if (zr->zr_error == 0) {
+		mutex_exit(&zr->zr_lock);
+		error = zil_replay_one(zrw->zrw_zilog, zr, zrw->zrw_txtype,
+		    zrw->zrw_lr, (lr_t *)zrw->zrw_lr);
+		mutex_enter(&zr->zr_lock);
+	}
+	if (error != 0 && zr->zr_error == 0) {
+		char name[MAXNAMELEN];
+
+		zr->zr_error = error;
+		dmu_objset_name(zrw->zrw_zilog->zl_os, name);
+		cmn_err(CE_WARN, "ZFS replay transaction error %d, "
+		    "dataset %s, seq 0x%llx, txtype %llu\n", error, name,
+		    (u_longlong_t)lr.lrc_seq, (u_longlong_t)zrw->zrw_txtype);
+	}
+	zr->zr_inflight -= zrw->zrw_size;
+	cv_broadcast(&zr->zr_cv);
+	mutex_exit(&zr->zr_lock);
+
+	vmem_free(zrw->zrw_lr, zrw->zrw_size);
+	kmem_free(zrw, sizeof (zil_replay_write_t));
+}
+
+/*
+ * Wait for the queued writes to be replayed, and return the first error
+ * any of them hit.  Waiting for all of them is the barrier that keeps the
+ * other record types in order with respect to the writes.
+ */
+static int
+zil_replay_wait(zil_replay_arg_t *zr, uint64_t inflight)
+{
+	int error;
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_inflight > inflight)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	error = zr->zr_error;
+	mutex_exit(&zr->zr_lock);
+
+	return (error);
+}
+
 static int
 zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
 {
@@ -2102,8 +2325,6 @@ zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
 	uint64_t txtype = lr->lrc_txtype;
 	int error = 0;
 
-	zilog->zl_replaying_seq = lr->lrc_seq;
-
 	if (lr->lrc_seq <= zh->zh_replay_seq)	/* already replayed */
 		return (0);
 
@@ -2113,12 +2334,18 @@ zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
 	/* Strip case-insensitive bit, still present in log record */
 	txtype &= ~TX_CI;
 
-	if (txtype == 0 || txtype >= TX_MAX_TYPE)
+	if (txtype == 0 || txtype >= TX_MAX_TYPE) {
+		if ((error = zil_replay_wait(zr, 0)) != 0)
+			return (error);
+		zilog->zl_replaying_seq = lr->lrc_seq;
 		return (zil_replay_error(zilog, lr, EINVAL));
+	}
 
 	/*
 	 * If this record type can be logged out of order, the object
 	 * (lr_foid) may no longer exist.  That's legitimate, not an error.
+	 * Objects are only created and removed by records replayed after
+	 * the queued writes, so it's safe to check this here.
 	 */
 	if (TX_OOO(txtype)) {
 		error = dmu_object_info(zilog->zl_os,
@@ -2127,51 +2354,64 @@ zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
 			return (0);
 	}
 
-	/*
-	 * Make a copy of the data so we can revise and extend it.
-	 */
-	bcopy(lr, zr->zr_lr, reclen);
+	zr->zr_records++;
+	zr->zr_bytes += reclen;
 
 	/*
-	 * If this is a TX_WRITE with a blkptr, suck in the data.
+	 * Writes are handed to the replay thread for their object.  The
+	 * sequence number recorded by zil_replaying() is left at the last
+	 * record replayed here, so that zh_replay_seq never gets ahead of a
+	 * write that hasn't been replayed yet; replaying a write twice is
+	 * harmless.
 	 */
-	if (txtype == TX_WRITE && reclen == sizeof (lr_write_t)) {
-		error = zil_read_log_data(zilog, (lr_write_t *)lr,
-		    zr->zr_lr + reclen);
+	if (zr->zr_ntaskqs != 0 &&
+	    (txtype == TX_WRITE || txtype == TX_WRITE2)) {
+		lr_write_t *lrw = (lr_write_t *)lr;
+		zil_replay_write_t *zrw;
+		size_t size = reclen;
+
+		if (txtype == TX_WRITE && reclen == sizeof (lr_write_t)) {
+			size += MAX(BP_GET_LSIZE(&lrw->lr_blkptr),
+			    lrw->lr_length);
+		}
+		zr->zr_bytes += size - reclen;
+
+		error = zil_replay_wait(zr, zil_replay_max_inflight);
 		if (error != 0)
-			return (zil_replay_error(zilog, lr, error));
+			return (error);
+
+		zrw = kmem_alloc(sizeof (zil_replay_write_t), KM_SLEEP);
+		zrw->zrw_zilog = zilog;
+		zrw->zrw_zr = zr;
+		zrw->zrw_txtype = txtype;
+		zrw->zrw_size = size;
+		zrw->zrw_lr = vmem_alloc(size, KM_SLEEP);
+		bcopy(lr, zrw->zrw_lr, reclen);
+
+		mutex_enter(&zr->zr_lock);
+		zr->zr_inflight += size;
+		mutex_exit(&zr->zr_lock);
+		zr->zr_queued_seq = lr->lrc_seq;
+
+		VERIFY(taskq_dispatch(
+		    zr->zr_taskqs[lrw->lr_foid % zr->zr_ntaskqs],
+		    zil_replay_write_func, zrw, TQ_SLEEP) != 0);
+		return (0);
 	}
 
-	/*
-	 * The log block containing this lr may have been byteswapped
-	 * so that we can easily examine common fields like lrc_txtype.
-	 * However, the log is a mix of different record types, and only the
-	 * replay vectors know how to byteswap their records.  Therefore, if
-	 * the lr was byteswapped, undo it before invoking the replay vector.
-	 */
-	if (zr->zr_byteswap)
-		byteswap_uint64_array(zr->zr_lr, reclen);
+	if ((error = zil_replay_wait(zr, 0)) != 0)
+		return (error);
+
+	zilog->zl_replaying_seq = lr->lrc_seq;
 
 	/*
-	 * We must now do two things atomically: replay this log record,
-	 * and update the log header sequence number to reflect the fact that
-	 * we did so. At the end of each replay function the sequence number
-	 * is updated if we are in replay mode.
+	 * Make a copy of the data so we can revise and extend it.
 	 */
-	error = zr->zr_replay[txtype](zr->zr_arg, zr->zr_lr, zr->zr_byteswap);
-	if (error != 0) {
-		/*
-		 * The DMU's dnode layer doesn't see removes until the txg
-		 * commits, so a subsequent claim can spuriously fail with
-		 * EEXIST. So if we receive any error we try syncing out
-		 * any removes then retry the transaction.  Note that we
-		 * specify B_FALSE for byteswap now, so we don't do it twice.
-		 */
-		txg_wait_synced(spa_get_dsl(zilog->zl_spa), 0);
-		error = zr->zr_replay[txtype](zr->zr_arg, zr->zr_lr, B_FALSE);
-		if (error != 0)
-			return (zil_replay_error(zilog, lr, error));
-	}
+	bcopy(lr, zr->zr_lr, reclen);
+
+	error = zil_replay_one(zilog, zr, txtype, zr->zr_lr, lr);
+	if (error != 0)
+		return (zil_replay_error(zilog, lr, error));
 	return (0);
 }
 
@@ -2180,7 +2420,6 @@ static int
 zil_incr_blks(zilog_t *zilog, blkptr_t *bp, void *arg, uint64_t claim_txg)
 {
 	zilog->zl_replay_blks++;
-
 	return (0);
 }
 
@@ -2193,32 +2432,73 @@ zil_replay(objset_t *os, void *arg, zil_replay_func_t replay_func[TX_MAX_TYPE])
 	zilog_t *zilog = dmu_objset_zil(os);
 	const zil_header_t *zh = zilog->zl_header;
 	zil_replay_arg_t zr;
+	hrtime_t start;
+	int t;
 
 	if ((zh->zh_flags & ZIL_REPLAY_NEEDED) == 0) {
 		zil_destroy(zilog, B_TRUE);
 		return;
 	}
 
+	bzero(&zr, sizeof (zr));
 	zr.zr_replay = replay_func;
 	zr.zr_arg = arg;
 	zr.zr_byteswap = BP_SHOULD_BYTESWAP(&zh->zh_log);
 	zr.zr_lr = vmem_alloc(2 * SPA_MAXBLOCKSIZE, KM_SLEEP);
+	mutex_init(&zr.zr_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zr.zr_cv, NULL, CV_DEFAULT, NULL);
+
+	/*
+	 * Each write replay thread has a taskq of its own, so that the
+	 * writes queued for it are replayed in order.
+	 */
+	if (zil_replay_threads > 1) {
+		zr.zr_ntaskqs = zil_replay_threads;
+		zr.zr_taskqs = kmem_alloc(zr.zr_ntaskqs * sizeof (taskq_t *),
+		    KM_SLEEP);
+		for (t = 0; t < zr.zr_ntaskqs; t++) {
+			zr.zr_taskqs[t] = taskq_create("zil_replay", 1,
+			    defclsyspri, 1, INT_MAX, 0);
+		}
+	}
 
 	/*
 	 * Wait for in-progress removes to sync before starting replay.
 	 */
 	txg_wait_synced(zilog->zl_dmu_pool, 0);
 
+	start = gethrtime();
+	zilog->zl_replaying_seq = zh->zh_replay_seq;
 	zilog->zl_replay = B_TRUE;
 	zilog->zl_replay_time = ddi_get_lbolt();
 	ASSERT(zilog->zl_replay_blks == 0);
 	(void) zil_parse(zilog, zil_incr_blks, zil_replay_log_record, &zr,
 	    zh->zh_claim_txg);
+
+	/*
+	 * Once the writes queued after the last record replayed here have
+	 * completed, the log has been replayed up to the last of them.
+	 */
+	if (zil_replay_wait(&zr, 0) == 0 &&
+	    zr.zr_queued_seq > zilog->zl_replaying_seq)
+		zilog->zl_replaying_seq = zr.zr_queued_seq;
+
+	for (t = 0; t < zr.zr_ntaskqs; t++)
+		taskq_destroy(zr.zr_taskqs[t]);
+	if (zr.zr_ntaskqs != 0)
+		kmem_free(zr.zr_taskqs, zr.zr_ntaskqs * sizeof (taskq_t *));
+	mutex_destroy(&zr.zr_lock);
+	cv_destroy(&zr.zr_cv);
 	vmem_free(zr.zr_lr, 2 * SPA_MAXBLOCKSIZE);
 
 	zil_destroy(zilog, B_FALSE);
 	txg_wait_synced(zilog->zl_dmu_pool, zilog->zl_destroy_txg);
 	zilog->zl_replay = B_FALSE;
+
+	ZIL_STAT_BUMP(zil_replay_count);
+	ZIL_STAT_INCR(zil_replay_records, zr.zr_records);
+	ZIL_STAT_INCR(zil_replay_bytes, zr.zr_bytes);
+	ZIL_STAT_INCR(zil_replay_time_ms, NSEC2MSEC(gethrtime() - start));
 }
 
 boolean_t
@@ -2277,6 +2557,13 @@ EXPORT_SYMBOL(zil_set_logbias);
 module_param(zil_replay_disable, int, 0644);
 MODULE_PARM_DESC(zil_replay_disable, "Disable intent logging replay");
 
+module_param(zil_replay_threads, int, 0644);
+MODULE_PARM_DESC(zil_replay_threads, "Threads used to replay log writes");
+
+module_param(zil_replay_max_inflight, ulong, 0644);
+MODULE_PARM_DESC(zil_replay_max_inflight,
+	"Max bytes of log writes queued for replay");
+
 module_param(zfs_nocacheflush, int, 0644);
 MODULE_PARM_DESC(zfs_nocacheflush, "Disable cache flushes");
 
@@ -849,6 +849,7 @@ zio_free_sync(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 
 	metaslab_check_free(spa, bp);
 	arc_freed(spa, bp);
+	spa_sync_stat_add(spa, SPA_SYNC_FREES, 1);
 
 	/*
 	 * GANG and DEDUP blocks can induce a read (for the gang block header,
@@ -283,6 +283,171 @@ zpl_iter_read_common(struct kiocb *kiocb, const struct iovec *iovp,
 }
 
 #if defined(HAVE_VFS_RW_ITERATE)
+/*
+ * Asynchronous I/O.  An AIO read of user memory pins the destination pages
+ * and hands them to zfs_read_async(), which completes the kiocb from the
+ * read's completion callback rather than blocking the submitter until the
+ * data arrives.  An AIO write which must be synchronous copies its data in
+ * as usual, but waits for the ZIL commit from a taskq.
+ */
+static taskq_t *zpl_aio_taskq;
+
+typedef struct zpl_aio_read {
+	struct kiocb	*za_kiocb;
+	struct page	**za_pages;
+	struct bio_vec	*za_bvecs;
+	int		za_maxpages;
+	int		za_npages;
+	uio_t		za_uio;
+} zpl_aio_read_t;
+
+typedef struct zpl_aio_write {
+	struct kiocb	*zw_kiocb;
+	struct inode	*zw_ip;
+	cred_t		*zw_cr;
+	ssize_t		zw_wrote;
+	taskq_ent_t	zw_tqent;
+} zpl_aio_write_t;
+
+static void
+zpl_aio_complete(struct kiocb *kiocb, long res)
+{
+#ifdef HAVE_KIOCB_KI_COMPLETE
+	kiocb->ki_complete(kiocb, res, 0);
+#else
+	aio_complete(kiocb, res, 0);
+#endif
+}
+
+static void
+zpl_aio_read_free(zpl_aio_read_t *za)
+{
+	int i;
+
+	for (i = 0; i < za->za_npages; i++) {
+		set_page_dirty_lock(za->za_pages[i]);
+		put_page(za->za_pages[i]);
+	}
+
+	vmem_free(za->za_pages, sizeof (struct page *) * za->za_maxpages);
+	vmem_free(za->za_bvecs, sizeof (struct bio_vec) * za->za_maxpages);
+	kmem_free(za, sizeof (zpl_aio_read_t));
+}
+
+static void
+zpl_aio_read_done(void *arg, ssize_t nread, int error)
+{
+	zpl_aio_read_t *za = arg;
+	struct kiocb *kiocb = za->za_kiocb;
+
+	zpl_aio_read_free(za);
+	zpl_aio_complete(kiocb, error ? -error : nread);
+}
+
+/*
+ * Pin the user pages described by the iterator, and describe them with a
+ * bvec uio which can be copied to from any context.
+ */
+static int
+zpl_aio_read_pin(zpl_aio_read_t *za, struct iov_iter *to)
+{
+	struct iov_iter iter = *to;
+	size_t count = iov_iter_count(to);
+	int n = 0;
+
+	za->za_maxpages = iov_iter_npages(&iter, INT_MAX);
+	za->za_pages = vmem_alloc(sizeof (struct page *) * za->za_maxpages,
+	    KM_SLEEP);
+	za->za_bvecs = vmem_alloc(sizeof (struct bio_vec) * za->za_maxpages,
+	    KM_SLEEP);
+
+	while (iov_iter_count(&iter) > 0) {
+		size_t start;
+		ssize_t bytes;
+
+		if (n == za->za_maxpages)
+			return (-EFAULT);
+
+		bytes = iov_iter_get_pages(&iter, &za->za_pages[n],
+		    iov_iter_count(&iter), za->za_maxpages - n, &start);
+		if (bytes <= 0)
+			return (bytes < 0 ? bytes : -EFAULT);
+		iov_iter_advance(&iter, bytes);
+
+		while (bytes > 0) {
+			struct bio_vec *bv = &za->za_bvecs[n];
+
+			bv->bv_page = za->za_pages[n];
+			bv->bv_offset = start;
+			bv->bv_len = MIN(PAGE_SIZE - start, bytes);
+			bytes -= bv->bv_len;
+			start = 0;
+			za->za_npages = ++n;
+		}
+	}
+
+	za->za_uio.uio_bvec = za->za_bvecs;
+	za->za_uio.uio_skip = 0;
+	za->za_uio.uio_resid = count;
+	za->za_uio.uio_iovcnt = n;
+	za->za_uio.uio_loffset = za->za_kiocb->ki_pos;
+	za->za_uio.uio_limit = MAXOFFSET_T;
+	za->za_uio.uio_segflg = UIO_BVEC;
+
+	return (0);
+}
+
+/*
+ * Returns B_FALSE if the read should be done synchronously instead.
+ */
+static boolean_t
+zpl_iter_read_async(struct kiocb *kiocb, struct iov_iter *to, ssize_t *retp)
+{
+	struct file *filp = kiocb->ki_filp;
+	struct inode *ip = filp->f_mapping->host;
+	size_t count = iov_iter_count(to);
+	zpl_aio_read_t *za;
+	fstrans_cookie_t cookie;
+	cred_t *cr = CRED();
+	int error;
+
+	if (!zfs_aio_async || is_sync_kiocb(kiocb) || count == 0 ||
+	    count > DMU_MAX_ACCESS >> 1 || ITOZ(ip)->z_is_mapped)
+		return (B_FALSE);
+
+	za = kmem_zalloc(sizeof (zpl_aio_read_t), KM_SLEEP);
+	za->za_kiocb = kiocb;
+	if (zpl_aio_read_pin(za, to) != 0) {
+		zpl_aio_read_free(za);
+		return (B_FALSE);
+	}
+
+	crhold(cr);
+	cookie = spl_fstrans_mark();
+	error = zfs_read_async(ip, &za->za_uio, filp->f_flags, cr,
+	    zpl_aio_read_done, za);
+	spl_fstrans_unmark(cookie);
+	crfree(cr);
+
+	if (error == ENOTSUP) {
+		zpl_aio_read_free(za);
+		return (B_FALSE);
+	} else if (error) {
+		zpl_aio_read_free(za);
+		*retp = -error;
+		return (B_TRUE);
+	}
+
+	/*
+	 * The kiocb may already have been completed, if everything was
+	 * cached, but it is no longer ours to touch either way.
+	 */
+	task_io_account_read(count);
+	file_accessed(filp);
+	*retp = -EIOCBQUEUED;
+	return (B_TRUE);
+}
+
 static ssize_t
 zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 {
@@ -292,6 +457,8 @@ zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 		seg = UIO_SYSSPACE;
 	if (to->type & ITER_BVEC)
 		seg = UIO_BVEC;
+	if (seg == UIO_USERSPACE && zpl_iter_read_async(kiocb, to, &ret))
+		return (ret);
 	ret = zpl_iter_read_common(kiocb, to->iov, to->nr_segs,
 	    iov_iter_count(to), seg, to->iov_offset);
 	if (ret > 0)
@@ -385,6 +552,67 @@ zpl_iter_write_common(struct kiocb *kiocb, const struct iovec *iovp,
 }
 
 #if defined(HAVE_VFS_RW_ITERATE)
+static void
+zpl_aio_write_commit(void *arg)
+{
+	zpl_aio_write_t *zw = arg;
+	fstrans_cookie_t cookie;
+	int error;
+
+	cookie = spl_fstrans_mark();
+	error = -zfs_fsync(zw->zw_ip, 0, zw->zw_cr);
+	spl_fstrans_unmark(cookie);
+
+	crfree(zw->zw_cr);
+	zpl_aio_complete(zw->zw_kiocb, error ? error : zw->zw_wrote);
+	kmem_free(zw, sizeof (zpl_aio_write_t));
+}
+
+/*
+ * Write the data for a synchronous AIO write without committing it, and
+ * complete the kiocb once the ZIL commit is done.  Concurrent commits are
+ * batched by the ZIL, so a few taskq threads can keep up with many
+ * outstanding writes.  Returns B_FALSE if the write should be done
+ * synchronously instead.
+ */
+static boolean_t
+zpl_iter_write_async(struct kiocb *kiocb, struct iov_iter *from,
+    ssize_t *retp)
+{
+	struct file *filp = kiocb->ki_filp;
+	struct inode *ip = filp->f_mapping->host;
+	zpl_aio_write_t *zw;
+	cred_t *cr = CRED();
+	ssize_t wrote;
+
+	if (!zfs_aio_async || is_sync_kiocb(kiocb) ||
+	    !(filp->f_flags & (O_SYNC | O_DSYNC)) ||
+	    ITOZSB(ip)->z_os->os_sync == ZFS_SYNC_DISABLED)
+		return (B_FALSE);
+
+	crhold(cr);
+	wrote = zpl_write_common_iovec(ip, from->iov, iov_iter_count(from),
+	    from->nr_segs, &kiocb->ki_pos, UIO_USERSPACE,
+	    filp->f_flags & ~(O_SYNC | O_DSYNC), cr, from->iov_offset);
+	if (wrote <= 0) {
+		crfree(cr);
+		*retp = wrote;
+		return (B_TRUE);
+	}
+
+	zw = kmem_alloc(sizeof (zpl_aio_write_t), KM_SLEEP);
+	zw->zw_kiocb = kiocb;
+	zw->zw_ip = ip;
+	zw->zw_cr = cr;
+	zw->zw_wrote = wrote;
+	taskq_init_ent(&zw->zw_tqent);
+	taskq_dispatch_ent(zpl_aio_taskq, zpl_aio_write_commit, zw, 0,
+	    &zw->zw_tqent);
+
+	*retp = -EIOCBQUEUED;
+	return (B_TRUE);
+}
+
 static ssize_t
 zpl_iter_write(struct kiocb *kiocb, struct iov_iter *from)
 {
@@ -394,6 +622,8 @@ zpl_iter_write(struct kiocb *kiocb, struct iov_iter *from)
 		seg = UIO_SYSSPACE;
 	if (from->type & ITER_BVEC)
 		seg = UIO_BVEC;
+	if (seg == UIO_USERSPACE && zpl_iter_write_async(kiocb, from, &ret))
+		return (ret);
 	ret = zpl_iter_write_common(kiocb, from->iov, from->nr_segs,
 	    iov_iter_count(from), seg, from->iov_offset);
 	if (ret > 0)
@@ -825,6 +1055,23 @@ const struct address_space_operations zpl_address_space_operations = {
 	.writepages	= zpl_writepages,
 };
 
+void
+zpl_file_init(void)
+{
+#if defined(HAVE_VFS_RW_ITERATE)
+	zpl_aio_taskq = taskq_create("z_aio", max_ncpus, defclsyspri,
+	    max_ncpus, INT_MAX, TASKQ_PREPOPULATE | TASKQ_DYNAMIC);
+#endif
+}
+
+void
+zpl_file_fini(void)
+{
+#if defined(HAVE_VFS_RW_ITERATE)
+	taskq_destroy(zpl_aio_taskq);
+#endif
+}
+
 const struct file_operations zpl_file_operations = {
 	.open		= zpl_open,
 	.release	= zpl_release,
@@ -50,10 +50,14 @@
 #include <sys/zio.h>
 #include <sys/zfs_rlock.h>
 #include <sys/zfs_znode.h>
+#include <sys/range_tree.h>
 #include <sys/spa_impl.h>
 #include <sys/zvol.h>
 #include <linux/blkdev_compat.h>
 
+unsigned int zvol_async_discard = 1;
+unsigned int zvol_async_flush = 1;
+unsigned int zvol_async_read = 1;
 unsigned int zvol_inhibit_dev = 0;
 unsigned int zvol_major = ZVOL_MAJOR;
 unsigned int zvol_prefetch_bytes = (128 * 1024);
@@ -62,6 +66,29 @@ unsigned long zvol_max_discard_blocks = 16384;
 static kmutex_t zvol_state_lock;
 static list_t zvol_state_list;
 static char *zvol_tag = "zvol_tag";
+static taskq_t *zvol_discard_taskq;
+static taskq_t *zvol_minor_taskq;
+static taskq_t *zvol_flush_taskq;
+
+/*
+ * Per-zvol flush statistics, see /proc/spl/kstat/zfs/zd<minor>.
+ */
+typedef struct zvol_flush_stats {
+	kstat_named_t zvfs_flushes;
+	kstat_named_t zvfs_commits;
+	kstat_named_t zvfs_coalesced;
+	kstat_named_t zvfs_commit_time_ns;
+} zvol_flush_stats_t;
+
+static const zvol_flush_stats_t zvol_flush_stats_template = {
+	{ "flushes",		KSTAT_DATA_UINT64 },
+	{ "commits",		KSTAT_DATA_UINT64 },
+	{ "coalesced",		KSTAT_DATA_UINT64 },
+	{ "commit_time_ns",	KSTAT_DATA_UINT64 }
+};
+
+#define	ZVOL_FLUSH_STAT_INCR(zv, stat, val) \
+	atomic_add_64(&(zv)->zv_flush_stats.stat.value.ui64, (val))
 
 /*
  * The in-core state of each volume.
@@ -81,8 +108,74 @@ typedef struct zvol_state {
 	struct gendisk		*zv_disk;	/* generic disk */
 	struct request_queue	*zv_queue;	/* request queue */
 	list_node_t		zv_next;	/* next zvol_state_t linkage */
+	kmutex_t		zv_discard_lock;	/* protects below */
+	kcondvar_t		zv_discard_cv;	/* signalled when idle */
+	range_tree_t		*zv_discard_tree;	/* queued discards */
+	boolean_t		zv_discard_busy;	/* worker dispatched */
+	kmutex_t		zv_flush_lock;	/* protects below */
+	kcondvar_t		zv_flush_cv;	/* signalled when idle */
+	list_t			zv_flush_list;	/* bios awaiting commit */
+	boolean_t		zv_flush_busy;	/* worker dispatched */
+	kstat_t			*zv_flush_ksp;	/* flush statistics */
+	zvol_flush_stats_t	zv_flush_stats;
 } zvol_state_t;
 
+/*
+ * Statistics for discards which are queued and freed in the background,
+ * see /proc/spl/kstat/zfs/zvol_discard_stats.
+ */
+typedef struct zvol_discard_stats {
+	kstat_named_t zds_queued;
+	kstat_named_t zds_queued_time_ns;
+	kstat_named_t zds_pending_ranges;
+	kstat_named_t zds_pending_bytes;
+	kstat_named_t zds_frees;
+	kstat_named_t zds_free_bytes;
+	kstat_named_t zds_free_time_ns;
+	kstat_named_t zds_inline_frees;
+} zvol_discard_stats_t;
+
+static zvol_discard_stats_t zvol_discard_stats = {
+	{ "queued",		KSTAT_DATA_UINT64 },
+	{ "queued_time_ns",	KSTAT_DATA_UINT64 },
+	{ "pending_ranges",	KSTAT_DATA_UINT64 },
+	{ "pending_bytes",	KSTAT_DATA_UINT64 },
+	{ "frees",		KSTAT_DATA_UINT64 },
+	{ "free_bytes",		KSTAT_DATA_UINT64 },
+	{ "free_time_ns",	KSTAT_DATA_UINT64 },
+	{ "inline_frees",	KSTAT_DATA_UINT64 }
+};
+
+static kstat_t *zvol_discard_ksp;
+
+#define	ZVOL_DISCARD_STAT_INCR(stat, val) \
+	atomic_add_64(&zvol_discard_stats.stat.value.ui64, (val))
+#define	ZVOL_DISCARD_STAT_BUMP(stat)	ZVOL_DISCARD_STAT_INCR(stat, 1)
+
+/*
+ * Statistics for creating the minors of a pool or dataset, including the
+ * time taken by the most recent scan, see zvol_create_minors_impl().
+ */
+typedef struct zvol_minor_stats {
+	kstat_named_t zms_created;
+	kstat_named_t zms_scans;
+	kstat_named_t zms_last_minors;
+	kstat_named_t zms_last_time_ns;
+} zvol_minor_stats_t;
+
+static zvol_minor_stats_t zvol_minor_stats = {
+	{ "created",		KSTAT_DATA_UINT64 },
+	{ "scans",		KSTAT_DATA_UINT64 },
+	{ "last_scan_minors",	KSTAT_DATA_UINT64 },
+	{ "last_scan_time_ns",	KSTAT_DATA_UINT64 }
+};
+
+static kstat_t *zvol_minor_ksp;
+
+#define	ZVOL_MINOR_STAT_INCR(stat, val) \
+	atomic_add_64(&zvol_minor_stats.stat.value.ui64, (val))
+#define	ZVOL_MINOR_STAT_BUMP(stat)	ZVOL_MINOR_STAT_INCR(stat, 1)
+
 typedef enum {
 	ZVOL_ASYNC_CREATE_MINORS,
 	ZVOL_ASYNC_REMOVE_MINORS,
@@ -624,6 +717,189 @@ zvol_log_write(zvol_state_t *zv, dmu_tx_t *tx, uint64_t offset,
 	}
 }
 
+/*
+ * Discards are logged and acknowledged as soon as their range has been
+ * added to zv_discard_tree, where adjacent and overlapping discards are
+ * coalesced.  A worker on zvol_discard_taskq then frees the queued ranges,
+ * each under a writer range lock.  Reads and writes which overlap a queued
+ * range free it themselves (see zvol_range_lock()) so they never observe
+ * the discarded data, or have their new data freed after the fact.
+ */
+static void
+zvol_discard_update_stats(zvol_state_t *zv, uint64_t space, uint64_t segs)
+{
+	range_tree_t *rt = zv->zv_discard_tree;
+
+	ASSERT(MUTEX_HELD(&zv->zv_discard_lock));
+	ZVOL_DISCARD_STAT_INCR(zds_pending_bytes,
+	    range_tree_space(rt) - space);
+	ZVOL_DISCARD_STAT_INCR(zds_pending_ranges,
+	    zfs_btree_numnodes(&rt->rt_root) - segs);
+}
+
+/*
+ * Free whatever part of [start, start + size) is still queued.  The caller
+ * must hold a writer range lock covering the range.
+ */
+static int
+zvol_discard_free(zvol_state_t *zv, uint64_t start, uint64_t size,
+    boolean_t inline_free)
+{
+	range_tree_t *rt = zv->zv_discard_tree;
+	range_seg_t rsearch, *rs;
+	uint64_t space, segs, off, len;
+	hrtime_t begin;
+	int error = 0;
+
+	rsearch.rs_start = start;
+	rsearch.rs_end = start + size;
+
+	mutex_enter(&zv->zv_discard_lock);
+	while ((rs = zfs_btree_find(&rt->rt_root, &rsearch, NULL)) != NULL) {
+		off = MAX(rs->rs_start, start);
+		len = MIN(rs->rs_end, start + size) - off;
+
+		space = range_tree_space(rt);
+		segs = zfs_btree_numnodes(&rt->rt_root);
+		range_tree_remove(rt, off, len);
+		zvol_discard_update_stats(zv, space, segs);
+		mutex_exit(&zv->zv_discard_lock);
+
+		begin = gethrtime();
+		error = dmu_free_long_range(zv->zv_objset, ZVOL_OBJ, off, len);
+		ZVOL_DISCARD_STAT_INCR(zds_free_time_ns, gethrtime() - begin);
+		ZVOL_DISCARD_STAT_INCR(zds_free_bytes, len);
+		ZVOL_DISCARD_STAT_BUMP(zds_frees);
+		if (inline_free)
+			ZVOL_DISCARD_STAT_BUMP(zds_inline_frees);
+
+		mutex_enter(&zv->zv_discard_lock);
+		if (error != 0)
+			break;
+	}
+	mutex_exit(&zv->zv_discard_lock);
+
+	return (error);
+}
+
+static boolean_t
+zvol_discard_pending(zvol_state_t *zv, uint64_t start, uint64_t size)
+{
+	range_seg_t rsearch;
+	boolean_t pending;
+
+	if (size == 0)
+		return (B_FALSE);
+
+	rsearch.rs_start = start;
+	rsearch.rs_end = start + size;
+
+	mutex_enter(&zv->zv_discard_lock);
+	pending = (zfs_btree_find(&zv->zv_discard_tree->rt_root, &rsearch,
+	    NULL) != NULL);
+	mutex_exit(&zv->zv_discard_lock);
+
+	return (pending);
+}
+
+static void
+zvol_discard_worker(void *arg)
+{
+	zvol_state_t *zv = arg;
+	uint64_t maxlen = zvol_max_discard_blocks * zv->zv_volblocksize;
+	range_seg_t *rs;
+	uint64_t start, size;
+	rl_t *rl;
+
+	mutex_enter(&zv->zv_discard_lock);
+	while ((rs = zfs_btree_first(&zv->zv_discard_tree->rt_root,
+	    NULL)) != NULL) {
+		start = rs->rs_start;
+		size = MIN(rs->rs_end - start, maxlen);
+		mutex_exit(&zv->zv_discard_lock);
+
+		/*
+		 * The range may have been freed by an overlapping i/o, or
+		 * grown, while we waited for the lock; only what is still
+		 * queued is freed.  A failure leaves the blocks allocated,
+		 * which is harmless for a discard.
+		 */
+		rl = zfs_range_lock(&zv->zv_znode, start, size, RL_WRITER);
+		(void) zvol_discard_free(zv, start, size, B_FALSE);
+		zfs_range_unlock(rl);
+
+		mutex_enter(&zv->zv_discard_lock);
+	}
+	zv->zv_discard_busy = B_FALSE;
+	cv_broadcast(&zv->zv_discard_cv);
+	mutex_exit(&zv->zv_discard_lock);
+}
+
+/*
+ * Queue a logged discard for the worker.  The caller holds a writer range
+ * lock for the range, which orders this against overlapping i/o.
+ */
+static void
+zvol_discard_queue(zvol_state_t *zv, uint64_t start, uint64_t size)
+{
+	range_tree_t *rt = zv->zv_discard_tree;
+	uint64_t space, segs;
+	boolean_t dispatch = B_FALSE;
+
+	mutex_enter(&zv->zv_discard_lock);
+	space = range_tree_space(rt);
+	segs = zfs_btree_numnodes(&rt->rt_root);
+	range_tree_clear(rt, start, size);
+	range_tree_add(rt, start, size);
+	zvol_discard_update_stats(zv, space, segs);
+	if (!zv->zv_discard_busy) {
+		zv->zv_discard_busy = B_TRUE;
+		dispatch = B_TRUE;
+	}
+	mutex_exit(&zv->zv_discard_lock);
+
+	if (dispatch)
+		VERIFY(taskq_dispatch(zvol_discard_taskq, zvol_discard_worker,
+		    zv, TQ_SLEEP) != 0);
+}
+
+/*
+ * Wait for every queued discard to be freed.
+ */
+static void
+zvol_discard_wait(zvol_state_t *zv)
+{
+	mutex_enter(&zv->zv_discard_lock);
+	while (zv->zv_discard_busy)
+		cv_wait(&zv->zv_discard_cv, &zv->zv_discard_lock);
+	mutex_exit(&zv->zv_discard_lock);
+}
+
+/*
+ * Range lock a region for i/o, first freeing any queued discards which
+ * overlap it.  That needs a writer lock, so readers briefly upgrade.
+ */
+static rl_t *
+zvol_range_lock(zvol_state_t *zv, uint64_t off, uint64_t len, rl_type_t type)
+{
+	rl_t *rl;
+
+	rl = zfs_range_lock(&zv->zv_znode, off, len, type);
+	while (zvol_discard_pending(zv, off, len)) {
+		if (type == RL_WRITER) {
+			(void) zvol_discard_free(zv, off, len, B_TRUE);
+			break;
+		}
+		zfs_range_unlock(rl);
+		rl = zfs_range_lock(&zv->zv_znode, off, len, RL_WRITER);
+		(void) zvol_discard_free(zv, off, len, B_TRUE);
+		zfs_range_unlock(rl);
+		rl = zfs_range_lock(&zv->zv_znode, off, len, type);
+	}
+
+	return (rl);
+}
+
 static int
 zvol_write(zvol_state_t *zv, uio_t *uio, boolean_t sync)
 {
@@ -633,8 +909,11 @@ zvol_write(zvol_state_t *zv, uio_t *uio, boolean_t sync)
 
 	ASSERT(zv && zv->zv_open_count > 0);
 
-	rl = zfs_range_lock(&zv->zv_znode, uio->uio_loffset, uio->uio_resid,
-	    RL_WRITER);
+	error = dmu_objset_rate_limit(zv->zv_objset, B_TRUE, uio->uio_resid);
+	if (error != 0)
+		return (error);
+
+	rl = zvol_range_lock(zv, uio->uio_loffset, uio->uio_resid, RL_WRITER);
 
 	while (uio->uio_resid > 0 && uio->uio_loffset < volsize) {
 		uint64_t bytes = MIN(uio->uio_resid, DMU_MAX_ACCESS >> 1);
@@ -661,8 +940,6 @@ zvol_write(zvol_state_t *zv, uio_t *uio, boolean_t sync)
 			break;
 	}
 	zfs_range_unlock(rl);
-	if (sync)
-		zil_commit(zv->zv_zilog, ZVOL_OBJ);
 	return (error);
 }
 
@@ -697,6 +974,8 @@ zvol_discard(struct bio *bio)
 	uint64_t start = BIO_BI_SECTOR(bio) << 9;
 	uint64_t size = BIO_BI_SIZE(bio);
 	uint64_t end = start + size;
+	boolean_t async = (zvol_async_discard != 0);
+	hrtime_t begin = gethrtime();
 	int error;
 	rl_t *rl;
 	dmu_tx_t *tx;
@@ -719,6 +998,9 @@ zvol_discard(struct bio *bio)
 		start = P2ROUNDUP(start, zv->zv_volblocksize);
 		end = P2ALIGN(end, zv->zv_volblocksize);
 		size = end - start;
+	} else {
+		/* A secure discard must be freed before it completes */
+		async = B_FALSE;
 	}
 #endif
 
@@ -734,8 +1016,15 @@ zvol_discard(struct bio *bio)
 	} else {
 		zvol_log_truncate(zv, tx, start, size, B_TRUE);
 		dmu_tx_commit(tx);
-		error = dmu_free_long_range(zv->zv_objset,
-		    ZVOL_OBJ, start, size);
+		if (async) {
+			zvol_discard_queue(zv, start, size);
+			ZVOL_DISCARD_STAT_INCR(zds_queued_time_ns,
+			    gethrtime() - begin);
+			ZVOL_DISCARD_STAT_BUMP(zds_queued);
+		} else {
+			error = dmu_free_long_range(zv->zv_objset,
+			    ZVOL_OBJ, start, size);
+		}
 	}
 
 	zfs_range_unlock(rl);
@@ -752,8 +1041,11 @@ zvol_read(zvol_state_t *zv, uio_t *uio)
 
 	ASSERT(zv && zv->zv_open_count > 0);
 
-	rl = zfs_range_lock(&zv->zv_znode, uio->uio_loffset, uio->uio_resid,
-	    RL_READER);
+	error = dmu_objset_rate_limit(zv->zv_objset, B_FALSE, uio->uio_resid);
+	if (error != 0)
+		return (error);
+
+	rl = zvol_range_lock(zv, uio->uio_loffset, uio->uio_resid, RL_READER);
 	while (uio->uio_resid > 0 && uio->uio_loffset < volsize) {
 		uint64_t bytes = MIN(uio->uio_resid, DMU_MAX_ACCESS >> 1);
 
@@ -773,6 +1065,178 @@ zvol_read(zvol_state_t *zv, uio_t *uio)
 	return (error);
 }
 
+typedef struct zvol_read_arg {
+	zvol_state_t	*zra_zv;
+	struct bio	*zra_bio;
+	uio_t		zra_uio;
+	rl_t		*zra_rl;
+	unsigned long	zra_start;
+} zvol_read_arg_t;
+
+static void
+zvol_read_done(void *arg, dmu_buf_t **dbp, int numbufs, int error)
+{
+	zvol_read_arg_t *zra = arg;
+	zvol_state_t *zv = zra->zra_zv;
+
+	if (error == 0)
+		error = dmu_read_uio_bufs(dbp, numbufs, &zra->zra_uio,
+		    zra->zra_uio.uio_resid);
+	dmu_buf_rele_array(dbp, numbufs, zra);
+
+	/* convert checksum errors into IO errors */
+	if (error == ECKSUM)
+		error = SET_ERROR(EIO);
+
+	zfs_range_unlock(zra->zra_rl);
+	generic_end_io_acct(READ, &zv->zv_disk->part0, zra->zra_start);
+	BIO_END_IO(zra->zra_bio, -error);
+	kmem_free(zra, sizeof (zvol_read_arg_t));
+}
+
+/*
+ * Issue the read for a bio without waiting for it; zvol_read_done() copies
+ * the data and ends the bio once it has been read, so the submitting thread
+ * is free to queue more i/o in the meantime.  Returns 0 if the read was
+ * issued, otherwise the caller should use zvol_read().
+ */
+static int
+zvol_read_async(zvol_state_t *zv, struct bio *bio, uio_t *uio)
+{
+	zvol_read_arg_t *zra;
+	int error;
+
+	ASSERT(zv && zv->zv_open_count > 0);
+
+	if (!zvol_async_read || uio->uio_resid == 0 ||
+	    uio->uio_resid > DMU_MAX_ACCESS >> 1)
+		return (SET_ERROR(ENOTSUP));
+
+	ASSERT3U(uio->uio_loffset + uio->uio_resid, <=, zv->zv_volsize);
+
+	error = dmu_objset_rate_limit(zv->zv_objset, B_FALSE, uio->uio_resid);
+	if (error != 0)
+		return (error);
+
+	zra = kmem_alloc(sizeof (zvol_read_arg_t), KM_SLEEP);
+	zra->zra_zv = zv;
+	zra->zra_bio = bio;
+	zra->zra_uio = *uio;
+	zra->zra_start = jiffies;
+	zra->zra_rl = zvol_range_lock(zv, uio->uio_loffset, uio->uio_resid,
+	    RL_READER);
+
+	error = dmu_read_async_dbuf(zv->zv_dbuf, uio->uio_loffset,
+	    uio->uio_resid, 0, zvol_read_done, zra);
+	if (error) {
+		zfs_range_unlock(zra->zra_rl);
+		kmem_free(zra, sizeof (zvol_read_arg_t));
+	}
+
+	return (error);
+}
+
+typedef struct zvol_flush {
+	struct bio	*zf_bio;
+	unsigned long	zf_start;
+	list_node_t	zf_node;
+} zvol_flush_t;
+
+/*
+ * Commit the log for every queued bio, repeating while more arrive.  All
+ * of the bios queued while a commit is in progress are completed by the
+ * next one, which is what lets concurrent flushes and FUA writes share a
+ * single zil_commit() and its log blocks.
+ */
+static void
+zvol_flush_worker(void *arg)
+{
+	zvol_state_t *zv = arg;
+	zvol_flush_t *zf;
+	list_t done;
+	uint64_t count;
+	hrtime_t begin;
+
+	list_create(&done, sizeof (zvol_flush_t),
+	    offsetof(zvol_flush_t, zf_node));
+
+	mutex_enter(&zv->zv_flush_lock);
+	while (!list_is_empty(&zv->zv_flush_list)) {
+		list_move_tail(&done, &zv->zv_flush_list);
+		mutex_exit(&zv->zv_flush_lock);
+
+		begin = gethrtime();
+		zil_commit(zv->zv_zilog, ZVOL_OBJ);
+		ZVOL_FLUSH_STAT_INCR(zv, zvfs_commit_time_ns,
+		    gethrtime() - begin);
+		ZVOL_FLUSH_STAT_INCR(zv, zvfs_commits, 1);
+
+		count = 0;
+		while ((zf = list_remove_head(&done)) != NULL) {
+			generic_end_io_acct(WRITE, &zv->zv_disk->part0,
+			    zf->zf_start);
+			BIO_END_IO(zf->zf_bio, 0);
+			kmem_free(zf, sizeof (zvol_flush_t));
+			count++;
+		}
+		ZVOL_FLUSH_STAT_INCR(zv, zvfs_coalesced, count - 1);
+
+		mutex_enter(&zv->zv_flush_lock);
+	}
+	zv->zv_flush_busy = B_FALSE;
+	cv_broadcast(&zv->zv_flush_cv);
+	mutex_exit(&zv->zv_flush_lock);
+
+	list_destroy(&done);
+}
+
+/*
+ * Complete a bio, whose writes have already been logged, once the log has
+ * been committed by zvol_flush_worker().  Returns 0 if the bio was queued,
+ * otherwise the caller should commit the log itself.
+ */
+static int
+zvol_flush_queue(zvol_state_t *zv, struct bio *bio)
+{
+	zvol_flush_t *zf;
+	boolean_t dispatch = B_FALSE;
+
+	if (!zvol_async_flush)
+		return (SET_ERROR(ENOTSUP));
+
+	zf = kmem_alloc(sizeof (zvol_flush_t), KM_SLEEP);
+	zf->zf_bio = bio;
+	zf->zf_start = jiffies;
+
+	ZVOL_FLUSH_STAT_INCR(zv, zvfs_flushes, 1);
+
+	mutex_enter(&zv->zv_flush_lock);
+	list_insert_tail(&zv->zv_flush_list, zf);
+	if (!zv->zv_flush_busy) {
+		zv->zv_flush_busy = B_TRUE;
+		dispatch = B_TRUE;
+	}
+	mutex_exit(&zv->zv_flush_lock);
+
+	if (dispatch)
+		VERIFY(taskq_dispatch(zvol_flush_taskq, zvol_flush_worker,
+		    zv, TQ_SLEEP) != 0);
+
+	return (0);
+}
+
+/*
+ * Wait for every queued flush to be completed.
+ */
+static void
+zvol_flush_wait(zvol_state_t *zv)
+{
+	mutex_enter(&zv->zv_flush_lock);
+	while (zv->zv_flush_busy)
+		cv_wait(&zv->zv_flush_cv, &zv->zv_flush_lock);
+	mutex_exit(&zv->zv_flush_lock);
+}
+
 static MAKE_REQUEST_FN_RET
 zvol_request(struct request_queue *q, struct bio *bio)
 {
@@ -783,6 +1247,7 @@ zvol_request(struct request_queue *q, struct bio *bio)
 #ifdef HAVE_GENERIC_IO_ACCT
 	unsigned long start = jiffies;
 #endif
+	boolean_t sync;
 	int error = 0;
 
 	uio.uio_bvec = &bio->bi_io_vec[BIO_BI_IDX(bio)];
@@ -821,21 +1286,34 @@ zvol_request(struct request_queue *q, struct bio *bio)
 		 * Some requests are just for flush and nothing else.
 		 */
 		if (uio.uio_resid == 0) {
-			if (bio->bi_rw & VDEV_REQ_FLUSH)
+			if (bio->bi_rw & VDEV_REQ_FLUSH) {
+				/* zvol_flush_worker() will end the bio */
+				if (zvol_flush_queue(zv, bio) == 0)
+					goto out0;
 				zil_commit(zv->zv_zilog, ZVOL_OBJ);
+			}
 			goto out2;
 		}
 
-		error = zvol_write(zv, &uio,
-		    ((bio->bi_rw & (VDEV_REQ_FUA|VDEV_REQ_FLUSH)) ||
-		    zv->zv_objset->os_sync == ZFS_SYNC_ALWAYS));
-	} else
+		sync = ((bio->bi_rw & (VDEV_REQ_FUA|VDEV_REQ_FLUSH)) ||
+		    zv->zv_objset->os_sync == ZFS_SYNC_ALWAYS);
+		error = zvol_write(zv, &uio, sync);
+		if (sync) {
+			if (error == 0 && zvol_flush_queue(zv, bio) == 0)
+				goto out0;
+			zil_commit(zv->zv_zilog, ZVOL_OBJ);
+		}
+	} else if ((error = zvol_read_async(zv, bio, &uio)) == 0) {
+		/* zvol_read_done() will end the accounting and the bio */
+		goto out0;
+	} else if (error != EINTR)
 		error = zvol_read(zv, &uio);
 
 out2:
 	generic_end_io_acct(rw, &zv->zv_disk->part0, start);
 out1:
 	BIO_END_IO(bio, -error);
+out0:
 	spl_fstrans_unmark(cookie);
 #ifdef HAVE_MAKE_REQUEST_FN_RET_INT
 	return (0);
@@ -1004,6 +1482,9 @@ out_owned:
 static void
 zvol_last_close(zvol_state_t *zv)
 {
+	zvol_discard_wait(zv);
+	zvol_flush_wait(zv);
+
 	zil_close(zv->zv_zilog);
 	zv->zv_zilog = NULL;
 
@@ -1274,9 +1755,10 @@ static struct block_device_operations zvol_ops = {
 /*
  * Allocate memory for a new zvol_state_t and setup the required
  * request queue and generic disk structures for the block device.
+ * The minor number is assigned by zvol_set_minor().
  */
 static zvol_state_t *
-zvol_alloc(dev_t dev, const char *name)
+zvol_alloc(const char *name)
 {
 	zvol_state_t *zv;
 
@@ -1301,7 +1783,6 @@ zvol_alloc(dev_t dev, const char *name)
 		goto out_queue;
 
 	zv->zv_queue->queuedata = zv;
-	zv->zv_dev = dev;
 	zv->zv_open_count = 0;
 	strlcpy(zv->zv_name, name, MAXNAMELEN);
 
@@ -1310,13 +1791,21 @@ zvol_alloc(dev_t dev, const char *name)
 	    sizeof (rl_t), offsetof(rl_t, r_node));
 	zv->zv_znode.z_is_zvol = TRUE;
 
+	mutex_init(&zv->zv_discard_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zv->zv_discard_cv, NULL, CV_DEFAULT, NULL);
+	zv->zv_discard_tree = range_tree_create(NULL, NULL,
+	    &zv->zv_discard_lock);
+
+	mutex_init(&zv->zv_flush_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zv->zv_flush_cv, NULL, CV_DEFAULT, NULL);
+	list_create(&zv->zv_flush_list, sizeof (zvol_flush_t),
+	    offsetof(zvol_flush_t, zf_node));
+	zv->zv_flush_stats = zvol_flush_stats_template;
+
 	zv->zv_disk->major = zvol_major;
-	zv->zv_disk->first_minor = (dev & MINORMASK);
 	zv->zv_disk->fops = &zvol_ops;
 	zv->zv_disk->private_data = zv;
 	zv->zv_disk->queue = zv->zv_queue;
-	snprintf(zv->zv_disk->disk_name, DISK_NAME_LEN, "%s%d",
-	    ZVOL_DEV_NAME, (dev & MINORMASK));
 
 	return (zv);
 
@@ -1328,6 +1817,23 @@ out_kmem:
 	return (NULL);
 }
 
+static void
+zvol_set_minor(zvol_state_t *zv, unsigned minor)
+{
+	zv->zv_dev = MKDEV(zvol_major, minor);
+	zv->zv_disk->first_minor = minor;
+	snprintf(zv->zv_disk->disk_name, DISK_NAME_LEN, "%s%d",
+	    ZVOL_DEV_NAME, minor);
+
+	zv->zv_flush_ksp = kstat_create("zfs", 0, zv->zv_disk->disk_name,
+	    "misc", KSTAT_TYPE_NAMED, sizeof (zvol_flush_stats_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (zv->zv_flush_ksp != NULL) {
+		zv->zv_flush_ksp->ks_data = &zv->zv_flush_stats;
+		kstat_install(zv->zv_flush_ksp);
+	}
+}
+
 /*
  * Cleanup then free a zvol_state_t which was created by zvol_alloc().
  */
@@ -1340,9 +1846,23 @@ zvol_free(zvol_state_t *zv)
 	avl_destroy(&zv->zv_znode.z_range_avl);
 	mutex_destroy(&zv->zv_znode.z_range_lock);
 
+	ASSERT(!zv->zv_discard_busy);
+	range_tree_destroy(zv->zv_discard_tree);
+	cv_destroy(&zv->zv_discard_cv);
+	mutex_destroy(&zv->zv_discard_lock);
+
+	if (zv->zv_flush_ksp != NULL)
+		kstat_delete(zv->zv_flush_ksp);
+	ASSERT(!zv->zv_flush_busy);
+	list_destroy(&zv->zv_flush_list);
+	cv_destroy(&zv->zv_flush_cv);
+	mutex_destroy(&zv->zv_flush_lock);
+
 	zv->zv_disk->private_data = NULL;
 
-	del_gendisk(zv->zv_disk);
+	/* The disk is not yet added if zvol_create_minor_impl() failed */
+	if (zv->zv_disk->flags & GENHD_FL_UP)
+		del_gendisk(zv->zv_disk);
 	blk_cleanup_queue(zv->zv_queue);
 	put_disk(zv->zv_disk);
 
@@ -1353,6 +1873,10 @@ zvol_free(zvol_state_t *zv)
  * Create a block device minor node and setup the linkage between it
  * and the specified volume.  Once this function returns the block
  * device is live and ready for use.
+ *
+ * zvol_state_lock is only held to check the name and to assign the minor,
+ * so that many minors can be set up at once (see zvol_create_minors_impl()).
+ * A concurrent attempt to create the same minor fails to own the objset.
  */
 static int
 zvol_create_minor_impl(const char *name)
@@ -1366,12 +1890,10 @@ zvol_create_minor_impl(const char *name)
 	int error = 0;
 
 	mutex_enter(&zvol_state_lock);
-
 	zv = zvol_find_by_name(name);
-	if (zv) {
-		error = SET_ERROR(EEXIST);
-		goto out;
-	}
+	mutex_exit(&zvol_state_lock);
+	if (zv)
+		return (SET_ERROR(EEXIST));
 
 	doi = kmem_alloc(sizeof (dmu_object_info_t), KM_SLEEP);
 
@@ -1387,11 +1909,7 @@ zvol_create_minor_impl(const char *name)
 	if (error)
 		goto out_dmu_objset_disown;
 
-	error = zvol_find_minor(&minor);
-	if (error)
-		goto out_dmu_objset_disown;
-
-	zv = zvol_alloc(MKDEV(zvol_major, minor), name);
+	zv = zvol_alloc(name);
 	if (zv == NULL) {
 		error = SET_ERROR(EAGAIN);
 		goto out_dmu_objset_disown;
@@ -1447,9 +1965,18 @@ out_dmu_objset_disown:
 	dmu_objset_disown(os, zvol_tag);
 out_doi:
 	kmem_free(doi, sizeof (dmu_object_info_t));
-out:
+
+	if (error != 0)
+		return (SET_ERROR(error));
+
+	mutex_enter(&zvol_state_lock);
+	if (zvol_find_by_name(name) != NULL)
+		error = SET_ERROR(EEXIST);
+	else
+		error = zvol_find_minor(&minor);
 
 	if (error == 0) {
+		zvol_set_minor(zv, minor);
 		zvol_insert(zv);
 		/*
 		 * Drop the lock to prevent deadlock with sys_open() ->
@@ -1460,6 +1987,7 @@ out:
 		mutex_exit(&zvol_state_lock);
 		add_disk(zv->zv_disk);
 	} else {
+		zvol_free(zv);
 		mutex_exit(&zvol_state_lock);
 	}
 
@@ -1491,27 +2019,88 @@ zvol_rename_minor(zvol_state_t *zv, const char *newname)
 }
 
 
+/*
+ * A minor being created on zvol_minor_taskq by zvol_create_minors_impl().
+ */
+typedef struct zvol_minor_task {
+	char		zmt_name[MAXNAMELEN];
+	boolean_t	zmt_snapdev;	/* then create its snapshots' minors */
+	taskqid_t	zmt_id;
+	int		zmt_error;
+	list_node_t	zmt_node;
+} zvol_minor_task_t;
+
+static void
+zvol_minor_task_cb(void *arg)
+{
+	zvol_minor_task_t *zmt = arg;
+	fstrans_cookie_t cookie = spl_fstrans_mark();
+
+	zmt->zmt_error = zvol_create_minor_impl(zmt->zmt_name);
+	spl_fstrans_unmark(cookie);
+}
+
+static void
+zvol_minor_task_dispatch(list_t *tasks, const char *name, boolean_t snapdev)
+{
+	zvol_minor_task_t *zmt;
+
+	zmt = kmem_zalloc(sizeof (zvol_minor_task_t), KM_SLEEP);
+	(void) strlcpy(zmt->zmt_name, name, MAXNAMELEN);
+	zmt->zmt_snapdev = snapdev;
+	list_insert_tail(tasks, zmt);
+
+	zmt->zmt_id = taskq_dispatch(zvol_minor_taskq, zvol_minor_task_cb,
+	    zmt, TQ_SLEEP);
+	if (zmt->zmt_id == 0)
+		zvol_minor_task_cb(zmt);
+}
+
+/*
+ * Wait for the dispatched minors, returning how many were created.
+ */
+static int
+zvol_minor_tasks_wait(list_t *tasks)
+{
+	zvol_minor_task_t *zmt;
+	int created = 0;
+
+	for (zmt = list_head(tasks); zmt != NULL;
+	    zmt = list_next(tasks, zmt)) {
+		if (zmt->zmt_id != 0)
+			taskq_wait_id(zvol_minor_taskq, zmt->zmt_id);
+		if (zmt->zmt_error == 0)
+			created++;
+	}
+
+	return (created);
+}
+
+static void
+zvol_minor_tasks_destroy(list_t *tasks)
+{
+	zvol_minor_task_t *zmt;
+
+	while ((zmt = list_remove_head(tasks)) != NULL)
+		kmem_free(zmt, sizeof (zvol_minor_task_t));
+	list_destroy(tasks);
+}
+
 /*
  * Mask errors to continue dmu_objset_find() traversal
  */
 static int
 zvol_create_snap_minor_cb(const char *dsname, void *arg)
 {
-	const char *name = (const char *)arg;
+	list_t *tasks = arg;
 
 	ASSERT0(MUTEX_HELD(&spa_namespace_lock));
 
-	/* skip the designated dataset */
-	if (name && strcmp(dsname, name) == 0)
+	/* skip the zvol itself, only its snapshots are wanted */
+	if (strchr(dsname, '@') == NULL)
 		return (0);
 
-	/* at this point, the dsname should name a snapshot */
-	if (strchr(dsname, '@') == 0) {
-		dprintf("zvol_create_snap_minor_cb(): "
-			"%s is not a shapshot name\n", dsname);
-	} else {
-		(void) zvol_create_minor_impl(dsname);
-	}
+	zvol_minor_task_dispatch(tasks, dsname, B_FALSE);
 
 	return (0);
 }
@@ -1522,6 +2111,7 @@ zvol_create_snap_minor_cb(const char *dsname, void *arg)
 static int
 zvol_create_minors_cb(const char *dsname, void *arg)
 {
+	list_t *tasks = arg;
 	uint64_t snapdev;
 	int error;
 
@@ -1532,27 +2122,14 @@ zvol_create_minors_cb(const char *dsname, void *arg)
 		return (0);
 
 	/*
-	 * Given the name and the 'snapdev' property, create device minor nodes
-	 * with the linkages to zvols/snapshots as needed.
-	 * If the name represents a zvol, create a minor node for the zvol, then
-	 * check if its snapshots are 'visible', and if so, iterate over the
-	 * snapshots and create device minor nodes for those.
+	 * Given the name and the 'snapdev' property, queue the creation of
+	 * a device minor node.  If the name represents a zvol with 'visible'
+	 * snapshots, zvol_create_minors_impl() later creates device minor
+	 * nodes for the snapshots as well.
 	 */
 	if (strchr(dsname, '@') == 0) {
-		/* create minor for the 'dsname' explicitly */
-		error = zvol_create_minor_impl(dsname);
-		if ((error == 0 || error == EEXIST) &&
-		    (snapdev == ZFS_SNAPDEV_VISIBLE)) {
-			fstrans_cookie_t cookie = spl_fstrans_mark();
-			/*
-			 * traverse snapshots only, do not traverse children,
-			 * and skip the 'dsname'
-			 */
-			error = dmu_objset_find((char *)dsname,
-			    zvol_create_snap_minor_cb, (void *)dsname,
-			    DS_FIND_SNAPSHOTS);
-			spl_fstrans_unmark(cookie);
-		}
+		zvol_minor_task_dispatch(tasks, dsname,
+		    snapdev == ZFS_SNAPDEV_VISIBLE);
 	} else {
 		dprintf("zvol_create_minors_cb(): %s is not a zvol name\n",
 			dsname);
@@ -1569,10 +2146,13 @@ zvol_create_minors_cb(const char *dsname, void *arg)
  *
  * The name can represent a dataset to be recursively scanned for zvols and
  * their snapshots, or a single zvol snapshot. If the name represents a
- * dataset, the scan is performed in two nested stages:
- * - scan the dataset for zvols, and
- * - for each zvol, create a minor node, then check if the zvol's snapshots
- *   are 'visible', and only then iterate over the snapshots if needed
+ * dataset, the scan is performed in two stages:
+ * - scan the dataset for zvols, creating their minor nodes in parallel
+ *   on zvol_minor_taskq, and
+ * - once those exist, iterate over the snapshots of each zvol whose
+ *   snapshots are 'visible' and create their minor nodes the same way.
+ * Deferring the snapshots means a pool with many of them doesn't delay
+ * the devices for the volumes themselves.
  *
  * If the name represents a snapshot, a check is perfromed if the snapshot is
  * 'visible' (which also verifies that the parent is a zvol), and if so,
@@ -1601,10 +2181,45 @@ zvol_create_minors_impl(const char *name)
 		if (error == 0 && snapdev == ZFS_SNAPDEV_VISIBLE)
 			error = zvol_create_minor_impl(name);
 	} else {
+		list_t tasks, snaps;
+		zvol_minor_task_t *zmt;
+		hrtime_t start = gethrtime();
+		hrtime_t elapsed;
+		int created;
+
+		list_create(&tasks, sizeof (zvol_minor_task_t),
+		    offsetof(zvol_minor_task_t, zmt_node));
+		list_create(&snaps, sizeof (zvol_minor_task_t),
+		    offsetof(zvol_minor_task_t, zmt_node));
+
 		cookie = spl_fstrans_mark();
 		error = dmu_objset_find(parent, zvol_create_minors_cb,
-		    NULL, DS_FIND_CHILDREN);
+		    &tasks, DS_FIND_CHILDREN);
+		created = zvol_minor_tasks_wait(&tasks);
+
+		for (zmt = list_head(&tasks); zmt != NULL;
+		    zmt = list_next(&tasks, zmt)) {
+			if (!zmt->zmt_snapdev ||
+			    (zmt->zmt_error != 0 && zmt->zmt_error != EEXIST))
+				continue;
+			/* traverse snapshots only, do not traverse children */
+			(void) dmu_objset_find(zmt->zmt_name,
+			    zvol_create_snap_minor_cb, &snaps,
+			    DS_FIND_SNAPSHOTS);
+		}
+		created += zvol_minor_tasks_wait(&snaps);
 		spl_fstrans_unmark(cookie);
+
+		zvol_minor_tasks_destroy(&tasks);
+		zvol_minor_tasks_destroy(&snaps);
+
+		elapsed = gethrtime() - start;
+		zvol_minor_stats.zms_last_minors.value.ui64 = created;
+		zvol_minor_stats.zms_last_time_ns.value.ui64 = elapsed;
+		ZVOL_MINOR_STAT_INCR(zms_created, created);
+		ZVOL_MINOR_STAT_BUMP(zms_scans);
+		zfs_dbgmsg("zvol: created %d minors for %s in %llu ms",
+		    created, name, (u_longlong_t)NSEC2MSEC(elapsed));
 	}
 
 	kmem_free(parent, MAXPATHLEN);
@@ -1951,6 +2566,29 @@ zvol_init(void)
 	    offsetof(zvol_state_t, zv_next));
 	mutex_init(&zvol_state_lock, NULL, MUTEX_DEFAULT, NULL);
 
+	zvol_discard_taskq = taskq_create("z_zvol_discard", max_ncpus,
+	    defclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
+	zvol_minor_taskq = taskq_create("z_zvol_minor", max_ncpus,
+	    defclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
+	zvol_flush_taskq = taskq_create("z_zvol_flush", max_ncpus,
+	    defclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
+
+	zvol_discard_ksp = kstat_create("zfs", 0, "zvol_discard_stats", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zvol_discard_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (zvol_discard_ksp != NULL) {
+		zvol_discard_ksp->ks_data = &zvol_discard_stats;
+		kstat_install(zvol_discard_ksp);
+	}
+
+	zvol_minor_ksp = kstat_create("zfs", 0, "zvol_minor_stats", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zvol_minor_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (zvol_minor_ksp != NULL) {
+		zvol_minor_ksp->ks_data = &zvol_minor_stats;
+		kstat_install(zvol_minor_ksp);
+	}
+
 	error = register_blkdev(zvol_major, ZVOL_DRIVER);
 	if (error) {
 		printk(KERN_INFO "ZFS: register_blkdev() failed %d\n", error);
@@ -1963,6 +2601,17 @@ zvol_init(void)
 	return (0);
 
 out:
+	if (zvol_minor_ksp != NULL) {
+		kstat_delete(zvol_minor_ksp);
+		zvol_minor_ksp = NULL;
+	}
+	if (zvol_discard_ksp != NULL) {
+		kstat_delete(zvol_discard_ksp);
+		zvol_discard_ksp = NULL;
+	}
+	taskq_destroy(zvol_flush_taskq);
+	taskq_destroy(zvol_minor_taskq);
+	taskq_destroy(zvol_discard_taskq);
 	mutex_destroy(&zvol_state_lock);
 	list_destroy(&zvol_state_list);
 
@@ -1977,10 +2626,31 @@ zvol_fini(void)
 	blk_unregister_region(MKDEV(zvol_major, 0), 1UL << MINORBITS);
 	unregister_blkdev(zvol_major, ZVOL_DRIVER);
 
+	if (zvol_minor_ksp != NULL) {
+		kstat_delete(zvol_minor_ksp);
+		zvol_minor_ksp = NULL;
+	}
+	if (zvol_discard_ksp != NULL) {
+		kstat_delete(zvol_discard_ksp);
+		zvol_discard_ksp = NULL;
+	}
+	taskq_destroy(zvol_flush_taskq);
+	taskq_destroy(zvol_minor_taskq);
+	taskq_destroy(zvol_discard_taskq);
+
 	list_destroy(&zvol_state_list);
 	mutex_destroy(&zvol_state_lock);
 }
 
+module_param(zvol_async_discard, uint, 0644);
+MODULE_PARM_DESC(zvol_async_discard, "Free zvol discards in the background");
+
+module_param(zvol_async_flush, uint, 0644);
+MODULE_PARM_DESC(zvol_async_flush, "Coalesce zvol flushes and FUA writes");
+
+module_param(zvol_async_read, uint, 0644);
+MODULE_PARM_DESC(zvol_async_read, "Complete zvol reads asynchronously");
+
 module_param(zvol_inhibit_dev, uint, 0644);
 MODULE_PARM_DESC(zvol_inhibit_dev, "Do not create zvol device nodes");
 